@@ -12,6 +12,7 @@ local special_env_vars = {
 
 --------------------------------------------------------------------------------
 local envvar_generator = clink.generator(10)
+local expand_envvars = settings.gethandle("match.expand_envvars")
 
 --------------------------------------------------------------------------------
 local function parse_percents(word)
@@ -43,7 +44,7 @@ function envvar_generator:generate(line_state, match_builder)
     end
 
     -- If expanding envvars, test whether there's an unterminated envvar.
-    if settings.get("match.expand_envvars") then
+    if expand_envvars.value then
         local in_out, index = parse_percents(word)
         if not in_out then
             return false
@@ -76,7 +77,7 @@ function envvar_generator:getwordbreakinfo(line_state)
         -- If expanding envvars, return the entire word so it can be expanded.
         -- This has a side effect that word breaks may confuse some match
         -- generators if they make unsafe assumptions.
-        if not in_out and settings.get("match.expand_envvars") then
+        if not in_out and expand_envvars.value then
             return 0, #word
         end
         return index, (in_out and 1) or 0
@@ -5,6 +5,8 @@
 clink = clink or {}
 local prompt_filters = {}
 local prompt_filters_unsorted = false
+local isolated_segments = {}
+local isolated_segments_reported = {}   -- Segments whose error has been reported since the scripts were loaded.
 
 
 
@@ -66,6 +68,22 @@ local function _do_filter_prompt(type, prompt, rprompt)
         return prompt, rprompt
     end
 
+    -- Run isolated segments in parallel before filtering, so filters can
+    -- compose their results.
+    if #type == 0 and #isolated_segments > 0 then
+        clink._runisolatedsegments(isolated_segments)
+        for _, seg in ipairs(isolated_segments) do
+            -- Report each failing segment once, rather than at every prompt.
+            local _, err = seg:get()
+            if err and not isolated_segments_reported[seg] then
+                isolated_segments_reported[seg] = true
+                print("")
+                print("isolated prompt segment failed:")
+                print(err)
+            end
+        end
+    end
+
     set_current_prompt_filter(nil)
     local ok, ret, rret = xpcall(impl, _error_handler_ret, prompt, rprompt)
     set_current_prompt_filter(nil)
@@ -127,6 +145,60 @@ function clink.promptfilter(priority)
     return ret
 end
 
+--------------------------------------------------------------------------------
+--- -name:  clink.isolatedpromptsegment
+--- -ver:   1.3.1
+--- -arg:   func:function
+--- -ret:   userdata
+--- Creates and returns an isolated prompt segment.  Before each prompt is
+--- filtered, Clink runs all isolated prompt segments in parallel, each in its
+--- own separate Lua state on a worker thread.  Prompt filters can then use
+--- <code>:get()</code> on the returned object to compose the string that the
+--- <span class="arg">func</span> function returned.
+---
+--- The <span class="arg">func</span> function receives one argument, a table
+--- with a snapshot of the prompt inputs:
+--- <code>cwd</code> is the current directory,
+--- <code>errorlevel</code> is the exit code of the previous command, and
+--- <code>env</code> is a table of environment variables (the names are
+--- uppercase).  It can return a string, or nil.
+---
+--- Because it runs in a separate Lua state, the <span class="arg">func</span>
+--- function cannot refer to any local variables outside of itself, and it can
+--- only use the standard Lua libraries (e.g. <code>io</code>,
+--- <code>string</code>, and <code>os</code>), not any Clink APIs.  Globals it
+--- sets persist in its own Lua state between prompts.  This is useful for pure
+--- CPU work or blocking file reads, such as shortening the path or parsing
+--- <code>.git/HEAD</code>.
+---
+--- <code>:get()</code> returns nil and an error message if the
+--- <span class="arg">func</span> function failed.  If it takes longer than
+--- one second then the prompt stops waiting for it, and it is stopped the next
+--- time it runs Lua code; <code>:get()</code> then returns the string from the
+--- last time it finished (or nil) and an error message.  A failing segment's error is reported once
+--- each time the scripts are loaded.
+--- -show:  local branch = clink.isolatedpromptsegment(function(inputs)
+--- -show:  &nbsp;   local f = io.open(inputs.cwd.."\\.git\\HEAD")
+--- -show:  &nbsp;   if f then
+--- -show:  &nbsp;       local head = f:read("*l")
+--- -show:  &nbsp;       f:close()
+--- -show:  &nbsp;       return head and head:match("^ref: refs/heads/(.+)")
+--- -show:  &nbsp;   end
+--- -show:  end)
+--- -show:
+--- -show:  local foo_prompt = clink.promptfilter(80)
+--- -show:  function foo_prompt:filter(prompt)
+--- -show:  &nbsp;   local b = branch:get()
+--- -show:  &nbsp;   if b then
+--- -show:  &nbsp;       return "["..b.."] "..prompt
+--- -show:  &nbsp;   end
+--- -show:  end
+function clink.isolatedpromptsegment(func)
+    local seg = clink._newisolatedsegment(func)
+    table.insert(isolated_segments, seg)
+    return seg
+end
+
 --------------------------------------------------------------------------------
 --- -name:  clink.prompt.register_filter
 --- -deprecated: clink.promptfilter
@@ -267,57 +339,10 @@ function clink.promptcoroutine(func)
         entry = { done=false, refilter=false, result=nil, src=src }
         prompt_filter_coroutines[prompt_filter_current] = entry
 
-        local async = settings.get("prompt.async")
-
-        -- Wrap the supplied function to track completion and end result.
-        local dependency_inversion = { c=nil }
-        coroutine.override_src(func)
-        local c = coroutine.create(function (async)
-            -- Call the supplied function.
-            local o = func(async)
-            -- Update the entry indicating completion.
-            entry.done = true
-            entry.refilter = true
-            entry.result = o
+        clink._runcoroutine(entry, func, function ()
             -- Refresh the prompt.
-            if async then
-                clink.removecoroutine(dependency_inversion.c)
-            end
-        end)
-        dependency_inversion.c = c
-
-        if async then
-            -- Add the coroutine.
-            clink.addcoroutine(c)
-            clink._after_coroutines(refilterprompt_after_coroutines)
-        else
-            -- Run the coroutine synchronously if async is disabled.
-            local max_iter = 25
-            for iteration = 1, max_iter + 1, 1 do
-                -- Pass false to let it know it is not async.
-                local result, _ = coroutine.resume(c, false--[[async]])
-                if result then
-                    if coroutine.status(c) == "dead" then
-                        break
-                    end
-                else
-                    if _ and type(_) == "string" then
-                        _error_handler(_)
-                    end
-                    break
-                end
-                -- Cap iterations when running synchronously, in case it's
-                -- poorly behaved.
-                if iteration >= max_iter then
-                    -- Ideally this could print an error message about the
-                    -- abandoning a misbehaving coroutine, but it would mess up
-                    -- the prompt and input line display.
-                    break
-                end
-            end
-            -- Update the entry indicating completion.
-            entry.done = true
-        end
+            entry.refilter = true
+        end, refilterprompt_after_coroutines)
     end
 
     -- Return the result, if any.
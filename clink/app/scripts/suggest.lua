@@ -4,6 +4,9 @@
 --------------------------------------------------------------------------------
 clink = clink or {}
 local suggesters = {}
+local strategy_setting = settings.gethandle("autosuggest.strategy")
+local strategy_value
+local strategy_list
 
 
 
@@ -12,8 +15,11 @@ local function _do_suggest(line, matches)
     -- Protected call to suggesters.
     local impl = function(line, matches)
         local suggested, onwards
-        local strategy = settings.get("autosuggest.strategy"):explode()
-        for _, name in ipairs(strategy) do
+        if strategy_value ~= strategy_setting.value then
+            strategy_value = strategy_setting.value
+            strategy_list = strategy_value:explode()
+        end
+        for _, name in ipairs(strategy_list) do
             local suggester = suggesters[name]
             if suggester then
                 local func = suggester.suggest
@@ -11,9 +11,9 @@
 #include <core/settings.h>
 #include <core/str.h>
 #include <core/str_tokeniser.h>
-#include <core/str_map.h>
 #include <core/path.h>
 #include <core/log.h>
+#include <core/task_scheduler.h>
 #include <assert.h>
 
 #include <new>
@@ -22,7 +22,6 @@ extern "C" {
 }
 
 #include <algorithm>
-#include <memory>
 #include <unordered_set>
 
 //------------------------------------------------------------------------------
@@ -193,61 +192,38 @@ void concurrency_tag::set(const char* tag)
 
 
 //------------------------------------------------------------------------------
-class auto_free_str
+union line_id_impl
 {
-public:
-                        auto_free_str() = default;
-                        auto_free_str(const char* s, int len) { set(s, len); }
-                        auto_free_str(auto_free_str&& other) : m_ptr(other.m_ptr) { other.m_ptr = nullptr; }
-                        ~auto_free_str() { free(m_ptr); }
-
-    auto_free_str&      operator=(const char* s) { set(s); return *this; }
-    auto_free_str&      operator=(auto_free_str&& other) { free(m_ptr); m_ptr = other.m_ptr; other.m_ptr = nullptr; return *this; }
-    void                set(const char* s, int len = -1);
-    const char*         get() const { return m_ptr; }
-
-private:
-    char*               m_ptr = nullptr;
+    explicit  line_id_impl()                      { outer = 0; }
+    explicit  line_id_impl(unsigned __int64 o)    { offset = o; bank_index = 0; active = 1; }
+    explicit  operator bool () const              { return !!outer; }
+    operator history_db::line_id () const         { return outer; }
+    struct {
+        unsigned __int64    offset : 61;
+        unsigned __int64    bank_index : 2;
+        unsigned __int64    active : 1;
+    };
+    history_db::line_id     outer;
 };
 
+static const line_id_impl c_max_line_id(static_cast<unsigned __int64>(-1));
+static const unsigned __int64 c_invalid_offset = static_cast<unsigned __int64>(-1);
+
 //------------------------------------------------------------------------------
-void auto_free_str::set(const char* s, int len)
+static unsigned __int64 get_handle_size(void* handle)
 {
-    if (s == m_ptr)
-    {
-        if (len < int(strlen(m_ptr)))
-            m_ptr[len] = '\0';
-    }
-    else
-    {
-        char* old = m_ptr;
-        if (len < 0)
-            len = int(strlen(s));
-        m_ptr = (char*)malloc(len + 1);
-        memcpy(m_ptr, s, len);
-        m_ptr[len] = '\0';
-        free(old);
-    }
+    LARGE_INTEGER size;
+    return GetFileSizeEx(handle, &size) ? size.QuadPart : 0;
 }
 
-
-
 //------------------------------------------------------------------------------
-union line_id_impl
+static unsigned __int64 seek_handle(void* handle, __int64 distance, DWORD method)
 {
-    explicit  line_id_impl()                  { outer = 0; }
-    explicit  line_id_impl(unsigned int o)    { offset = o; bank_index = 0; active = 1; }
-    explicit  operator bool () const          { return !!outer; }
-    operator history_db::line_id () const     { return outer; }
-    struct {
-        unsigned int    offset : 29;
-        unsigned int    bank_index : 2;
-        unsigned int    active : 1;
-    };
-    history_db::line_id outer;
-};
-
-static const line_id_impl c_max_line_id(static_cast<unsigned int>(-1));
+    LARGE_INTEGER in;
+    LARGE_INTEGER out;
+    in.QuadPart = distance;
+    return SetFilePointerEx(handle, in, &out, method) ? out.QuadPart : c_invalid_offset;
+}
 
 
 
@@ -368,15 +344,15 @@ public:
         unsigned __int64    get_buffer_offset() const   { return m_buffer_offset; }
         char*               get_buffer() const          { return m_buffer; }
         unsigned int        get_buffer_size() const     { return m_buffer_size; }
-        unsigned int        get_remaining() const       { return m_remaining; }
-        void                set_file_offset(unsigned int offset);
+        unsigned __int64    get_remaining() const       { return m_remaining; }
+        void                set_file_offset(unsigned __int64 offset);
 
     private:
         char*               m_buffer;
         void*               m_handle;
         unsigned __int64    m_buffer_offset;
         unsigned int        m_buffer_size;
-        unsigned int        m_remaining;
+        unsigned __int64    m_remaining;
     };
 
     class line_iter : public no_copy
@@ -389,8 +365,9 @@ public:
         template <int S>    line_iter(void* handle, char (&buffer)[S]);
                             ~line_iter() = default;
         line_id_impl        next(str_iter& out);
-        void                set_file_offset(unsigned int offset);
+        void                set_file_offset(unsigned __int64 offset);
         unsigned int        get_deleted_count() const { return m_deleted; }
+        unsigned __int64    get_read_offset() const;
 
     private:
         bool                provision();
@@ -399,13 +376,15 @@ public:
         unsigned int        m_deleted = 0;
         bool                m_first_line = true;
         bool                m_eating_ctag = false;
-        std::unordered_set<unsigned int> m_removals;
+        std::unordered_set<unsigned __int64> m_removals;
     };
 
     explicit                read_lock() = default;
     explicit                read_lock(const bank_handles& handles, bool exclusive=false);
     line_id_impl            find(const char* line) const;
     template <class T> void find(const char* line, T&& callback) const;
+    bool                    line_equals(unsigned __int64 offset, const char* line, unsigned int length) const;
+    bool                    read_line(unsigned __int64 offset, str_base& out) const;
     int                     apply_removals(write_lock& lock) const;
     int                     collect_removals(write_lock& lock, std::vector<line_id_impl>& removals) const;
 
@@ -418,17 +397,39 @@ class write_lock
     : public read_lock
 {
 public:
+    class rewriter : public no_copy
+    {
+    public:
+                        rewriter(write_lock& lock, const line_iter& reader);
+        line_id_impl    add(const char* line, unsigned int length);
+        void            finish();
+
+    private:
+        void            flush(bool all);
+        write_lock&     m_lock;
+        const line_iter& m_reader;
+        std::vector<char> m_pending;
+        unsigned __int64 m_offset = 0;
+    };
+
                     write_lock() = default;
     explicit        write_lock(const bank_handles& handles);
     void            clear();
     line_id_impl    add(const char* line);
+    void            add(const std::vector<str_moveable>& lines);
     bool            remove(line_id_impl id);
+    int             remove(const std::vector<str_moveable>& lines);
+    void            remove_offsets(std::vector<unsigned __int64>& offsets);
     void            append(const read_lock& src);
+
+private:
+    unsigned __int64 write_end(const char* data, unsigned int length);
 };
 
 //------------------------------------------------------------------------------
 static bool extract_ctag(read_lock::file_iter& iter, char* buffer, int buffer_size, concurrency_tag& tag);
 static bool extract_ctag(const read_lock& lock, concurrency_tag& tag);
+template <typename T> static void for_each_removal_offset(void* handle_removals, char* buffer, int buffer_size, T&& callback);
 
 
 
@@ -453,15 +454,75 @@ template <class T> void read_lock::find(const char* line, T&& callback) const
         if (line[read.length()] != '\0')
             continue;
 
-        unsigned int file_ptr = SetFilePointer(m_handle_lines, 0, nullptr, FILE_CURRENT);
+        const unsigned __int64 file_ptr = seek_handle(m_handle_lines, 0, FILE_CURRENT);
         bool more = callback(id);
-        SetFilePointer(m_handle_lines, file_ptr, nullptr, FILE_BEGIN);
+        seek_handle(m_handle_lines, file_ptr, FILE_BEGIN);
 
         if (!more)
             break;
     }
 }
 
+//------------------------------------------------------------------------------
+// Compares line with the bytes at offset in the lines file, without disturbing
+// the file pointer used by any line_iter in progress.
+bool read_lock::line_equals(unsigned __int64 offset, const char* line, unsigned int length) const
+{
+    const unsigned __int64 file_ptr = seek_handle(m_handle_lines, 0, FILE_CURRENT);
+    bool equal = (seek_handle(m_handle_lines, offset, FILE_BEGIN) == offset);
+
+    char buffer[256];
+    while (equal && length)
+    {
+        const DWORD chunk = min<DWORD>(length, sizeof(buffer));
+        DWORD read = 0;
+        if (!ReadFile(m_handle_lines, buffer, chunk, &read, nullptr) || read != chunk)
+            equal = false;
+        else if (memcmp(buffer, line, chunk) != 0)
+            equal = false;
+        line += chunk;
+        length -= chunk;
+    }
+
+    seek_handle(m_handle_lines, file_ptr, FILE_BEGIN);
+    return equal;
+}
+
+//------------------------------------------------------------------------------
+inline bool is_line_breaker(unsigned char c)
+{
+    return c == 0x00 || c == 0x0a || c == 0x0d;
+}
+
+//------------------------------------------------------------------------------
+// Reads the line at offset in the lines file, without disturbing the file
+// pointer used by any line_iter in progress.
+bool read_lock::read_line(unsigned __int64 offset, str_base& out) const
+{
+    out.clear();
+
+    const unsigned __int64 file_ptr = seek_handle(m_handle_lines, 0, FILE_CURRENT);
+    bool ok = (seek_handle(m_handle_lines, offset, FILE_BEGIN) == offset);
+
+    char buffer[256];
+    while (ok)
+    {
+        DWORD read = 0;
+        if (!ReadFile(m_handle_lines, buffer, sizeof(buffer), &read, nullptr) || !read)
+            break;
+
+        DWORD len = 0;
+        while (len < read && !is_line_breaker(buffer[len]))
+            len++;
+        out.concat(buffer, len);
+        if (len < read)
+            break;
+    }
+
+    seek_handle(m_handle_lines, file_ptr, FILE_BEGIN);
+    return ok && !out.empty();
+}
+
 //------------------------------------------------------------------------------
 line_id_impl read_lock::find(const char* line) const
 {
@@ -476,17 +537,21 @@ line_id_impl read_lock::find(const char* line) const
 //------------------------------------------------------------------------------
 int read_lock::apply_removals(write_lock& lock) const
 {
-    return for_each_removal(lock, [&] (unsigned int offset)
+    std::vector<unsigned __int64> offsets;
+    int ret = for_each_removal(lock, [&] (unsigned __int64 offset)
     {
-        line_id_impl id(offset);
-        lock.remove(id);
+        offsets.push_back(offset);
     });
+
+    if (ret > 0)
+        lock.remove_offsets(offsets);
+    return ret;
 }
 
 //------------------------------------------------------------------------------
 int read_lock::collect_removals(write_lock& lock, std::vector<line_id_impl>& removals) const
 {
-    return for_each_removal(lock, [&] (unsigned int offset)
+    return for_each_removal(lock, [&] (unsigned __int64 offset)
     {
         removals.emplace_back(offset);
     });
@@ -507,8 +572,8 @@ template <typename T> int read_lock::for_each_removal(const read_lock& target, T
         verify_handles.m_handle_lines = target.m_handle_lines;
         verify_handles.m_handle_removals = this->m_handle_removals;
 
-        unsigned int lines_ptr = SetFilePointer(verify_handles.m_handle_lines, 0, nullptr, FILE_CURRENT);
-        unsigned int removals_ptr = SetFilePointer(verify_handles.m_handle_removals, 0, nullptr, FILE_CURRENT);
+        const unsigned __int64 lines_ptr = seek_handle(verify_handles.m_handle_lines, 0, FILE_CURRENT);
+        const unsigned __int64 removals_ptr = seek_handle(verify_handles.m_handle_removals, 0, FILE_CURRENT);
 
 #ifdef DEBUG
         {
@@ -532,8 +597,8 @@ template <typename T> int read_lock::for_each_removal(const read_lock& target, T
         file_iter iter_removals(verify_handles.m_handle_removals, tmp);
         extract_ctag(iter_removals, tmp, int(sizeof(tmp)), removals_ctag);
 
-        SetFilePointer(verify_handles.m_handle_lines, lines_ptr, nullptr, FILE_BEGIN);
-        SetFilePointer(verify_handles.m_handle_removals, removals_ptr, nullptr, FILE_BEGIN);
+        seek_handle(verify_handles.m_handle_lines, lines_ptr, FILE_BEGIN);
+        seek_handle(verify_handles.m_handle_removals, removals_ptr, FILE_BEGIN);
 
         if (strcmp(master_ctag.get(), removals_ctag.get()) != 0)
         {
@@ -542,9 +607,16 @@ template <typename T> int read_lock::for_each_removal(const read_lock& target, T
         }
     }
 
+    for_each_removal_offset(m_handle_removals, tmp, int(sizeof(tmp)), callback);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+template <typename T> static void for_each_removal_offset(void* handle_removals, char* buffer, int buffer_size, T&& callback)
+{
     // Read removal offsets; call the specified callback for each offset.
     str_iter value;
-    line_iter iter(m_handle_removals, tmp);
+    read_lock::line_iter iter(handle_removals, buffer, buffer_size);
     while (iter.next(value))
     {
         unsigned __int64 offset = 0;
@@ -561,16 +633,14 @@ template <typename T> int read_lock::for_each_removal(const read_lock& target, T
         {
             // Should be unreachable because too-large ids should not have
             // gotten in the removals file in the first place.
-            LOG("removal offset %zu is too large", offset);
+            LOG("removal offset %llu is too large", offset);
             assert(false);
         }
         else if (offset > 0)
         {
-            callback(static_cast<unsigned int>(offset));
+            callback(offset);
         }
     }
-
-    return 1;
 }
 
 
@@ -618,7 +688,7 @@ unsigned int read_lock::file_iter::next(unsigned int rollback)
     m_buffer_offset += m_buffer_size - rollback;
 
     char* target = m_buffer + rollback;
-    int needed = min(m_remaining, m_buffer_size - rollback);
+    DWORD needed = DWORD(min<unsigned __int64>(m_remaining, m_buffer_size - rollback));
 
     DWORD read = 0;
     ReadFile(m_handle, target, needed, &read, nullptr);
@@ -629,14 +699,14 @@ unsigned int read_lock::file_iter::next(unsigned int rollback)
 }
 
 //------------------------------------------------------------------------------
-void read_lock::file_iter::set_file_offset(unsigned int offset)
+void read_lock::file_iter::set_file_offset(unsigned __int64 offset)
 {
-    m_remaining = GetFileSize(m_handle, nullptr);
-    offset = clamp(offset, (unsigned int)0, m_remaining);
+    m_remaining = get_handle_size(m_handle);
+    offset = min(offset, m_remaining);
     m_remaining -= offset;
     // BUGBUG: Should this be `offset - m_buffer_offset`?
     m_buffer_offset = static_cast<unsigned __int64>(0) - m_buffer_size;
-    SetFilePointer(m_handle, offset, nullptr, FILE_BEGIN);
+    seek_handle(m_handle, offset, FILE_BEGIN);
     m_buffer[0] = '\0';
 }
 
@@ -658,7 +728,7 @@ template <int S> read_lock::line_iter::line_iter(void* handle, char (&buffer)[S]
 read_lock::line_iter::line_iter(const read_lock& lock, char* buffer, int buffer_size)
 : m_file_iter(lock.m_handle_lines, buffer, buffer_size)
 {
-    lock.for_each_removal(lock, [&] (unsigned int offset)
+    lock.for_each_removal(lock, [&] (unsigned __int64 offset)
     {
         m_removals.insert(offset);
     });
@@ -676,12 +746,6 @@ bool read_lock::line_iter::provision()
     return !!(m_remaining = m_file_iter.next(m_remaining));
 }
 
-//------------------------------------------------------------------------------
-inline bool is_line_breaker(unsigned char c)
-{
-    return c == 0x00 || c == 0x0a || c == 0x0d;
-}
-
 //------------------------------------------------------------------------------
 line_id_impl read_lock::line_iter::next(str_iter& out)
 {
@@ -737,7 +801,7 @@ line_id_impl read_lock::line_iter::next(str_iter& out)
         const unsigned __int64 real_offset = m_file_iter.get_buffer_offset() + offset_in_buffer;
         const bool too_big = (real_offset >= c_max_line_id.offset);
         assert(!too_big);
-        const unsigned int offset = too_big ? c_max_line_id.offset : static_cast<unsigned int>(real_offset);
+        const unsigned __int64 offset = too_big ? c_max_line_id.offset : real_offset;
 
         // Removals from master are deferred when `history.shared` is false, so
         // also test for deferred removals here.
@@ -757,12 +821,19 @@ line_id_impl read_lock::line_iter::next(str_iter& out)
 }
 
 //------------------------------------------------------------------------------
-void read_lock::line_iter::set_file_offset(unsigned int offset)
+void read_lock::line_iter::set_file_offset(unsigned __int64 offset)
 {
     m_file_iter.set_file_offset(offset);
     m_eating_ctag = false;
 }
 
+//------------------------------------------------------------------------------
+unsigned __int64 read_lock::line_iter::get_read_offset() const
+{
+    // Everything before this offset has already been read into the buffer.
+    return m_file_iter.get_buffer_offset() + m_file_iter.get_buffer_size();
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -784,19 +855,45 @@ void write_lock::clear()
 }
 
 //------------------------------------------------------------------------------
-line_id_impl write_lock::add(const char* line)
+// Appends data to the end of the lines file in a single write, and returns the
+// offset where it was written (or c_invalid_offset).
+unsigned __int64 write_lock::write_end(const char* data, unsigned int length)
 {
     DWORD written;
-    const DWORD offset = SetFilePointer(m_handle_lines, 0, nullptr, FILE_END);
-    if (offset == INVALID_SET_FILE_POINTER)
+    const unsigned __int64 offset = seek_handle(m_handle_lines, 0, FILE_END);
+    if (offset != c_invalid_offset)
+        WriteFile(m_handle_lines, data, length, &written, nullptr);
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+line_id_impl write_lock::add(const char* line)
+{
+    str<> record;
+    record << line << "\n";
+
+    const unsigned __int64 offset = write_end(record.c_str(), record.length());
+    if (offset == c_invalid_offset)
         return line_id_impl();
-    WriteFile(m_handle_lines, line, int(strlen(line)), &written, nullptr);
-    WriteFile(m_handle_lines, "\n", 1, &written, nullptr);
     if (offset >= c_max_line_id.offset)
         return c_max_line_id;
     return line_id_impl(offset);
 }
 
+//------------------------------------------------------------------------------
+void write_lock::add(const std::vector<str_moveable>& lines)
+{
+    std::vector<char> records;
+    for (const auto& line : lines)
+    {
+        records.insert(records.end(), line.c_str(), line.c_str() + line.length());
+        records.push_back('\n');
+    }
+
+    if (!records.empty())
+        write_end(records.data(), DWORD(records.size()));
+}
+
 //------------------------------------------------------------------------------
 bool write_lock::remove(line_id_impl id)
 {
@@ -810,22 +907,128 @@ bool write_lock::remove(line_id_impl id)
     if (m_handle_removals && id.bank_index == bank_master)
     {
         str<> s;
-        s.format("%d\n", id.offset);
+        s.format("%llu\n", static_cast<unsigned __int64>(id.offset));
 
         DWORD written;
-        SetFilePointer(m_handle_removals, 0, nullptr, FILE_END);
+        seek_handle(m_handle_removals, 0, FILE_END);
         WriteFile(m_handle_removals, s.c_str(), s.length(), &written, nullptr);
     }
     else
     {
         DWORD written;
-        SetFilePointer(m_handle_lines, id.offset, nullptr, FILE_BEGIN);
+        seek_handle(m_handle_lines, id.offset, FILE_BEGIN);
         WriteFile(m_handle_lines, "|", 1, &written, nullptr);
     }
 
     return true;
 }
 
+//------------------------------------------------------------------------------
+// Removes every line that matches any of the given lines, in one pass over the
+// file.  The removals are gathered first and then written together:  one
+// append to the removals file, or coalesced tombstones in the lines file.
+int write_lock::remove(const std::vector<str_moveable>& lines)
+{
+    if (lines.empty())
+        return 0;
+
+    std::vector<unsigned __int64> offsets;
+    {
+        history_read_buffer buffer;
+        line_iter iter(*this, buffer.data(), buffer.size());
+
+        line_id_impl id;
+        for (str_iter read; id = iter.next(read);)
+        {
+            if (id.offset == c_max_line_id.offset)
+                continue;
+
+            for (const auto& line : lines)
+            {
+                if (line.length() == unsigned(read.length()) &&
+                    strncmp(line.c_str(), read.get_pointer(), read.length()) == 0)
+                {
+                    offsets.push_back(id.offset);
+                    break;
+                }
+            }
+        }
+    }
+
+    if (offsets.empty())
+        return 0;
+
+    if (m_handle_removals)
+    {
+        str<> s;
+        for (unsigned __int64 offset : offsets)
+        {
+            str<32> tmp;
+            tmp.format("%llu\n", offset);
+            s << tmp;
+        }
+
+        DWORD written;
+        seek_handle(m_handle_removals, 0, FILE_END);
+        WriteFile(m_handle_removals, s.c_str(), s.length(), &written, nullptr);
+    }
+    else
+    {
+        remove_offsets(offsets);
+    }
+
+    return int(offsets.size());
+}
+
+//------------------------------------------------------------------------------
+void write_lock::remove_offsets(std::vector<unsigned __int64>& offsets)
+{
+    // Write the tombstones in ascending order, coalescing removals that fall
+    // within one page into a single read-modify-write.  The lock is exclusive,
+    // so rewriting the unchanged bytes between the tombstones is safe.  This
+    // keeps the lock hold time proportional to the number of pages touched
+    // rather than the number of removals.
+    static const unsigned int c_page_size = 4096;
+
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    char page[c_page_size];
+    for (size_t i = 0; i < offsets.size();)
+    {
+        const unsigned __int64 first = offsets[i];
+        assert(first < c_max_line_id.offset);
+
+        size_t end = i + 1;
+        while (end < offsets.size() && offsets[end] - first < c_page_size)
+            ++end;
+
+        DWORD bytes = DWORD(offsets[end - 1] - first + 1);
+        if (end - i > 1)
+        {
+            seek_handle(m_handle_lines, first, FILE_BEGIN);
+            if (!ReadFile(m_handle_lines, page, bytes, &bytes, nullptr))
+                bytes = 0;
+            for (size_t j = i; j < end; ++j)
+            {
+                const unsigned int index = unsigned(offsets[j] - first);
+                if (index < bytes)
+                    page[index] = '|';
+            }
+        }
+        else
+        {
+            page[0] = '|';
+        }
+
+        DWORD written;
+        seek_handle(m_handle_lines, first, FILE_BEGIN);
+        WriteFile(m_handle_lines, page, bytes, &written, nullptr);
+
+        i = end;
+    }
+}
+
 //------------------------------------------------------------------------------
 void write_lock::append(const read_lock& src)
 {
@@ -841,6 +1044,78 @@ void write_lock::append(const read_lock& src)
 
 
 
+//------------------------------------------------------------------------------
+// Rewrites the lines file in place from the beginning, while reader is reading
+// it.  Output is buffered and only written over bytes the reader has already
+// consumed, so it's safe even when the output briefly runs ahead of the input
+// (e.g. when injecting a ctag into a file that had none).
+write_lock::rewriter::rewriter(write_lock& lock, const line_iter& reader)
+: m_lock(lock)
+, m_reader(reader)
+{
+}
+
+//------------------------------------------------------------------------------
+line_id_impl write_lock::rewriter::add(const char* line, unsigned int length)
+{
+    const unsigned __int64 offset = m_offset + m_pending.size();
+
+    m_pending.insert(m_pending.end(), line, line + length);
+    m_pending.push_back('\n');
+
+    if (m_pending.size() >= 64 * 1024)
+        flush(false);
+
+    if (offset >= c_max_line_id.offset)
+        return c_max_line_id;
+    return line_id_impl(offset);
+}
+
+//------------------------------------------------------------------------------
+void write_lock::rewriter::finish()
+{
+    flush(true);
+
+    seek_handle(m_lock.m_handle_lines, m_offset, FILE_BEGIN);
+    SetEndOfFile(m_lock.m_handle_lines);
+    if (m_lock.m_handle_removals)
+    {
+        SetFilePointer(m_lock.m_handle_removals, 0, nullptr, FILE_BEGIN);
+        SetEndOfFile(m_lock.m_handle_removals);
+    }
+}
+
+//------------------------------------------------------------------------------
+void write_lock::rewriter::flush(bool all)
+{
+    size_t bytes = m_pending.size();
+    if (!all)
+    {
+        const unsigned __int64 read_offset = m_reader.get_read_offset();
+        if (read_offset <= m_offset)
+            return;
+        bytes = size_t(min<unsigned __int64>(bytes, read_offset - m_offset));
+    }
+
+    if (!bytes)
+        return;
+
+    // The reader reads sequentially from the current file pointer, so put it
+    // back after writing.
+    void* handle = m_lock.m_handle_lines;
+    const unsigned __int64 restore = seek_handle(handle, 0, FILE_CURRENT);
+
+    DWORD written;
+    seek_handle(handle, m_offset, FILE_BEGIN);
+    WriteFile(handle, m_pending.data(), DWORD(bytes), &written, nullptr);
+    seek_handle(handle, restore, FILE_BEGIN);
+
+    m_offset += bytes;
+    m_pending.erase(m_pending.begin(), m_pending.begin() + bytes);
+}
+
+
+
 //------------------------------------------------------------------------------
 class read_line_iter
 {
@@ -976,94 +1251,210 @@ static bool extract_ctag(const read_lock& lock, concurrency_tag& tag)
 }
 
 //------------------------------------------------------------------------------
-static void rewrite_master_bank(write_lock& lock, size_t limit=0, size_t* _kept=nullptr, size_t* _deleted=nullptr, bool uniq=false, size_t* _dups=nullptr, std::map<line_id_impl, line_id_impl>* remap=nullptr)
+struct line_id_remap_entry
 {
-    history_read_buffer buffer;
-    str_map_case<size_t>::type seen;
+    line_id_impl    m_old;
+    line_id_impl    m_new;
+};
 
-    if (_dups)
-        *_dups = 0;
+// Sorted by m_old; rewrite_master_bank() produces them in ascending order.
+typedef std::vector<line_id_remap_entry> line_id_remap;
+
+//------------------------------------------------------------------------------
+static const line_id_remap_entry* find_remap(const line_id_remap& remap, line_id_impl id)
+{
+    auto iter = std::lower_bound(remap.begin(), remap.end(), id, [] (const line_id_remap_entry& entry, line_id_impl value) {
+        return entry.m_old.outer < value.outer;
+    });
+    if (iter == remap.end() || iter->m_old.outer != id.outer)
+        return nullptr;
+    return &*iter;
+}
+
+//------------------------------------------------------------------------------
+static unsigned __int64 hash_line(const char* line, unsigned int length)
+{
+    // 64-bit FNV-1a.
+    unsigned __int64 hash = 14695981039346656037ull;
+    for (const char* end = line + length; line < end; ++line)
+    {
+        hash ^= static_cast<unsigned char>(*line);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
 
-    struct remap_history_line
+//------------------------------------------------------------------------------
+// Open addressing hash set of lines, remembering the offset of the last line
+// seen with each distinct content.  Entries hold the 64-bit hash, length, and
+// offset instead of the text, so there's no per-line allocation and each
+// distinct line costs 24 bytes.  When the hash and length match, the line at
+// the entry's offset is read back and compared, so lines whose hashes collide
+// get separate entries rather than being treated as duplicates.
+class line_hash_set
+{
+    struct entry
     {
-        auto_free_str   m_line;
-        line_id_impl    m_old;
-        line_id_impl    m_new;
+        unsigned __int64    hash;
+        unsigned int        length;     // 0 means the slot is empty.
+        unsigned __int64    offset;
     };
 
-    // Read lines to keep into vector.
-    str_iter out;
-    read_lock::line_iter iter(lock, buffer.data(), buffer.size());
-    std::vector<std::unique_ptr<remap_history_line>> lines_to_keep;
-    while (const line_id_impl id = iter.next(out))
+public:
+    explicit                line_hash_set(const read_lock& lock) : m_lock(lock) {}
+    bool                    insert_or_assign(const char* line, unsigned int length, unsigned __int64 offset);
+    bool                    is_last(const char* line, unsigned int length, unsigned __int64 offset) const;
+
+private:
+    entry&                  find_empty(unsigned __int64 hash);
+    void                    grow();
+    const read_lock&        m_lock;
+    std::vector<entry>      m_entries;
+    size_t                  m_count = 0;
+};
+
+//------------------------------------------------------------------------------
+// Only call this while the lines file is unmodified; it reads back earlier
+// lines to compare them.
+bool line_hash_set::insert_or_assign(const char* line, unsigned int length, unsigned __int64 offset)
+{
+    assert(length);
+
+    if ((m_count + 1) * 4 > m_entries.size() * 3)
+        grow();
+
+    const unsigned __int64 hash = hash_line(line, length);
+    const size_t mask = m_entries.size() - 1;
+    for (size_t i = size_t(hash) & mask;; i = (i + 1) & mask)
     {
-        std::unique_ptr<remap_history_line> line = std::make_unique<remap_history_line>();
-        line->m_line.set(out.get_pointer(), out.length());
-        if (uniq)
+        entry& e = m_entries[i];
+        if (!e.length)
         {
-            auto const lookup = seen.find(line->m_line.get());
-            if (lookup != seen.end())
-            {
-                // Reuse the old entry so the map stays valid.  Leave the old
-                // entry present but empty, so the indices don't shift.
-                line = std::move(lines_to_keep[lookup->second]);
-                if (_dups)
-                    ++(*_dups);
-            }
-            seen.insert_or_assign(line->m_line.get(), lines_to_keep.size());
+            e.hash = hash;
+            e.length = length;
+            e.offset = offset;
+            ++m_count;
+            return true;
         }
-        line->m_old = id;
-        lines_to_keep.emplace_back(std::move(line));
-    }
 
-    if (_kept)
-        *_kept = lines_to_keep.size();
-    if (_deleted)
-        *_deleted = iter.get_deleted_count();
+        if (e.hash == hash && e.length == length && m_lock.line_equals(e.offset, line, length))
+        {
+            e.offset = offset;
+            return false;
+        }
+    }
+}
 
-    // Clear and write new tag.
-    concurrency_tag tag;
-    tag.generate_new_tag();
-    lock.clear();
-    lock.add(tag.get());
+//------------------------------------------------------------------------------
+// Doesn't read from the lines file, so it's safe to use while the file is
+// being rewritten.  Every distinct line has its own entry, so a line is the
+// last copy exactly when some entry with the same hash and length records its
+// offset.
+bool line_hash_set::is_last(const char* line, unsigned int length, unsigned __int64 offset) const
+{
+    if (m_entries.empty())
+        return true;
 
-    // Write lines from vector.
-    size_t skip = (0 < limit && limit < lines_to_keep.size()) ? lines_to_keep.size() - limit : 0;
-    for (auto const& line : lines_to_keep)
+    bool known = false;
+    const unsigned __int64 hash = hash_line(line, length);
+    const size_t mask = m_entries.size() - 1;
+    for (size_t i = size_t(hash) & mask;; i = (i + 1) & mask)
     {
-        if (line.get())
+        const entry& e = m_entries[i];
+        if (!e.length)
+            return !known;
+        if (e.hash == hash && e.length == length)
         {
-            if (skip)
-                skip--;
-            else
-                line->m_new = lock.add(line->m_line.get());
+            if (e.offset == offset)
+                return true;
+            known = true;
         }
     }
+}
 
-    // Verify ids monotonically increase.
-#ifdef DEBUG
-    const remap_history_line* prev = nullptr;
-    for (const auto& line : lines_to_keep)
-        if (line)
+//------------------------------------------------------------------------------
+line_hash_set::entry& line_hash_set::find_empty(unsigned __int64 hash)
+{
+    const size_t mask = m_entries.size() - 1;
+    for (size_t i = size_t(hash) & mask;; i = (i + 1) & mask)
+    {
+        if (!m_entries[i].length)
+            return m_entries[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+void line_hash_set::grow()
+{
+    std::vector<entry> old;
+    old.swap(m_entries);
+    m_entries.resize(old.empty() ? 1024 : old.size() * 2);
+
+    for (const entry& e : old)
+        if (e.length)
+            find_empty(e.hash) = e;
+}
+
+//------------------------------------------------------------------------------
+static void rewrite_master_bank(write_lock& lock, size_t limit=0, size_t* _kept=nullptr, size_t* _deleted=nullptr, bool uniq=false, size_t* _dups=nullptr, line_id_remap* remap=nullptr)
+{
+    history_read_buffer buffer;
+    line_hash_set seen(lock);
+    size_t count = 0;
+    size_t dups = 0;
+
+    // First pass:  count the lines, and when enforcing uniqueness remember the
+    // offset of the last copy of each distinct line.
+    if (uniq || limit || _kept || _deleted)
+    {
+        str_iter out;
+        read_lock::line_iter iter(lock, buffer.data(), buffer.size());
+        while (const line_id_impl id = iter.next(out))
         {
-            if (prev)
-            {
-                assert(line->m_old.outer > prev->m_old.outer);
-                assert(line->m_new.outer > prev->m_new.outer);
-            }
-            prev = line.get();
+            ++count;
+            if (uniq && !seen.insert_or_assign(out.get_pointer(), out.length(), id.offset))
+                ++dups;
         }
-#endif
 
-    if (remap)
+        if (_deleted)
+            *_deleted = iter.get_deleted_count();
+    }
+
+    if (_kept)
+        *_kept = count;
+    if (_dups)
+        *_dups = dups;
+
+    // Second pass:  stream the surviving lines back into the file, behind a
+    // new concurrency tag.  Only the last copy of a duplicated line survives,
+    // so the lines keep their relative order.
+    size_t skip = (0 < limit && limit < count) ? count - limit : 0;
+
+    concurrency_tag tag;
+    tag.generate_new_tag();
+
+    str_iter out;
+    read_lock::line_iter iter(lock, buffer.data(), buffer.size());
+    write_lock::rewriter writer(lock, iter);
+    writer.add(tag.get(), static_cast<unsigned int>(strlen(tag.get())));
+    while (const line_id_impl id = iter.next(out))
     {
-        for (const auto& line : lines_to_keep)
+        if (uniq && !seen.is_last(out.get_pointer(), out.length(), id.offset))
+            continue;
+
+        line_id_impl new_id;
+        if (skip)
+            skip--;
+        else
+            new_id = writer.add(out.get_pointer(), out.length());
+
+        if (remap)
         {
-            if (!line)
-                continue;
-            remap->emplace(line->m_old.outer, line->m_new.outer);
+            assert(remap->empty() || id.outer > remap->back().m_old.outer);
+            remap->push_back({ id, new_id });
         }
     }
+    writer.finish();
 }
 
 //------------------------------------------------------------------------------
@@ -1123,6 +1514,104 @@ static void migrate_history(const char* path, bool m_diagnostic)
 
 
 
+//------------------------------------------------------------------------------
+// The narrow form keeps the low 29 bits of the offset and moves the bank_index
+// and active bits down from the top of the 64 bit id into the top 3 bits, so
+// both forms sort the same way.
+static const unsigned int c_narrow_offset_mask = 0x1fffffff;
+static const unsigned int c_narrow_flags_mask = 0xe0000000;
+
+//------------------------------------------------------------------------------
+bool history_db::line_id_map::is_narrow(line_id id)
+{
+    line_id_impl impl;
+    impl.outer = id;
+    return impl.offset <= c_narrow_offset_mask;
+}
+
+//------------------------------------------------------------------------------
+unsigned int history_db::line_id_map::to_narrow(line_id id)
+{
+    return ((unsigned int)(id >> 32) & c_narrow_flags_mask) | ((unsigned int)id & c_narrow_offset_mask);
+}
+
+//------------------------------------------------------------------------------
+history_db::line_id history_db::line_id_map::from_narrow(unsigned int id)
+{
+    return (line_id(id & c_narrow_flags_mask) << 32) | (id & c_narrow_offset_mask);
+}
+
+//------------------------------------------------------------------------------
+void history_db::line_id_map::clear()
+{
+    m_narrow.clear();
+    m_wide.clear();
+    m_is_wide = false;
+}
+
+//------------------------------------------------------------------------------
+size_t history_db::line_id_map::size() const
+{
+    return m_is_wide ? m_wide.size() : m_narrow.size();
+}
+
+//------------------------------------------------------------------------------
+history_db::line_id history_db::line_id_map::operator [] (size_t index) const
+{
+    return m_is_wide ? m_wide[index] : from_narrow(m_narrow[index]);
+}
+
+//------------------------------------------------------------------------------
+void history_db::line_id_map::push_back(line_id id)
+{
+    if (!m_is_wide && !is_narrow(id))
+    {
+        m_wide.reserve(m_narrow.size() + 1);
+        for (unsigned int narrow : m_narrow)
+            m_wide.push_back(from_narrow(narrow));
+        m_narrow.clear();
+        m_narrow.shrink_to_fit();
+        m_is_wide = true;
+    }
+
+    if (m_is_wide)
+        m_wide.push_back(id);
+    else
+        m_narrow.push_back(to_narrow(id));
+}
+
+//------------------------------------------------------------------------------
+void history_db::line_id_map::erase(size_t index)
+{
+    if (m_is_wide)
+        m_wide.erase(m_wide.begin() + index);
+    else
+        m_narrow.erase(m_narrow.begin() + index);
+}
+
+//------------------------------------------------------------------------------
+// Returns the index of id in the sorted range [first, last), or last if it's
+// not present.
+size_t history_db::line_id_map::find(size_t first, size_t last, line_id id) const
+{
+    if (m_is_wide)
+    {
+        auto begin = m_wide.begin();
+        auto nth = std::lower_bound(begin + first, begin + last, id);
+        return (nth != begin + last && *nth == id) ? size_t(nth - begin) : last;
+    }
+
+    if (!is_narrow(id))
+        return last;
+
+    const unsigned int narrow = to_narrow(id);
+    auto begin = m_narrow.begin();
+    auto nth = std::lower_bound(begin + first, begin + last, narrow);
+    return (nth != begin + last && *nth == narrow) ? size_t(nth - begin) : last;
+}
+
+
+
 //------------------------------------------------------------------------------
 history_db::history_db(bool use_master_bank)
 : m_use_master_bank(use_master_bank)
@@ -1156,6 +1645,8 @@ history_db::history_db(bool use_master_bank)
 //------------------------------------------------------------------------------
 history_db::~history_db()
 {
+    flush_pending();
+
     // Close alive handle
     CloseHandle(m_alive_file);
 
@@ -1163,13 +1654,15 @@ history_db::~history_db()
     for (int i = 1; i < sizeof_array(m_bank_handles); ++i)
         m_bank_handles[i].close();
 
-    reap();
+    // Finish any background reap before the final synchronous one.
+    wait_for_reap();
+    reap(get_bank(bank_master));
 
     m_bank_handles[bank_master].close();
 }
 
 //------------------------------------------------------------------------------
-void history_db::reap()
+void history_db::reap(const bank_handles& master_handles) const
 {
     str<280> removals;
 
@@ -1203,19 +1696,48 @@ void history_db::reap()
             reap_handles.m_handle_lines = open_file(path.c_str());
             reap_handles.m_handle_removals = open_file(removals.c_str(), true/*if_exists*/);
 
+            // Read the removal offsets before locking the master bank, so the
+            // master only stays locked while appending and writing tombstones.
+            concurrency_tag removals_ctag;
+            std::vector<unsigned __int64> offsets;
             if (reap_handles.m_handle_removals)
+            {
                 DIAG("... reap session file '%s'\n", removals.c_str());
 
+                bank_handles removals_handles;
+                removals_handles.m_handle_lines = reap_handles.m_handle_removals;
+                read_lock removals_lock(removals_handles);
+
+                char tmp[512];
+                read_lock::file_iter iter(removals_handles.m_handle_lines, tmp);
+                if (extract_ctag(iter, tmp, int(sizeof(tmp)), removals_ctag))
+                {
+                    for_each_removal_offset(removals_handles.m_handle_lines, tmp, int(sizeof(tmp)), [&] (unsigned __int64 offset)
+                    {
+                        offsets.push_back(offset);
+                    });
+                }
+            }
+
             {
                 // WARNING: ALWAYS LOCK MASTER BEFORE SESSION!
-                bank_handles master_handles = get_bank(bank_master);
-                master_handles.m_handle_removals = nullptr; // Don't redirect removals.
-                write_lock dest(master_handles);
+                bank_handles dest_handles = master_handles;
+                dest_handles.m_handle_removals = nullptr; // Don't redirect removals.
+                write_lock dest(dest_handles);
                 read_lock src(reap_handles);
                 if (src && dest)
                 {
                     dest.append(src);
-                    src.apply_removals(dest);
+
+                    // A compact may have rewritten the master and translated
+                    // the removals after they were read above.  In that case
+                    // reread them under the lock.
+                    concurrency_tag master_ctag;
+                    extract_ctag(dest, master_ctag);
+                    if (!removals_ctag.empty() && strcmp(master_ctag.get(), removals_ctag.get()) == 0)
+                        dest.remove_offsets(offsets);
+                    else
+                        src.apply_removals(dest);
                 }
             }
 
@@ -1227,6 +1749,52 @@ void history_db::reap()
     });
 }
 
+//------------------------------------------------------------------------------
+void history_db::reap_async()
+{
+    // Orphaned sessions are folded into the master bank by a background task
+    // so that closing several busy sessions doesn't delay the prompt in other
+    // sessions.
+    if (m_reap_task)
+    {
+        if (!m_reap_task->is_done())
+            return;
+        m_reap_task.reset();
+    }
+
+    m_reap_task = task_scheduler::get().submit(task_priority::background, [this] (task&) {
+        reap_background(this);
+    });
+}
+
+//------------------------------------------------------------------------------
+void history_db::wait_for_reap()
+{
+    if (m_reap_task)
+    {
+        m_reap_task->wait();
+        m_reap_task.reset();
+    }
+}
+
+//------------------------------------------------------------------------------
+void history_db::reap_background(const history_db* db)
+{
+    // Use a separate handle for the master bank so the file pointer isn't
+    // shared with the main thread.  The bank locks still serialize access.
+    bank_handles master_handles;
+    if (db->m_use_master_bank)
+    {
+        master_handles.m_handle_lines = open_file(db->m_bank_filenames[bank_master].c_str(), true/*if_exists*/);
+        if (!master_handles)
+            return;
+    }
+
+    db->reap(master_handles);
+
+    master_handles.close();
+}
+
 //------------------------------------------------------------------------------
 void history_db::initialise()
 {
@@ -1297,7 +1865,7 @@ void history_db::initialise()
         m_bank_handles[bank_session].m_handle_removals = make_removals_file(removals.c_str(), m_master_ctag.get());
     }
 
-    reap(); // collects orphaned history files.
+    reap_async(); // collects orphaned history files.
 }
 
 //------------------------------------------------------------------------------
@@ -1374,6 +1942,12 @@ void history_db::load_internal()
     m_master_len = 0;
     m_master_deleted_count = 0;
 
+    // The argument index carries over from the previous load.  Lines already
+    // reflected in it are recognized by content hash, so only lines added
+    // since then (e.g. by other sessions) get tokenised.
+    args_line_counts indexed;
+    indexed.swap(m_args_lines);
+
     history_read_buffer buffer;
 
     DIAG("... loading history\n");
@@ -1403,6 +1977,14 @@ void history_db::load_internal()
             buffer.data()[buffer_offset + out.length()] = '\0';
             add_history(line);
 
+            const unsigned __int64 hash = hash_line(line, out.length());
+            ++m_args_lines[hash];
+            auto found = indexed.find(hash);
+            if (found == indexed.end())
+                m_args.add(line);
+            else if (!--found->second)
+                indexed.erase(found);
+
             num_lines++;
 
             id.bank_index = bank_index;
@@ -1422,12 +2004,24 @@ void history_db::load_internal()
         return true;
     });
 
+    // Lines that are gone (removed or compacted away by another session) can't
+    // be subtracted without their text, so rebuild the index from scratch.
+    if (!indexed.empty())
+    {
+        DIAG("... rebuilding history args index\n");
+        m_args.clear();
+        if (HIST_ENTRY** list = history_list())
+            for (; *list; ++list)
+                m_args.add((*list)->line);
+    }
+
     DIAG("... total lines active %zu\n", m_index_map.size());
 }
 
 //------------------------------------------------------------------------------
 void history_db::load_rl_history(bool can_clean)
 {
+    flush_pending();
     load_internal();
 
     // The `clink history` command needs to be able to avoid cleaning the master
@@ -1444,6 +2038,9 @@ void history_db::clear()
 {
     DIAG("... clearing history\n");
 
+    m_pending_adds.clear();
+    wait_for_reap();
+
     for_each_bank([&] (unsigned int bank_index, write_lock& lock)
     {
         DIAG("... ... %s bank\n", bank_index == bank_master ? "master" : "session");
@@ -1461,6 +2058,8 @@ void history_db::clear()
     m_index_map.clear();
     m_master_len = 0;
     m_master_deleted_count = 0;
+    m_args.clear();
+    m_args_lines.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -1474,6 +2073,8 @@ void history_db::compact(bool force, bool uniq, int _limit)
         return;
     }
 
+    flush_pending();
+
     const bool explicit_limit = (_limit >= 0);
 
     size_t limit;
@@ -1509,7 +2110,7 @@ void history_db::compact(bool force, bool uniq, int _limit)
                 if (!remove(id))
                 {
                     LOG("failed to remove");
-                    DIAG("... ... failed to remove line at offset %u\n", id.offset);
+                    DIAG("... ... failed to remove line at offset %llu\n", static_cast<unsigned __int64>(id.offset));
                     break;
                 }
                 removed++;
@@ -1526,6 +2127,9 @@ void history_db::compact(bool force, bool uniq, int _limit)
     {
         DIAG("... compact:  rewrite master bank\n");
 
+        // Don't race with a background reap over the session files.
+        wait_for_reap();
+
         size_t kept, deleted, dups;
         assert(!m_master_ctag.empty());
 
@@ -1586,7 +2190,7 @@ void history_db::compact(bool force, bool uniq, int _limit)
         // Rewrite the master bank and apply the limit (if any).  This may also
         // optionally enforce uniqueness.  The result counters are written to
         // the log file.
-        std::map<line_id_impl, line_id_impl> remap_removals;
+        line_id_remap remap_removals;
         rewrite_master_bank(dest, limit, &kept, &deleted, uniq, &dups, &remap_removals);
 
         // Extract the new master concurrency tag.
@@ -1611,10 +2215,10 @@ void history_db::compact(bool force, bool uniq, int _limit)
             // Look up the ids and write the new ids for ones that were kept.
             for (const auto& id : r.m_lines)
             {
-                const auto iter = remap_removals.find(id);
-                if (iter != remap_removals.end())
+                const line_id_remap_entry* entry = find_remap(remap_removals, id);
+                if (entry)
                 {
-                    tmp.format("%u\n", iter->second.offset);
+                    tmp.format("%llu\n", static_cast<unsigned __int64>(entry->m_new.offset));
                     WriteFile(handle, tmp.c_str(), tmp.length(), &written, nullptr);
                 }
             }
@@ -1640,7 +2244,11 @@ void history_db::compact(bool force, bool uniq, int _limit)
 }
 
 //------------------------------------------------------------------------------
-bool history_db::add(const char* line)
+// Lines are gathered in m_pending_adds and committed as a group by
+// flush_pending().  When defer is true the line stays pending until the next
+// flush, so that a run of lines (e.g. queued lines being executed without
+// interactive editing) costs one lock acquisition and one write per bank.
+bool history_db::add(const char* line, bool defer)
 {
     // Ignore empty and/or whitespace prefixed lines?
     if (!line[0] || (g_ignore_space.get() && (line[0] == ' ' || line[0] == '\t')))
@@ -1651,28 +2259,85 @@ bool history_db::add(const char* line)
     {
     case 1:
         // 'ignore'
+        // The line isn't added again, but it's still a use of its arguments.
+        for (const auto& pending : m_pending_adds)
+            if (pending.equals(line))
+            {
+                m_args.add(line);
+                return true;
+            }
         if (line_id find_result = find(line))
+        {
+            m_args.add(line);
             return true;
+        }
         break;
 
     case 2:
         // 'erase_prev'
-        remove(line);
+        // Matching lines in the banks are removed when the group is flushed.
+        for (auto iter = m_pending_adds.begin(); iter != m_pending_adds.end(); ++iter)
+        {
+            if (iter->equals(line))
+            {
+                m_pending_adds.erase(iter);
+                break;
+            }
+        }
         break;
     }
 
-    // Add the line.
-    write_lock lock(get_bank(get_active_bank()));
-    if (!lock)
-        return false;
+    // Keep the argument index current, and remember how many copies of the
+    // line will be in the banks so the next load doesn't index it again.
+    // 'erase_prev' leaves exactly one copy.
+    m_pending_adds.emplace_back(line);
+    m_args.add(line);
+    unsigned int& copies = m_args_lines[hash_line(line, static_cast<unsigned int>(strlen(line)))];
+    copies = (g_dupe_mode.get() == 2) ? 1 : copies + 1;
 
-    lock.add(line);
-    return true;
+    return defer || flush_pending();
+}
+
+//------------------------------------------------------------------------------
+bool history_db::flush_pending()
+{
+    if (m_pending_adds.empty())
+        return true;
+
+    bool added = false;
+    const unsigned int active_bank = get_active_bank();
+    if (g_dupe_mode.get() == 2) // 'erase_prev'
+    {
+        for_each_bank([&] (unsigned int index, write_lock& lock)
+        {
+            lock.remove(m_pending_adds);
+            if (index == active_bank)
+            {
+                lock.add(m_pending_adds);
+                added = true;
+            }
+            return true;
+        });
+    }
+    else
+    {
+        write_lock lock(get_bank(active_bank));
+        if (lock)
+        {
+            lock.add(m_pending_adds);
+            added = true;
+        }
+    }
+
+    m_pending_adds.clear();
+    return added;
 }
 
 //------------------------------------------------------------------------------
 int history_db::remove(const char* line)
 {
+    flush_pending();
+
     int count = 0;
     for_each_bank([line, &count] (unsigned int index, write_lock& lock)
     {
@@ -1687,6 +2352,13 @@ int history_db::remove(const char* line)
         return true;
     });
 
+    if (count)
+    {
+        for (int i = count; i--;)
+            m_args.remove(line);
+        m_args_lines.erase(hash_line(line, static_cast<unsigned int>(strlen(line))));
+    }
+
     return count;
 }
 
@@ -1724,14 +2396,24 @@ bool history_db::remove_internal(line_id id, bool guard_ctag)
         }
     }
 
+    str_moveable line;
+    lock.read_line(id_impl.offset, line);
+
     if (!lock.remove(id_impl))
         return false;
 
+    if (!line.empty())
+    {
+        m_args.remove(line.c_str());
+        auto found = m_args_lines.find(hash_line(line.c_str(), line.length()));
+        if (found != m_args_lines.end() && !--found->second)
+            m_args_lines.erase(found);
+    }
+
     if (id_impl.bank_index == bank_master)
     {
-        auto last = m_index_map.begin() + m_master_len;
-        auto nth = std::lower_bound(m_index_map.begin(), last, id);
-        if (nth != last && id == *nth)
+        const size_t nth = m_index_map.find(0, m_master_len, id);
+        if (nth != m_master_len)
         {
             m_index_map.erase(nth);
             --m_master_len;
@@ -1742,9 +2424,8 @@ bool history_db::remove_internal(line_id id, bool guard_ctag)
     }
     else
     {
-        auto first = m_index_map.begin() + m_master_len;
-        auto nth = std::lower_bound(first, m_index_map.end(), id);
-        if (nth != m_index_map.end() && id == *nth)
+        const size_t nth = m_index_map.find(m_master_len, m_index_map.size(), id);
+        if (nth != m_index_map.size())
             m_index_map.erase(nth);
         else
             assert(m_index_map.empty()); // Index map is empty when using `clink history delete`.
@@ -1777,6 +2458,13 @@ history_db::line_id history_db::find(const char* line) const
     return ret.outer;
 }
 
+//------------------------------------------------------------------------------
+// The argument index is maintained by load_internal(), add(), and remove().
+bool history_db::get_args(const char* command, std::vector<history_arg>& out, unsigned int max)
+{
+    return m_args.get(command, out, max);
+}
+
 //------------------------------------------------------------------------------
 history_db::expand_result history_db::expand(const char* line, str_base& out)
 {
@@ -1794,6 +2482,8 @@ history_db::expand_result history_db::expand(const char* line, str_base& out)
 //------------------------------------------------------------------------------
 history_db::iter history_db::read_lines(char* buffer, unsigned int size)
 {
+    flush_pending();
+
     iter ret;
     if (size > sizeof(read_line_iter))
         ret.impl = uintptr_t(new (buffer) read_line_iter(*this, size));
@@ -4,9 +4,14 @@
 #pragma once
 
 #include <core/str_iter.h>
+#include <lib/history_args.h>
 
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
+class task;
+
 //------------------------------------------------------------------------------
 class concurrency_tag
 {
@@ -96,7 +101,7 @@ public:
         expand_print            = 2,
     };
 
-    typedef unsigned int        line_id;
+    typedef unsigned __int64    line_id;
 
     class iter
     {
@@ -118,11 +123,13 @@ public:
     void                        load_rl_history(bool can_clean=true);
     void                        clear();
     void                        compact(bool force=false, bool uniq=false, int limit=-1);
-    bool                        add(const char* line);
+    bool                        add(const char* line, bool defer=false);
+    bool                        flush_pending();
     int                         remove(const char* line);
     bool                        remove(line_id id) { return remove_internal(id, true); }
     bool                        remove(int rl_history_index, const char* line);
     line_id                     find(const char* line) const;
+    bool                        get_args(const char* command, std::vector<history_arg>& out, unsigned int max=0);
     template <int S> iter       read_lines(char (&buffer)[S]);
     iter                        read_lines(char* buffer, unsigned int buffer_size);
 
@@ -133,9 +140,37 @@ public:
     static expand_result        expand(const char* line, str_base& out);
 
 private:
+    typedef std::unordered_map<unsigned __int64, unsigned int> args_line_counts;
+
+    // Maps Readline history indices to line ids.  Ids are kept packed in 32
+    // bits while every offset fits in 29 bits (i.e. banks under 512 MB); the
+    // first id that doesn't fit switches the map to full 64 bit ids.
+    class line_id_map
+    {
+    public:
+        void                    clear();
+        size_t                  size() const;
+        bool                    empty() const { return !size(); }
+        line_id                 operator [] (size_t index) const;
+        void                    push_back(line_id id);
+        void                    erase(size_t index);
+        size_t                  find(size_t first, size_t last, line_id id) const;
+
+    private:
+        static bool             is_narrow(line_id id);
+        static unsigned int     to_narrow(line_id id);
+        static line_id          from_narrow(unsigned int id);
+        std::vector<unsigned int> m_narrow;
+        std::vector<line_id>    m_wide;
+        bool                    m_is_wide = false;
+    };
+
     friend                      class read_line_iter;
     void                        load_internal();
-    void                        reap();
+    void                        reap(const bank_handles& master_handles) const;
+    void                        reap_async();
+    void                        wait_for_reap();
+    static void                 reap_background(const history_db* db);
     template <typename T> void  for_each_bank(T&& callback);
     template <typename T> void  for_each_bank(T&& callback) const;
     template <typename T> void  for_each_session(T&& callback) const;
@@ -143,10 +178,14 @@ private:
     bank_handles                get_bank(unsigned int index) const;
     bool                        remove_internal(line_id id, bool guard_ctag);
     void*                       m_alive_file;
+    std::shared_ptr<task>       m_reap_task;
     bank_handles                m_bank_handles[bank_count];
     str<32>                     m_bank_filenames[bank_count];
     concurrency_tag             m_master_ctag;
-    std::vector<line_id>        m_index_map;
+    line_id_map                 m_index_map;
+    std::vector<str_moveable>   m_pending_adds;
+    history_args                m_args;
+    args_line_counts            m_args_lines;   // Copies of each line (by hash) reflected in m_args.
     size_t                      m_master_len;
     size_t                      m_master_deleted_count;
 
@@ -0,0 +1,33 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Tracks which startup stages are still deferred until the input is idle.
+// Stages run in bit order (history first, so that it's available as soon as
+// possible), one per idle callback unless everything must finish right away.
+class deferred_startup
+{
+public:
+    enum : unsigned char
+    {
+        history     = 0x01,
+        scripts     = 0x02,
+    };
+
+    void            defer(unsigned char stages) { m_pending |= stages; }
+    void            cancel(unsigned char stages) { m_pending &= ~stages; }
+    bool            is_pending(unsigned char stages=0xff) const { return !!(m_pending & stages); }
+
+    // Returns the stages to run now and marks them as no longer pending.
+    unsigned char   next(bool all)
+    {
+        const unsigned char stages = all ? m_pending : (m_pending & -m_pending);
+        m_pending &= ~stages;
+        return stages;
+    }
+
+private:
+    unsigned char   m_pending = 0;
+};
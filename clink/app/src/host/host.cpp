@@ -34,6 +34,7 @@ extern "C" {
 #include <lua.h>
 #include <lauxlib.h>
 #include <readline/readline.h>
+#include <readline/history.h>
 #include <readline/rldefs.h>
 #include <readline/rlprivate.h>
 }
@@ -113,13 +114,22 @@ static setting_bool g_reload_scripts(
     "effect at the next prompt.",
     false);
 
+static setting_bool g_progressive_startup(
+    "clink.progressive_startup",
+    "Show the first prompt before loading scripts",
+    "When enabled, the first prompt after Clink is injected is shown before Lua\n"
+    "scripts and history are loaded.  They finish loading while waiting for\n"
+    "input, and features such as prompt filtering and suggestions become\n"
+    "available once they are ready.  'clink info' reports the startup time.",
+    true);
+
 static setting_bool g_get_errorlevel(
     "cmd.get_errorlevel",
     "Retrieve last exit code",
-    "When this is enabled, Clink runs a hidden 'echo %errorlevel%' command before\n"
-    "each interactive input prompt to retrieve the last exit code for use by Lua\n"
-    "scripts.  If you experience problems, try turning this off.  This is on by\n"
-    "default.",
+    "When this is enabled, Clink runs a hidden command that reports %errorlevel%\n"
+    "before each interactive input prompt to retrieve the last exit code for use\n"
+    "by Lua scripts.  If you experience problems, try turning this off.  This is\n"
+    "on by default.",
     true);
 
 extern setting_bool g_classify_words;
@@ -133,7 +143,6 @@ extern bool get_sticky_search_history();
 extern bool has_sticky_search_position();
 extern bool get_sticky_search_add_history(const char* line);
 extern void clear_sticky_search_position();
-extern void reset_keyseq_to_name_map();
 extern void set_prompt(const char* prompt, const char* rprompt, bool redisplay);
 extern bool can_suggest(line_state& line);
 extern void set_suggestion(line_state& line, const char* suggestion, unsigned int offset);
@@ -143,6 +152,9 @@ extern void set_suggestion(line_state& line, const char* suggestion, unsigned in
 //------------------------------------------------------------------------------
 extern str<> g_last_prompt;
 
+//------------------------------------------------------------------------------
+static bool s_injected = false;
+
 
 
 //------------------------------------------------------------------------------
@@ -167,6 +179,41 @@ static void get_errorlevel_tmp_name(str_base& out, bool wild=false)
 }
 
 
+//------------------------------------------------------------------------------
+// Fallback errorlevel channel:  the hidden command redirects the echoed value
+// into a temporary file, which is read and deleted before the next prompt.
+class tmpfile_errorlevel_channel : public errorlevel_channel
+{
+public:
+    void get_command(str_base& out) override
+    {
+        str<> tmp_errfile;
+        get_errorlevel_tmp_name(tmp_errfile);
+        out.format(" echo %%errorlevel%% 2>nul >\"%s\"", tmp_errfile.c_str());
+    }
+
+    bool read(int& errorlevel) override
+    {
+        str<> tmp_errfile;
+        get_errorlevel_tmp_name(tmp_errfile);
+
+        FILE* f = fopen(tmp_errfile.c_str(), "r");
+        if (!f)
+            return false;
+
+        char buffer[32];
+        memset(buffer, 0, sizeof(buffer));
+        fgets(buffer, _countof(buffer) - 1, f);
+        fclose(f);
+        _unlink(tmp_errfile.c_str());
+        errorlevel = atoi(buffer);
+        return true;
+    }
+};
+
+static tmpfile_errorlevel_channel s_tmpfile_errorlevel_channel;
+
+
 
 //------------------------------------------------------------------------------
 class dir_history_entry : public no_copy
@@ -539,6 +586,37 @@ static void move_cursor_up_one_line()
 
 
 
+//------------------------------------------------------------------------------
+// Runs the deferred startup stages while the input is idle, one stage per idle
+// callback so that pending input is always serviced first.  Once all stages
+// are finished it simply forwards to the Lua input idle.
+class host::deferred_idle
+    : public input_idle
+{
+public:
+                    deferred_idle(host& host, input_idle* inner) : m_host(host), m_inner(inner) {}
+    void            reset() override { m_inner->reset(); }
+    bool            is_enabled() override { return m_host.m_deferred.is_pending() || m_inner->is_enabled(); }
+    unsigned        get_timeout() override { return m_host.m_deferred.is_pending() ? 0 : m_inner->get_timeout(); }
+    void*           get_waitevent() override { return m_inner->get_waitevent(); }
+    void            on_idle() override;
+
+private:
+    host&           m_host;
+    input_idle*     m_inner;
+};
+
+//------------------------------------------------------------------------------
+void host::deferred_idle::on_idle()
+{
+    if (m_host.m_deferred.is_pending())
+        m_host.run_deferred_startup(false);
+    else if (m_inner->is_enabled())
+        m_inner->on_idle();
+}
+
+
+
 //------------------------------------------------------------------------------
 host::host(const char* name)
 : m_name(name)
@@ -546,6 +624,7 @@ host::host(const char* name)
 {
     m_terminal = terminal_create();
     m_printer = new printer(*m_terminal.out);
+    m_startup_clock = os::clock();
 }
 
 //------------------------------------------------------------------------------
@@ -610,6 +689,13 @@ bool host::has_deprecated_argmatcher(const char* command)
     return has;
 }
 
+//------------------------------------------------------------------------------
+bool host::get_history_args(const char* command, std::vector<history_arg>& out, unsigned int max)
+{
+    out.clear();
+    return m_history && m_history->get_args(command, out, max);
+}
+
 //------------------------------------------------------------------------------
 int host::add_history(const char* line)
 {
@@ -625,7 +711,7 @@ int host::remove_history(int rl_history_index, const char* line)
 //------------------------------------------------------------------------------
 void host::filter_prompt()
 {
-    if (!g_prompt_async.get())
+    if (!g_prompt_async.get() || m_lua_pending)
         return;
 
     const char* rprompt = nullptr;
@@ -676,6 +762,7 @@ void host::filter_transient_prompt(bool final)
 bool host::can_suggest(line_state& line)
 {
     return (m_suggester &&
+            !m_lua_pending &&
             g_autosuggest_enable.get() &&
             ::can_suggest(line));
 }
@@ -683,7 +770,7 @@ bool host::can_suggest(line_state& line)
 //------------------------------------------------------------------------------
 void host::suggest(line_state& line, matches& matches)
 {
-    if (m_suggester && g_autosuggest_enable.get())
+    if (m_suggester && !m_lua_pending && g_autosuggest_enable.get())
     {
         str<> suggestion;
         unsigned int offset;
@@ -759,7 +846,6 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
     app->get_settings_path(settings_file);
     app->get_state_dir(state_dir);
     settings::load(settings_file.c_str());
-    reset_keyseq_to_name_map();
 
     // Set up the string comparison mode.
     static_assert(str_compare_scope::exact == 0, "g_ignore_case values must match str_compare_scope values");
@@ -782,7 +868,8 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         interactive = autostart.empty();
     }
 
-    // Run " echo %ERRORLEVEL% >tmpfile 2>nul" before every interactive prompt.
+    // Run a hidden command that reports %ERRORLEVEL% through the errorlevel
+    // channel before every interactive prompt.
     static bool s_inspect_errorlevel = true;
     bool inspect_errorlevel = false;
     if (g_get_errorlevel.get())
@@ -796,23 +883,10 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
             }
             else
             {
-                str<> tmp_errfile;
-                get_errorlevel_tmp_name(tmp_errfile);
-
-                FILE* f = fopen(tmp_errfile.c_str(), "r");
-                if (f)
-                {
-                    char buffer[32];
-                    memset(buffer, sizeof(buffer), 0);
-                    fgets(buffer, _countof(buffer) - 1, f);
-                    fclose(f);
-                    _unlink(tmp_errfile.c_str());
-                    os::set_errorlevel(atoi(buffer));
-                }
-                else
-                {
-                    os::set_errorlevel(0);
-                }
+                int errorlevel;
+                if (!get_errorlevel_channel()->read(errorlevel))
+                    errorlevel = 0;
+                os::set_errorlevel(errorlevel);
             }
             s_inspect_errorlevel = !s_inspect_errorlevel;
         }
@@ -854,11 +928,14 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         m_prompt_filter = nullptr;
         m_suggester = nullptr;
         m_lua = nullptr;
+        m_lua_pending = false;
+        // The new Lua state starts over, the same as at first startup.
+        m_deferred.cancel(deferred_startup::scripts);
         if (reload_settings)
             settings::load(settings_file.c_str());
     }
     if (!local_lua)
-        init_scripts = !m_lua;
+        init_scripts = !m_lua || m_lua_pending;
     if (!m_lua)
         m_lua = new host_lua;
     if (!m_prompt_filter)
@@ -867,6 +944,24 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         m_suggester = new suggester(*m_lua);
     host_lua& lua = *m_lua;
 
+    // Progressive startup:  until the first prompt after injection, loading
+    // scripts is deferred.  The first prompt is shown with only the built-in
+    // completion, and scripts and history finish loading while the input is
+    // idle.  Passes without an editor (e.g. the hidden errorlevel command)
+    // don't need scripts, so they simply leave them pending.
+    bool defer_startup = false;
+    if (init_scripts && !s_injected && g_progressive_startup.get())
+    {
+        defer_startup = init_editor;
+        init_scripts = false;
+        m_lua_pending = true;
+        if (defer_startup)
+        {
+            m_deferred.defer(deferred_startup::scripts);
+            initialise_readline("clink", state_dir.c_str());
+        }
+    }
+
     // Load scripts.
     if (init_scripts)
     {
@@ -876,18 +971,22 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         initialise_readline("clink", state_dir.c_str());
         initialise_lua(lua);
         lua.load_scripts();
+        m_lua_pending = false;
     }
 
     // Send oninject event; one time only.
-    static bool s_injected = false;
-    if (!s_injected)
+    if (!s_injected && !m_lua_pending)
     {
         s_injected = true;
         lua.send_event("oninject");
     }
 
+    // Settings were reloaded above, so bring setting handles up to date.
+    if (!m_lua_pending)
+        lua.refresh_settings();
+
     // Send onbeginedit event.
-    if (send_event)
+    if (send_event && !m_lua_pending)
         lua.send_event("onbeginedit");
 
     // Reset input idle.  Must happen before filtering the prompt, so that the
@@ -908,6 +1007,7 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
 
     // Create the editor and add components to it.
     line_editor* editor = nullptr;
+    deferred_idle idle(*this, lua);
 
     if (init_editor)
     {
@@ -916,9 +1016,16 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         editor->add_generator(file_match_generator());
         if (g_classify_words.get())
             editor->set_classifier(lua);
-        editor->set_input_idle(lua);
+        if (defer_startup)
+            editor->set_input_idle(&idle);
+        else
+            editor->set_input_idle(lua);
     }
 
+    // Commit history lines deferred while running queued lines.
+    if (m_history && m_queued_lines.empty())
+        m_history->flush_pending();
+
     if (init_history)
     {
         if (m_history &&
@@ -932,7 +1039,11 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         if (!m_history)
             m_history = new history_db(g_save_history.get());
 
-        if (m_history)
+        if (defer_startup)
+        {
+            m_deferred.defer(deferred_startup::history);
+        }
+        else if (m_history)
         {
             m_history->initialise();
             m_history->load_rl_history();
@@ -972,12 +1083,9 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         // CMD's internal %ERRORLEVEL% variable.
         if (inspect_errorlevel)
         {
-            str<> tmp_errfile;
-            get_errorlevel_tmp_name(tmp_errfile);
-
             m_terminal.out->begin();
             m_terminal.out->end();
-            out.format(" echo %%errorlevel%% 2>nul >\"%s\"", tmp_errfile.c_str());
+            get_errorlevel_channel()->get_command(out);
             resolved = true;
             ret = true;
             move_cursor_up_one_line();
@@ -1036,7 +1144,14 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
             }
             else
             {
+                update_startup_time();
                 ret = editor && editor->edit(out);
+
+                // Anything still deferred must finish before using history or
+                // sending events.
+                if (m_deferred.is_pending())
+                    run_deferred_startup(true);
+
                 if (!ret)
                     break;
             }
@@ -1095,9 +1210,10 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
                     break;
             }
 
-            // Add the line to the history.
+            // Add the line to the history.  While more queued lines remain,
+            // defer the write so the whole run is committed as a group.
             if (add_history)
-                m_history->add(out.c_str());
+                m_history->add(out.c_str(), !m_queued_lines.empty());
         }
 
         if (ret)
@@ -1146,6 +1262,7 @@ bool host::edit_line(const char* prompt, const char* rprompt, str_base& out)
         m_prompt_filter = nullptr;
         m_suggester = nullptr;
         m_lua = nullptr;
+        m_lua_pending = false;
     }
 
     m_prompt = nullptr;
@@ -1159,7 +1276,7 @@ const char* host::filter_prompt(const char** rprompt, bool transient)
 {
     m_filtered_prompt.clear();
     m_filtered_rprompt.clear();
-    if (g_filter_prompt.get() && m_prompt_filter)
+    if (g_filter_prompt.get() && m_prompt_filter && !m_lua_pending)
     {
         str_moveable tmp;
         str_moveable rtmp;
@@ -1193,6 +1310,79 @@ const char* host::filter_prompt(const char** rprompt, bool transient)
     return m_filtered_prompt.c_str();
 }
 
+//------------------------------------------------------------------------------
+void host::run_deferred_startup(bool all)
+{
+    const unsigned char stages = m_deferred.next(all);
+
+    if (stages & deferred_startup::history)
+    {
+        if (m_history)
+        {
+            m_history->initialise();
+            m_history->load_rl_history();
+            using_history();
+        }
+    }
+
+    if (stages & deferred_startup::scripts)
+    {
+        if (m_lua)
+        {
+            host_lua& lua = *m_lua;
+            initialise_lua(lua);
+            lua.load_scripts();
+            m_lua_pending = false;
+
+            // Same sequence as a normal startup in edit_line().
+            s_injected = true;
+            lua.send_event("oninject");
+            lua.refresh_settings();
+            lua.send_event("onbeginedit");
+
+            // Now that the prompt filters are loaded, apply them to the prompt
+            // that's already being shown.
+            if (!all && m_prompt)
+            {
+                const char* rprompt = nullptr;
+                const char* prompt = filter_prompt(&rprompt);
+                set_prompt(prompt, rprompt, true/*redisplay*/);
+            }
+        }
+    }
+
+    update_startup_time();
+}
+
+//------------------------------------------------------------------------------
+void host::update_startup_time()
+{
+    if (!m_startup_clock)
+        return;
+
+    const double now = os::clock();
+    if (!m_first_prompt_clock)
+        m_first_prompt_clock = now;
+
+    if (m_deferred.is_pending())
+        return;
+
+    // Publish the startup timing in the environment, where 'clink info' can
+    // find it.
+    str<64> tmp;
+    tmp.format("first prompt %u ms, ready %u ms",
+               unsigned((m_first_prompt_clock - m_startup_clock) * 1000),
+               unsigned((now - m_startup_clock) * 1000));
+    os::set_env("=clink.startup", tmp.c_str());
+    m_startup_clock = 0;
+}
+
+//------------------------------------------------------------------------------
+errorlevel_channel* host::get_errorlevel_channel()
+{
+    return &s_tmpfile_errorlevel_channel;
+}
+
 //------------------------------------------------------------------------------
 void host::purge_old_files()
 {
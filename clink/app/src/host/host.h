@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include "deferred_startup.h"
 #include "history/history_db.h"
 #include "terminal/terminal.h"
 
@@ -18,6 +19,17 @@ class host_lua;
 class prompt_filter;
 class suggester;
 
+//------------------------------------------------------------------------------
+// CMD keeps %ERRORLEVEL% internally, so before each interactive prompt the host
+// runs a hidden command that reports it through a channel.
+class errorlevel_channel
+{
+public:
+    virtual         ~errorlevel_channel() {}
+    virtual void    get_command(str_base& out) = 0;
+    virtual bool    read(int& errorlevel) = 0;
+};
+
 //------------------------------------------------------------------------------
 class host : public host_callbacks
 {
@@ -33,6 +45,7 @@ public:
     bool            dequeue_line(wstr_base& out);
 
     bool            has_deprecated_argmatcher(const char* command);
+    bool            get_history_args(const char* command, std::vector<history_arg>& out, unsigned int max);
 
     // host_callbacks:
     int             add_history(const char* line) override;
@@ -51,12 +64,16 @@ protected:
     bool            edit_line(const char* prompt, const char* rprompt, str_base& out);
     virtual void    initialise_lua(lua_state& lua) = 0;
     virtual void    initialise_editor_desc(line_editor::desc& desc) = 0;
+    virtual errorlevel_channel* get_errorlevel_channel();
 
 private:
     void            purge_old_files();
     void            update_last_cwd();
+    void            run_deferred_startup(bool all);
+    void            update_startup_time();
 
 private:
+    class           deferred_idle;
     const char*     m_name;
     doskey          m_doskey;
     doskey_alias    m_doskey_alias;
@@ -73,4 +90,8 @@ private:
     std::list<str_moveable> m_queued_lines;
     wstr_moveable   m_last_cwd;
     bool            m_can_transient = false;
+    bool            m_lua_pending = false;
+    deferred_startup m_deferred;
+    double          m_startup_clock = 0;
+    double          m_first_prompt_clock = 0;
 };
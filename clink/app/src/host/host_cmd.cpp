@@ -244,6 +244,12 @@ bool host_has_deprecated_argmatcher(const char* command)
     return host_cmd::get()->has_deprecated_argmatcher(command);
 }
 
+//------------------------------------------------------------------------------
+bool host_get_history_args(const char* command, std::vector<history_arg>& out, unsigned int max)
+{
+    return host_cmd::get()->get_history_args(command, out, max);
+}
+
 //------------------------------------------------------------------------------
 void host_cmd_enqueue_lines(std::list<str_moveable>& lines)
 {
@@ -564,11 +570,72 @@ bool host_cmd::capture_prompt(const wchar_t* chars, int char_count)
     return (m_prompt.get() != nullptr);
 }
 
+//------------------------------------------------------------------------------
+// In-memory errorlevel channel:  the hidden command assigns %ERRORLEVEL% to a
+// variable, and the SetEnvironmentVariableW hook captures the value without
+// storing it in the environment.  This avoids creating, reading, and deleting
+// a temporary file for every command.
+static const wchar_t c_errorlevel_var[] = L"__clink_errorlevel";
+
+class env_errorlevel_channel : public errorlevel_channel
+{
+public:
+    void get_command(str_base& out) override
+    {
+        m_captured = false;
+        out = " 2>nul set __clink_errorlevel=%errorlevel%";
+    }
+
+    bool read(int& errorlevel) override
+    {
+        // If the hook never saw the value, give up and let the host fall back
+        // to the temporary file channel.
+        if (!m_captured)
+        {
+            m_failed = true;
+            return false;
+        }
+
+        m_captured = false;
+        errorlevel = m_errorlevel;
+        return true;
+    }
+
+    void capture(const wchar_t* value)
+    {
+        m_errorlevel = _wtoi(value);
+        m_captured = true;
+    }
+
+    bool has_failed() const { return m_failed; }
+
+private:
+    int m_errorlevel = 0;
+    bool m_captured = false;
+    bool m_failed = false;
+};
+
+static env_errorlevel_channel s_env_errorlevel_channel;
+
+//------------------------------------------------------------------------------
+errorlevel_channel* host_cmd::get_errorlevel_channel()
+{
+    if (s_env_errorlevel_channel.has_failed())
+        return host::get_errorlevel_channel();
+    return &s_env_errorlevel_channel;
+}
+
 //------------------------------------------------------------------------------
 BOOL WINAPI host_cmd::set_env_var(const wchar_t* name, const wchar_t* value)
 {
     seh_scope seh;
 
+    if (value != nullptr && _wcsicmp(name, c_errorlevel_var) == 0)
+    {
+        s_env_errorlevel_channel.capture(value);
+        return TRUE;
+    }
+
     if (value == nullptr || _wcsicmp(name, L"prompt") != 0)
         return __Real_SetEnvironmentVariableW(name, value);
 
@@ -42,6 +42,7 @@ private:
     bool                initialise_system();
     virtual void        initialise_lua(lua_state& lua) override;
     virtual void        initialise_editor_desc(line_editor::desc& desc) override;
+    virtual errorlevel_channel* get_errorlevel_channel() override;
     void                make_aliases(str_base& clink, str_base& history);
     void                add_aliases(bool force);
     void                edit_line(wchar_t* chars, int max_chars);
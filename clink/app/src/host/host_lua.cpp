@@ -170,6 +170,12 @@ bool host_lua::send_event_cancelable_string_inout(const char* event_name, const
     return m_state.send_event_cancelable_string_inout(event_name, string, out);
 }
 
+//------------------------------------------------------------------------------
+void host_lua::refresh_settings()
+{
+    m_state.refresh_settings();
+}
+
 //------------------------------------------------------------------------------
 bool host_lua::call_lua_rl_global_function(const char* func_name, line_state* line)
 {
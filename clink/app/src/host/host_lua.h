@@ -25,6 +25,7 @@ public:
     bool                send_event(const char* event_name, int nargs=0);
     bool                send_event_cancelable(const char* event_name, int nargs=0);
     bool                send_event_cancelable_string_inout(const char* event_name, const char* string, str_base& out);
+    void                refresh_settings();
 
     bool                call_lua_rl_global_function(const char* func_name, line_state* line);
     void                call_lua_filter_matches(char** matches, int completion_type, int filename_completion_desired);
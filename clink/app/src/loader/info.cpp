@@ -51,6 +51,11 @@ int clink_info(int argc, char** argv)
     printf("%-*s : %s\n", spacing, "version", CLINK_VERSION_STR);
     printf("%-*s : %d\n", spacing, "session", context->get_id());
 
+    // Startup timing, as published by the injected Clink in this session.
+    str<64> startup;
+    if (os::get_env("=clink.startup", startup))
+        printf("%-*s : %s\n", spacing, "startup", startup.c_str());
+
     // Load the settings from disk, since script paths are affected by settings.
     str<280> settings_file;
     app_context::get()->get_settings_path(settings_file);
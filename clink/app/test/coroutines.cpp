@@ -2,11 +2,13 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "line_editor_tester.h"
 
 #include <core/base.h>
 #include <core/str.h>
 #include <core/path.h>
 #include <core/settings.h>
+#include <lua/lua_match_generator.h>
 #include <lua/lua_script_loader.h>
 #include <lua/lua_state.h>
 #include <lua/prompt.h>
@@ -319,3 +321,176 @@ TEST_CASE("Lua coroutines.")
 
     set_prompt_async_default();
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua generator coroutines.")
+{
+    lua_state lua;
+    lua_match_generator lua_generator(lua);
+
+    line_editor::desc desc(nullptr, nullptr, nullptr, nullptr);
+    line_editor_tester tester(desc, "&|", nullptr);
+    tester.get_editor()->add_generator(lua_generator);
+
+    const char* script = "\
+    _refreshed = 0\
+    _ready = false\
+    _branches = { 'main', 'feature', 'fix' }\
+    \
+    function clink._refreshmatches()\
+        _refreshed = _refreshed + 1\
+    end\
+    \
+    function set_ready()\
+        _ready = true\
+        return true\
+    end\
+    \
+    function remove_fix_branch()\
+        _branches = { 'main', 'feature' }\
+        return true\
+    end\
+    \
+    function resume_coroutines()\
+        if clink._has_coroutines() then\
+            clink._resume_coroutines()\
+            return true\
+        end\
+    end\
+    \
+    function verify_no_coroutines()\
+        return clink._has_coroutines() ~= true\
+    end\
+    \
+    function verify_refreshed_0()\
+        return _refreshed == 0\
+    end\
+    \
+    function verify_refreshed_1()\
+        return _refreshed == 1\
+    end\
+    \
+    function verify_refreshed_2()\
+        return _refreshed == 2\
+    end\
+    \
+    local function get_branches()\
+        while not _ready do\
+            coroutine.yield()\
+        end\
+        local branches = {}\
+        for _,branch in ipairs(_branches) do\
+            table.insert(branches, branch)\
+        end\
+        return branches\
+    end\
+    \
+    local g = clink.generator(1)\
+    function g:generate(line_state, match_builder)\
+        local first = line_state:getword(1)\
+        if first == 'checkout' then\
+            match_builder:addmatches(clink.generatorcoroutine(get_branches) or {}, 'word')\
+            return true\
+        elseif first == 'other' then\
+            match_builder:addmatch('other_match', 'word')\
+            return true\
+        end\
+    end\
+    ";
+
+    REQUIRE(lua.do_string(script));
+    lua.send_event("onbeginedit");
+
+    SECTION("Enabled")
+    {
+        set_prompt_async(true);
+
+        // Completion doesn't wait for the coroutine.
+        tester.set_input("checkout ");
+        tester.set_expected_matches();
+        tester.run();
+
+        REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+        REQUIRE(verify_ret_true(lua, "verify_refreshed_0"));
+
+        SECTION("Refresh")
+        {
+            // Finishing requests one refresh, and the result is cached.
+            REQUIRE(verify_ret_true(lua, "set_ready"));
+            REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+            REQUIRE(verify_ret_true(lua, "verify_refreshed_1"));
+            REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+
+            tester.set_input("checkout ");
+            tester.set_expected_matches("main", "feature", "fix");
+            tester.run();
+            REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+        }
+
+        SECTION("Other line text")
+        {
+            // Different line text gets its own coroutine.
+            tester.set_input("other & checkout ");
+            tester.set_expected_matches();
+            tester.run();
+
+            // Matches for other line text are current now, so finishing only
+            // caches the results without refreshing.
+            tester.set_input("other ");
+            tester.set_expected_matches("other_match");
+            tester.run();
+
+            REQUIRE(verify_ret_true(lua, "set_ready"));
+            REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+            REQUIRE(verify_ret_true(lua, "verify_refreshed_0"));
+            REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+
+            tester.set_input("checkout ");
+            tester.set_expected_matches("main", "feature", "fix");
+            tester.run();
+            tester.set_input("other & checkout ");
+            tester.set_expected_matches("main", "feature", "fix");
+            tester.run();
+        }
+
+        SECTION("Selected match disappears")
+        {
+            REQUIRE(verify_ret_true(lua, "set_ready"));
+            REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+            REQUIRE(verify_ret_true(lua, "verify_refreshed_1"));
+
+            tester.set_input("checkout f");
+            tester.set_expected_matches("feature", "fix");
+            tester.run();
+
+            // The next edit session regenerates, and 'fix' is gone.
+            lua.send_event("onbeginedit");
+            REQUIRE(verify_ret_true(lua, "remove_fix_branch"));
+            tester.set_input("checkout f");
+            tester.set_expected_matches();
+            tester.run();
+            REQUIRE(verify_ret_true(lua, "resume_coroutines"));
+            REQUIRE(verify_ret_true(lua, "verify_refreshed_2"));
+
+            tester.set_input("checkout f");
+            tester.set_expected_matches("feature");
+            tester.run();
+        }
+    }
+
+    SECTION("Disabled")
+    {
+        set_prompt_async(false);
+
+        // The coroutine runs to completion immediately.
+        REQUIRE(verify_ret_true(lua, "set_ready"));
+        tester.set_input("checkout ");
+        tester.set_expected_matches("main", "feature", "fix");
+        tester.run();
+
+        REQUIRE(verify_ret_true(lua, "verify_refreshed_0"));
+        REQUIRE(verify_ret_true(lua, "verify_no_coroutines"));
+    }
+
+    set_prompt_async_default();
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <host/deferred_startup.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Deferred startup")
+{
+    deferred_startup deferred;
+    REQUIRE(!deferred.is_pending());
+    REQUIRE(deferred.next(true) == 0);
+
+    deferred.defer(deferred_startup::scripts);
+    deferred.defer(deferred_startup::history);
+    REQUIRE(deferred.is_pending());
+    REQUIRE(deferred.is_pending(deferred_startup::history));
+    REQUIRE(deferred.is_pending(deferred_startup::scripts));
+
+    SECTION("One stage per idle")
+    {
+        // History comes first regardless of the order deferred.
+        REQUIRE(deferred.next(false) == deferred_startup::history);
+        REQUIRE(!deferred.is_pending(deferred_startup::history));
+        REQUIRE(deferred.is_pending());
+        REQUIRE(deferred.next(false) == deferred_startup::scripts);
+        REQUIRE(!deferred.is_pending());
+        REQUIRE(deferred.next(false) == 0);
+    }
+
+    SECTION("Finish all")
+    {
+        REQUIRE(deferred.next(true) == (deferred_startup::history|deferred_startup::scripts));
+        REQUIRE(!deferred.is_pending());
+    }
+
+    SECTION("Reload cancels scripts")
+    {
+        // Reloading scripts starts over with a new Lua state, so the deferred
+        // load must not run later against it.
+        deferred.cancel(deferred_startup::scripts);
+        REQUIRE(!deferred.is_pending(deferred_startup::scripts));
+        REQUIRE(deferred.next(true) == deferred_startup::history);
+
+        deferred.defer(deferred_startup::scripts);
+        REQUIRE(deferred.next(false) == deferred_startup::scripts);
+        REQUIRE(!deferred.is_pending());
+    }
+}
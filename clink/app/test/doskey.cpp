@@ -517,3 +517,45 @@ TEST_CASE("Doskey cursor point : multiple commands")
         doskey.remove_alias("az");
     }
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("Doskey compiled macro cache")
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        use_enhanced(i != 0);
+
+        doskey doskey("shell");
+        doskey.add_alias("alias", "one $1");
+
+        str<> line("alias two");
+
+        doskey_alias alias;
+        doskey.resolve(line.c_str(), alias);
+        REQUIRE(alias.next(line) == true);
+        REQUIRE(line.equals("one two") == true);
+
+        // Changing the alias through doskey invalidates the compiled macro.
+        doskey.add_alias("alias", "three $1$g");
+
+        line = "alias four";
+        doskey.resolve(line.c_str(), alias);
+        REQUIRE(alias.next(line) == true);
+        REQUIRE(line.equals("three four>") == true);
+
+        // Changes made behind doskey's back are seen in the next generation.
+        AddConsoleAliasW(const_cast<wchar_t*>(L"alias"), const_cast<wchar_t*>(L"five $*"), const_cast<wchar_t*>(L"shell"));
+        doskey::invalidate_aliases();
+
+        line = "alias six seven";
+        doskey.resolve(line.c_str(), alias);
+        REQUIRE(alias.next(line) == true);
+        REQUIRE(line.equals("five six seven") == true);
+
+        REQUIRE(doskey.remove_alias("alias") == true);
+
+        line = "alias";
+        doskey.resolve(line.c_str(), alias);
+        REQUIRE(bool(alias) == false);
+    }
+}
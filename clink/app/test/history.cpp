@@ -36,6 +36,8 @@ char* tgetstr(const char*, char**);
 struct test_history_db
     : public history_db
 {
+    typedef history_db::line_id_map index_map;
+
     test_history_db()
     : history_db(true/*use_master_bank*/)
     {
@@ -280,6 +282,75 @@ TEST_CASE("history db")
 
     }
 
+    SECTION("Grouped adds")
+    {
+        settings::find("history.shared")->set("true");
+        settings::find("history.dupe_mode")->set("erase_prev");
+
+        {
+            test_history_db history;
+            const int base_size = history.get_master_tag_size();
+
+            REQUIRE(history.add(line_set1[0], true/*defer*/));
+            REQUIRE(history.add(line_set1[1], true/*defer*/));
+            REQUIRE(history.add(line_set1[0], true/*defer*/));
+            REQUIRE(os::get_file_size(master_path) == base_size);
+
+            REQUIRE(history.flush_pending());
+            int line_bytes = int(strlen(line_set1[0]) + strlen(line_set1[1])) + 2;
+            REQUIRE(os::get_file_size(master_path) == base_size + line_bytes);
+
+            char buffer[256];
+            str_iter line;
+            history_db::iter iter = history.read_lines(buffer);
+            REQUIRE(iter.next(line));
+            REQUIRE(line.length() == strlen(line_set1[1]));
+            REQUIRE(strncmp(line.get_pointer(), line_set1[1], line.length()) == 0);
+            REQUIRE(iter.next(line));
+            REQUIRE(strncmp(line.get_pointer(), line_set1[0], line.length()) == 0);
+            REQUIRE(!iter.next(line));
+        }
+    }
+
+    SECTION("Args index")
+    {
+        settings::find("history.shared")->set("true");
+        settings::find("history.dupe_mode")->set("ignore");
+
+        test_history_db history;
+        history.load_rl_history(false);
+
+        REQUIRE(history.add("ssh host1"));
+        REQUIRE(history.add("ssh host2"));
+        REQUIRE(history.add("ssh host1"));
+
+        // Ignored duplicates still count as uses.
+        std::vector<history_arg> out;
+        REQUIRE(history.get_args("ssh", out));
+        REQUIRE(out.size() == 2);
+        REQUIRE(strcmp(out[0].arg, "host1") == 0);
+        REQUIRE(out[0].count == 2);
+
+        // Reloading keeps the index rather than rebuilding it.
+        history.load_rl_history(false);
+        REQUIRE(history.get_args("ssh", out));
+        REQUIRE(out.size() == 2);
+        REQUIRE(out[0].count == 2);
+
+        // Removing a line removes its args.
+        REQUIRE(history.remove_direct("ssh host2") == 1);
+        REQUIRE(history.get_args("ssh", out));
+        REQUIRE(out.size() == 1);
+        REQUIRE(strcmp(out[0].arg, "host1") == 0);
+
+        history.load_rl_history(false);
+        REQUIRE(history.get_args("ssh", out));
+        REQUIRE(out.size() == 1);
+
+        history.clear();
+        REQUIRE(!history.get_args("ssh", out));
+    }
+
     SECTION("line iter")
     {
         str<> lines;
@@ -316,6 +387,38 @@ TEST_CASE("history db")
     }
 }
 
+//------------------------------------------------------------------------------
+TEST_CASE("history line id map")
+{
+    // Bank index 1 and active bit set, as in ids from the history banks.
+    const history_db::line_id flags = 0xa000000000000000ull;
+    const history_db::line_id small_ids[] = { flags|0x10, flags|0x20, flags|0x1fffffff };
+    const history_db::line_id large_id = flags|0x20000000;
+
+    test_history_db::index_map map;
+    for (history_db::line_id id : small_ids)
+        map.push_back(id);
+
+    REQUIRE(map.size() == 3);
+    REQUIRE(map[2] == small_ids[2]);
+    REQUIRE(map.find(0, map.size(), small_ids[1]) == 1);
+    REQUIRE(map.find(0, map.size(), large_id) == map.size());
+
+    SECTION("Offsets beyond 512 MB")
+    {
+        map.push_back(large_id);
+
+        REQUIRE(map.size() == 4);
+        for (int i = 0; i < sizeof_array(small_ids); ++i)
+            REQUIRE(map[i] == small_ids[i]);
+        REQUIRE(map[3] == large_id);
+        REQUIRE(map.find(0, map.size(), large_id) == 3);
+
+        map.erase(0);
+        REQUIRE(map.find(0, map.size(), small_ids[1]) == 0);
+    }
+}
+
 //------------------------------------------------------------------------------
 TEST_CASE("history rl")
 {
@@ -726,6 +829,29 @@ TEST_CASE("history unique")
         REQUIRE(strcmp(history_get(2)->line, "aaa") == 0);
         REQUIRE(strcmp(history_get(3)->line, "bbb") == 0);
     }
+
+    SECTION("Unique spanning read buffers")
+    {
+        // Enough lines that the rewrite streams through several read buffers.
+        str<> line;
+        for (int i = 0; i < 20000; ++i)
+        {
+            line.format("line %d", i % 5000);
+            history.add(line.c_str());
+        }
+
+        history.compact(true/*force*/, true/*uniq*/);
+        history.load_rl_history();
+
+        REQUIRE(history.get_master_length() == 3 + 5000);
+        REQUIRE(history.get_master_deleted_count() == 0);
+
+        REQUIRE(strcmp(history_get(1)->line, "ccc") == 0);
+        REQUIRE(strcmp(history_get(2)->line, "aaa") == 0);
+        REQUIRE(strcmp(history_get(3)->line, "bbb") == 0);
+        REQUIRE(strcmp(history_get(4)->line, "line 0") == 0);
+        REQUIRE(strcmp(history_get(3 + 5000)->line, "line 4999") == 0);
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -806,6 +932,63 @@ TEST_CASE("history removals ctag")
         expect_files({master_path});
     }
 
+    SECTION("Reap applies removals")
+    {
+        char buffer[128];
+
+        static const char* history_lines[] = {
+            "echo alpha",
+            "echo bravo",
+            "echo charlie",
+            "echo delta",
+            "echo echo",
+        };
+
+        // Populate history.
+        {
+            test_history_db history;
+            history.clear();
+            history.load_rl_history(true); // initialize ctag
+
+            for(const char* line : history_lines)
+                REQUIRE(history.add(line));
+        }
+
+        expect_files({master_path});
+
+        // Queue several deferred deletions (in the .removals file).
+        {
+            test_history_db history;
+            history.load_rl_history(false);
+
+            REQUIRE(history.remove(history_lines[0]));
+            REQUIRE(history.remove(history_lines[2]));
+            REQUIRE(history.remove(history_lines[3]));
+        }
+
+        expect_files({master_path});
+
+        // Verify the removals were applied to the master bank when reaping.
+        {
+            FILE* file = fopen(master_path, "rb");
+            REQUIRE(file != nullptr);
+            REQUIRE(fgets(buffer, sizeof_array(buffer), file));
+            REQUIRE(strncmp(buffer, "|CTAG", 5) == 0);
+
+            for (int i = 0; i < sizeof_array(history_lines); ++i)
+            {
+                REQUIRE(fgets(buffer, sizeof_array(buffer), file));
+                strip_lf(buffer);
+                const bool removed = (i == 0 || i == 2 || i == 3);
+                REQUIRE((buffer[0] == '|') == removed);
+                REQUIRE(strcmp(buffer + 1, history_lines[i] + 1) == 0);
+            }
+
+            REQUIRE(!fgets(buffer, sizeof_array(buffer), file));
+            fclose(file);
+        }
+    }
+
     SECTION("Compact translates")
     {
         char buffer[128];
@@ -0,0 +1,155 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "str_iter.h"
+
+//------------------------------------------------------------------------------
+// Grapheme_Cluster_Break property values (UAX #29), plus Extended_Pictographic.
+enum class grapheme_break : unsigned char
+{
+    other,
+    cr,
+    lf,
+    control,
+    extend,
+    zwj,
+    regional_indicator,
+    prepend,
+    spacing_mark,
+    l,
+    v,
+    t,
+    lv,
+    lvt,
+    extended_pictographic,
+};
+
+grapheme_break get_grapheme_break(char32_t c);
+
+//------------------------------------------------------------------------------
+// Iterates over extended grapheme clusters, i.e. what the user perceives as a
+// single character:  a base plus combining marks, a Hangul syllable, a flag
+// (pair of regional indicators), an emoji ZWJ sequence, CR LF, etc.  Invalid
+// or partial UTF-8 ends iteration the same way str_iter does.
+template <typename T>
+class grapheme_iter_impl
+{
+public:
+    explicit        grapheme_iter_impl(const T* s, int len=-1);
+    int             next();
+    const T*        get_pointer() const { return m_iter.get_pointer(); }
+    const T*        get_cluster() const { return m_cluster; }
+    unsigned int    get_cluster_length() const { return (unsigned int)(m_iter.get_pointer() - m_cluster); }
+    int             get_first() const { return m_first; }
+    bool            is_emoji() const { return m_emoji; }
+    bool            more() const { return m_iter.more(); }
+
+private:
+    str_iter_impl<T> m_iter;
+    const T*        m_cluster;
+    int             m_first = 0;
+    bool            m_emoji = false;
+};
+
+//------------------------------------------------------------------------------
+template <typename T> grapheme_iter_impl<T>::grapheme_iter_impl(const T* s, int len)
+: m_iter(s, len)
+, m_cluster(s)
+{
+}
+
+//------------------------------------------------------------------------------
+// Consumes the next cluster and returns its first code point, or 0 at the end.
+// The cluster's extent is then available from get_cluster() and
+// get_cluster_length().
+template <typename T> int grapheme_iter_impl<T>::next()
+{
+    m_cluster = m_iter.get_pointer();
+    m_emoji = false;
+    m_first = m_iter.next();
+    if (!m_first)
+        return 0;
+
+    // Fast path:  there's always a break between two ASCII characters, except
+    // for CR LF.
+    if (m_first < 0x80 && m_first != '\r' &&
+        (!m_iter.more() || unsigned(*m_iter.get_pointer()) < 0x80))
+        return m_first;
+
+    grapheme_break prev = get_grapheme_break(m_first);
+    bool pict = (prev == grapheme_break::extended_pictographic);
+    bool pict_zwj = false;
+    unsigned int regional = (prev == grapheme_break::regional_indicator);
+
+    while (true)
+    {
+        const T* ptr = m_iter.get_pointer();
+        const int c = m_iter.next();
+        if (!c)
+        {
+            m_iter.reset_pointer(ptr);
+            break;
+        }
+
+        const grapheme_break gb = get_grapheme_break(c);
+        bool join;
+        if (prev == grapheme_break::cr)                                     // GB3, GB4
+            join = (gb == grapheme_break::lf);
+        else if (prev == grapheme_break::lf || prev == grapheme_break::control) // GB4
+            join = false;
+        else if (gb == grapheme_break::cr || gb == grapheme_break::lf || gb == grapheme_break::control) // GB5
+            join = false;
+        else if (prev == grapheme_break::l)                                 // GB6
+            join = (gb == grapheme_break::l || gb == grapheme_break::v ||
+                    gb == grapheme_break::lv || gb == grapheme_break::lvt ||
+                    gb == grapheme_break::extend || gb == grapheme_break::zwj ||
+                    gb == grapheme_break::spacing_mark);
+        else if ((prev == grapheme_break::lv || prev == grapheme_break::v) &&  // GB7
+                 (gb == grapheme_break::v || gb == grapheme_break::t))
+            join = true;
+        else if ((prev == grapheme_break::lvt || prev == grapheme_break::t) && // GB8
+                 gb == grapheme_break::t)
+            join = true;
+        else if (gb == grapheme_break::extend || gb == grapheme_break::zwj ||  // GB9, GB9a
+                 gb == grapheme_break::spacing_mark)
+            join = true;
+        else if (prev == grapheme_break::prepend)                           // GB9b
+            join = true;
+        else if (pict_zwj && gb == grapheme_break::extended_pictographic)   // GB11
+            join = m_emoji = true;
+        else if (regional == 1 && gb == grapheme_break::regional_indicator) // GB12, GB13
+            join = m_emoji = true;
+        else
+            join = false;                                                   // GB999
+
+        if (!join)
+        {
+            m_iter.reset_pointer(ptr);
+            break;
+        }
+
+        // Variation selector 16 and skin tone modifiers request emoji
+        // presentation.
+        if (c == 0xfe0f || (c >= 0x1f3fb && c <= 0x1f3ff))
+            m_emoji = true;
+
+        pict_zwj = (pict && gb == grapheme_break::zwj);
+        if (gb == grapheme_break::extended_pictographic)
+            pict = true;
+        else if (gb != grapheme_break::extend)
+            pict = false;
+        if (gb == grapheme_break::regional_indicator)
+            ++regional;
+        prev = gb;
+    }
+
+    return m_first;
+}
+
+
+
+//------------------------------------------------------------------------------
+typedef grapheme_iter_impl<char>    grapheme_iter;
+typedef grapheme_iter_impl<wchar_t> wgrapheme_iter;
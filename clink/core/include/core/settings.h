@@ -36,6 +36,7 @@ setting_iter        first();
 setting*            find(const char* name);
 bool                load(const char* file);
 bool                save(const char* file);
+unsigned int        get_generation();
 
 bool                sandboxed_set_setting(const char* name, const char* value);
 
@@ -103,6 +104,7 @@ protected:
     };
 
     static const char* get_loaded_value(const char* name);
+    static void     changed();
 };
 
 //------------------------------------------------------------------------------
@@ -160,6 +162,7 @@ template <typename T> setting_impl<T>::setting_impl(
 template <typename T> void setting_impl<T>::set()
 {
     m_store.value = T(m_default);
+    changed();
 }
 
 //------------------------------------------------------------------------------
@@ -76,13 +76,13 @@ protected:
     void                free_data();
 
 private:
-    typedef unsigned short ushort;
+    typedef unsigned int uint;
 
     TYPE*               m_data;
-    ushort              m_size : 15;
-    ushort              m_growable : 1;
-    mutable ushort      m_length : 15;
-    ushort              m_owns_ptr : 1;
+    uint                m_size : 31;
+    uint                m_growable : 1;
+    mutable uint        m_length : 31;
+    uint                m_owns_ptr : 1;
 };
 
 //------------------------------------------------------------------------------
@@ -151,9 +151,18 @@ bool str_impl<TYPE>::reserve(unsigned int new_size, bool exact)
         return false;
 
     if (!exact)
-        new_size = (new_size + 63) & ~63;
+    {
+        // Grow geometrically so that repeated appends cost amortized constant
+        // time, instead of reallocating for every small increment.
+        const unsigned long long geometric = m_size + (m_size >> 1);
+        unsigned long long rounded = (geometric > new_size) ? geometric : new_size;
+        rounded = (rounded + 63) & ~63ull;
+        if (rounded >= (1ull << 31))
+            rounded = new_size;
+        new_size = static_cast<unsigned int>(rounded);
+    }
 
-    const int old_size = m_size;
+    const unsigned int old_size = m_size;
     m_size = new_size;
     if (m_size != new_size)
     {
@@ -162,7 +171,12 @@ bool str_impl<TYPE>::reserve(unsigned int new_size, bool exact)
         return false;
     }
 
-    TYPE* new_data = (TYPE*)malloc(new_size * sizeof(TYPE));
+    TYPE* new_data = (TYPE*)malloc(size_t(new_size) * sizeof(TYPE));
+    if (!new_data)
+    {
+        m_size = old_size;
+        return false;
+    }
     memcpy(new_data, c_str(), old_size * sizeof(TYPE));
 
     free_data();
@@ -290,7 +304,7 @@ void str_impl<TYPE>::trim()
 
     if (pos > m_data)
     {
-        m_length -= ushort(pos - m_data);
+        m_length -= uint(pos - m_data);
         memmove(m_data, pos, (m_length + 1) * sizeof(m_data[0]));
     }
 }
@@ -19,6 +19,7 @@ public:
     void            truncate(unsigned int len);
     int             peek();
     int             next();
+    unsigned int    next_ascii(const T*& span, unsigned int max=~0u);
     bool            more() const;
     unsigned int    length() const;
 
@@ -89,6 +90,21 @@ template <typename T> int str_iter_impl<T>::peek()
     return ret;
 }
 
+//------------------------------------------------------------------------------
+// Consumes the run of ASCII characters (up to max) at the current position, so
+// callers can handle plain text in bulk instead of one code point at a time.
+// Returns the run's length and sets span to its start.
+template <typename T> unsigned int str_iter_impl<T>::next_ascii(const T*& span, unsigned int max)
+{
+    span = m_ptr;
+    while (max && m_ptr != m_end && unsigned(*m_ptr) - 1 < 0x7f)
+    {
+        ++m_ptr;
+        --max;
+    }
+    return (unsigned int)(m_ptr - span);
+}
+
 //------------------------------------------------------------------------------
 template <typename T> bool str_iter_impl<T>::more() const
 {
@@ -0,0 +1,104 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+enum class task_priority : unsigned char
+{
+    interactive,        // The user is waiting on it (e.g. the prompt).
+    idle,               // Work to do while waiting for input.
+    background,         // Housekeeping; may take as long as it needs.
+    blocking,           // Waits on something external (e.g. a child process).
+    max
+};
+
+//------------------------------------------------------------------------------
+// A unit of work queued in a task_scheduler.  The function receives the task so
+// it can poll is_cancelled() and stop early; cancellation is cooperative.
+class task
+{
+    friend class task_scheduler;
+
+public:
+    typedef std::function<void(task&)> func_t;
+
+    task_priority       get_priority() const { return m_priority; }
+    void                cancel();
+    bool                is_cancelled() const;
+    bool                is_done() const;
+    bool                wait(unsigned int timeout_ms=~0u);
+
+private:
+                        task(task_priority priority, func_t&& func, unsigned int deadline_ms);
+    bool                is_expired() const;
+    void                run();
+    void                finish();
+
+    typedef std::chrono::steady_clock clock;
+
+    func_t              m_func;
+    clock::time_point   m_deadline;
+    const task_priority m_priority;
+    const bool          m_has_deadline;
+    std::atomic<bool>   m_cancelled;
+    bool                m_done = false;
+    mutable std::mutex  m_mutex;
+    std::condition_variable m_done_cv;
+};
+
+//------------------------------------------------------------------------------
+// A small fixed pool of worker threads shared by background work, so that
+// thread creation cost is amortized.  Queued tasks run in priority order, and
+// background tasks are never allowed to occupy every worker.  Workers are
+// started on first use.
+//
+// Blocking tasks have their own budget of workers, started as needed and then
+// reused, so that waiting on child processes can't starve the fixed pool.
+//
+// On Windows the scheduler also sets an auto-reset event whenever a task
+// completes, so an input loop can wait on it alongside console input.
+class task_scheduler
+{
+public:
+                        task_scheduler(unsigned int workers=0, unsigned int blocking_workers=0);
+                        ~task_scheduler();
+    std::shared_ptr<task> submit(task_priority priority, task::func_t func, unsigned int deadline_ms=0);
+    void                shutdown();
+    unsigned int        get_worker_count() const { return m_worker_count; }
+    unsigned int        get_blocking_worker_count() const { return m_blocking_worker_count; }
+    void*               get_waitevent() const { return m_event; }
+
+    static task_scheduler& get();
+
+private:
+    void                start_workers();
+    void                start_blocking_worker();
+    std::shared_ptr<task> pop();
+    void                worker_proc();
+    void                blocking_worker_proc();
+    void                complete(task& t);
+
+    std::mutex          m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_wake_blocking;
+    std::deque<std::shared_ptr<task>> m_queues[int(task_priority::max)];
+    std::vector<std::thread> m_workers;
+    std::vector<std::thread> m_blocking_workers;
+    const unsigned int  m_worker_count;
+    const unsigned int  m_blocking_worker_count;
+    unsigned int        m_running_background = 0;
+    unsigned int        m_idle_blocking = 0;
+    bool                m_shutdown = false;
+    void*               m_event = nullptr;
+};
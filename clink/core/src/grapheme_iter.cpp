@@ -0,0 +1,28 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "grapheme_iter.h"
+#include "grapheme_tables.h" // Generated by graphemes.lua.
+
+//------------------------------------------------------------------------------
+grapheme_break get_grapheme_break(char32_t c)
+{
+    if (c < 0x20000)
+    {
+        const unsigned char packed = c_gb_blocks[c_gb_index[c >> 6]][(c & 0x3f) >> 1];
+        return grapheme_break((c & 1) ? (packed >> 4) : (packed & 0x0f));
+    }
+
+    // Plane 14 holds tags and variation selectors (Extend); the rest of it is
+    // format or reserved default-ignorable code points (Control).  The
+    // generator checks that this still agrees with the database.
+    if (c >= 0xe0000 && c <= 0xe0fff)
+    {
+        if ((c >= 0xe0020 && c <= 0xe007f) || (c >= 0xe0100 && c <= 0xe01ef))
+            return grapheme_break::extend;
+        return grapheme_break::control;
+    }
+
+    return grapheme_break::other;
+}
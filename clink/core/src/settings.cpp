@@ -27,6 +27,7 @@ typedef std::map<std::string, loaded_setting> loaded_settings_map;
 static setting_map* g_setting_map = nullptr;
 static loaded_settings_map* g_loaded_settings = nullptr;
 static str_moveable* g_last_file = nullptr;
+static unsigned int s_generation = 0;
 
 #ifdef DEBUG
 static bool s_ever_loaded = false;
@@ -258,6 +259,10 @@ bool load(const char* file)
 
     get_loaded_map().clear();
 
+    // Loading may change any setting, so consumers that cache setting values
+    // must refresh them.
+    s_generation++;
+
     // Maybe migrate settings.
     str<> old_file;
     bool migrating = false;
@@ -441,6 +446,14 @@ static bool save_internal(const char* file, bool migrating)
     return true;
 }
 
+//------------------------------------------------------------------------------
+// Returns a counter that changes whenever settings are (re)loaded, so that
+// cached setting values can cheaply tell whether they may be stale.
+unsigned int get_generation()
+{
+    return s_generation;
+}
+
 //------------------------------------------------------------------------------
 bool save(const char* file)
 {
@@ -540,27 +553,34 @@ const char* setting::get_loaded_value(const char* name)
     return loaded->second.value.c_str();
 }
 
-
-
 //------------------------------------------------------------------------------
-template <> bool setting_impl<bool>::set(const char* value)
+// Consumers that cache setting values (e.g. Lua setting handles) compare the
+// generation to know when to refresh, so any change to a value must bump it.
+void setting::changed()
 {
-    if (stricmp(value, "true") == 0)  { m_store.value = 1; return true; }
-    if (stricmp(value, "false") == 0) { m_store.value = 0; return true; }
+    s_generation++;
+}
 
-    if (stricmp(value, "on") == 0)    { m_store.value = 1; return true; }
-    if (stricmp(value, "off") == 0)   { m_store.value = 0; return true; }
 
-    if (stricmp(value, "yes") == 0)   { m_store.value = 1; return true; }
-    if (stricmp(value, "no") == 0)    { m_store.value = 0; return true; }
 
-    if (*value >= '0' && *value <= '9')
-    {
-        m_store.value = !!atoi(value);
-        return true;
-    }
+//------------------------------------------------------------------------------
+template <> bool setting_impl<bool>::set(const char* value)
+{
+    bool parsed;
+    if (stricmp(value, "true") == 0)        parsed = true;
+    else if (stricmp(value, "false") == 0)  parsed = false;
+    else if (stricmp(value, "on") == 0)     parsed = true;
+    else if (stricmp(value, "off") == 0)    parsed = false;
+    else if (stricmp(value, "yes") == 0)    parsed = true;
+    else if (stricmp(value, "no") == 0)     parsed = false;
+    else if (*value >= '0' && *value <= '9')
+        parsed = !!atoi(value);
+    else
+        return false;
 
-    return false;
+    m_store.value = parsed;
+    changed();
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -570,6 +590,7 @@ template <> bool setting_impl<int>::set(const char* value)
         return false;
 
     m_store.value = atoi(value);
+    changed();
     return true;
 }
 
@@ -577,6 +598,7 @@ template <> bool setting_impl<int>::set(const char* value)
 template <> bool setting_impl<const char*>::set(const char* value)
 {
     m_store.value = value;
+    changed();
     return true;
 }
 
@@ -653,6 +675,7 @@ bool setting_enum::set(const char* value)
             (by_int < 0 && _strnicmp(option, value, option_len) == 0))
         {
             m_store.value = i;
+            changed();
             return true;
         }
 
@@ -5,9 +5,7 @@
 #include "str.h"
 #include "str_iter.h"
 
-#ifdef USE_OS_UTF_CONVERSION
 #include <assert.h>
-#endif
 
 //------------------------------------------------------------------------------
 template <typename TYPE>
@@ -18,6 +16,7 @@ struct builder
     bool        truncated() const                     { return (start && write >= end); }
     int         get_written() const                   { return int(write - start); }
     builder&    operator << (int value);
+    void        append_ascii(const char* ascii, unsigned int count);
     TYPE*       write;
     const TYPE* start;
     const TYPE* end;
@@ -32,6 +31,20 @@ builder<TYPE>::builder(TYPE* data, int max_length)
 {
 }
 
+//------------------------------------------------------------------------------
+template <typename TYPE>
+void builder<TYPE>::append_ascii(const char* ascii, unsigned int count)
+{
+    if (!start)
+    {
+        write += count;
+        return;
+    }
+
+    assert(write + count <= end);
+    for (const char* stop = ascii + count; ascii < stop;)
+        *write++ = TYPE(*ascii++);
+}
 //------------------------------------------------------------------------------
 template <>
 builder<wchar_t>& builder<wchar_t>::operator << (int value)
@@ -200,8 +213,18 @@ int to_utf16(wchar_t* out, int max_count, str_iter& iter)
 
     int c;
     while (!builder.truncated() && (c = iter.next()))
+    {
         builder << c;
 
+        // Copy the rest of a run of ASCII without decoding it.
+        if (c < 0x80)
+        {
+            const char* ascii;
+            const unsigned int room = builder.start ? unsigned(builder.end - builder.write) : ~0u;
+            builder.append_ascii(ascii, iter.next_ascii(ascii, room));
+        }
+    }
+
     return builder.get_written();
 }
 
@@ -4,6 +4,29 @@
 #include "pch.h"
 #include "str_iter.h"
 
+//------------------------------------------------------------------------------
+// UTF-8 decoding is table driven:  each byte maps to the number of bytes that
+// follow it (0 for ASCII and continuation bytes, 1-3 for lead bytes).  This
+// reproduces the decoder's long-standing lenient behavior exactly:
+// continuation bytes aren't validated, a lead byte where a final byte is
+// expected restarts the sequence, and 0xf8-0xff act like 4 byte leads.
+static const unsigned char c_utf8_follow[256] =
+{
+#define X4(x)   x, x, x, x
+#define X16(x)  X4(x), X4(x), X4(x), X4(x)
+#define X64(x)  X16(x), X16(x), X16(x), X16(x)
+    X64(0),                         // 0x00-0x3f
+    X64(0),                         // 0x40-0x7f
+    X64(0),                         // 0x80-0xbf
+    X16(1),                         // 0xc0-0xcf
+    X16(1),                         // 0xd0-0xdf
+    X16(2),                         // 0xe0-0xef
+    X16(3),                         // 0xf0-0xff
+#undef X64
+#undef X16
+#undef X4
+};
+
 //------------------------------------------------------------------------------
 template <>
 int str_iter_impl<char>::next()
@@ -11,30 +34,34 @@ int str_iter_impl<char>::next()
     if (!more())
         return 0;
 
+    // Fast path for ASCII.
+    unsigned int c = (unsigned char)*m_ptr++;
+    if (c < 0x80)
+        return c;
+
     int ax = 0;
-    int encode_length = 0;
-    while (int c = (unsigned char)*m_ptr++)
+    while (true)
     {
-        ax = (ax << 6) | (c & 0x7f);
-        if (encode_length)
-        {
-            --encode_length;
-            continue;
-        }
+        const unsigned int follow = c_utf8_follow[c];
+        if (!follow)
+            return (ax << 6) | (c & 0x7f);
 
-        if ((c & 0xc0) < 0xc0)
-            return ax;
-
-        if (encode_length = !!(c & 0x20))
-            encode_length += !!(c & 0x10);
+        // A lead byte at the end of the string is a partial sequence.
+        ax = c & (0x3f >> follow);
+        if (!more())
+            return 0;
 
-        ax &= (0x1f >> encode_length);
+        // All but the final byte are accumulated unconditionally.
+        for (unsigned int n = follow - 1; n--;)
+        {
+            if (!(c = (unsigned char)*m_ptr++))
+                return 0;
+            ax = (ax << 6) | (c & 0x7f);
+        }
 
-        if (!more())
-            break;
+        if (!(c = (unsigned char)*m_ptr++))
+            return 0;
     }
-
-    return 0;
 }
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,305 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "task_scheduler.h"
+
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+task::task(task_priority priority, func_t&& func, unsigned int deadline_ms)
+: m_func(std::move(func))
+, m_deadline(clock::now() + std::chrono::milliseconds(deadline_ms))
+, m_priority(priority)
+, m_has_deadline(deadline_ms != 0)
+, m_cancelled(false)
+{
+}
+
+//------------------------------------------------------------------------------
+void task::cancel()
+{
+    m_cancelled = true;
+}
+
+//------------------------------------------------------------------------------
+// A task whose deadline has passed counts as cancelled.
+bool task::is_cancelled() const
+{
+    return m_cancelled || is_expired();
+}
+
+//------------------------------------------------------------------------------
+bool task::is_expired() const
+{
+    return m_has_deadline && clock::now() >= m_deadline;
+}
+
+//------------------------------------------------------------------------------
+bool task::is_done() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_done;
+}
+
+//------------------------------------------------------------------------------
+bool task::wait(unsigned int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (timeout_ms == ~0u)
+    {
+        m_done_cv.wait(lock, [this] () { return m_done; });
+        return true;
+    }
+
+    return m_done_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] () { return m_done; });
+}
+
+//------------------------------------------------------------------------------
+void task::run()
+{
+    // Tasks cancelled or expired while still queued are not started.
+    if (!is_cancelled())
+        m_func(*this);
+
+    // Release anything the function captured, now rather than whenever the
+    // last reference to the task goes away.
+    m_func = nullptr;
+}
+
+//------------------------------------------------------------------------------
+void task::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+    }
+    m_done_cv.notify_all();
+}
+
+
+
+//------------------------------------------------------------------------------
+static unsigned int get_default_worker_count()
+{
+    const unsigned int cpus = std::thread::hardware_concurrency();
+    return (cpus < 2) ? 2 : (cpus > 4) ? 4 : cpus;
+}
+
+//------------------------------------------------------------------------------
+// Blocking tasks mostly sit in ReadFile or WaitForSingleObject, so the budget
+// is about how many child processes can be serviced at once, not about CPUs.
+static const unsigned int c_default_blocking_workers = 16;
+
+//------------------------------------------------------------------------------
+task_scheduler::task_scheduler(unsigned int workers, unsigned int blocking_workers)
+: m_worker_count(workers ? workers : get_default_worker_count())
+, m_blocking_worker_count(blocking_workers ? blocking_workers : c_default_blocking_workers)
+{
+#ifdef _WIN32
+    m_event = CreateEvent(nullptr, false, false, nullptr);
+#endif
+}
+
+//------------------------------------------------------------------------------
+task_scheduler::~task_scheduler()
+{
+    shutdown();
+
+#ifdef _WIN32
+    if (m_event)
+        CloseHandle(m_event);
+#endif
+}
+
+//------------------------------------------------------------------------------
+// Cancels queued tasks, waits for running tasks to return, and stops the
+// workers.  Tasks submitted afterwards complete immediately without running.
+void task_scheduler::shutdown()
+{
+    std::vector<std::shared_ptr<task>> cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_shutdown = true;
+        for (auto& queue : m_queues)
+        {
+            for (auto& t : queue)
+                cancelled.emplace_back(std::move(t));
+            queue.clear();
+        }
+    }
+    m_wake.notify_all();
+    m_wake_blocking.notify_all();
+
+    for (auto& t : cancelled)
+    {
+        t->cancel();
+        t->run();
+        t->finish();
+    }
+
+    for (auto& worker : m_workers)
+        worker.join();
+    m_workers.clear();
+
+    for (auto& worker : m_blocking_workers)
+        worker.join();
+    m_blocking_workers.clear();
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<task> task_scheduler::submit(task_priority priority, task::func_t func, unsigned int deadline_ms)
+{
+    assert(priority < task_priority::max);
+
+    std::shared_ptr<task> t(new task(priority, std::move(func), deadline_ms));
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_shutdown)
+        {
+            m_queues[int(priority)].push_back(t);
+            if (priority == task_priority::blocking)
+            {
+                start_blocking_worker();
+                m_wake_blocking.notify_one();
+            }
+            else
+            {
+                start_workers();
+                m_wake.notify_one();
+            }
+            return t;
+        }
+    }
+
+    t->cancel();
+    t->run();
+    t->finish();
+    return t;
+}
+
+//------------------------------------------------------------------------------
+void task_scheduler::start_workers()
+{
+    if (!m_workers.empty())
+        return;
+
+    m_workers.reserve(m_worker_count);
+    for (unsigned int i = 0; i < m_worker_count; ++i)
+        m_workers.emplace_back(&task_scheduler::worker_proc, this);
+}
+
+//------------------------------------------------------------------------------
+// Must be called with m_mutex held.  Starts another blocking worker if there
+// are more queued blocking tasks than idle blocking workers, up to the budget.
+void task_scheduler::start_blocking_worker()
+{
+    const auto& queue = m_queues[int(task_priority::blocking)];
+    if (queue.size() <= m_idle_blocking)
+        return;
+    if (m_blocking_workers.size() >= m_blocking_worker_count)
+        return;
+
+    m_blocking_workers.emplace_back(&task_scheduler::blocking_worker_proc, this);
+}
+
+//------------------------------------------------------------------------------
+// Must be called with m_mutex held.  Blocking tasks are left for the blocking
+// workers.
+std::shared_ptr<task> task_scheduler::pop()
+{
+    for (int i = 0; i < int(task_priority::blocking); ++i)
+    {
+        auto& queue = m_queues[i];
+        if (queue.empty())
+            continue;
+
+        // Keep one worker free for interactive and idle tasks.
+        if (task_priority(i) == task_priority::background &&
+            m_worker_count > 1 &&
+            m_running_background >= m_worker_count - 1)
+            break;
+
+        std::shared_ptr<task> t = std::move(queue.front());
+        queue.pop_front();
+        if (task_priority(i) == task_priority::background)
+            ++m_running_background;
+        return t;
+    }
+
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+void task_scheduler::worker_proc()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        std::shared_ptr<task> t;
+        m_wake.wait(lock, [this, &t] () {
+            return m_shutdown || (t = pop()) != nullptr;
+        });
+
+        if (!t)
+            break;
+
+        lock.unlock();
+        complete(*t);
+        lock.lock();
+
+        if (t->get_priority() == task_priority::background)
+        {
+            --m_running_background;
+            m_wake.notify_one();
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void task_scheduler::blocking_worker_proc()
+{
+    auto& queue = m_queues[int(task_priority::blocking)];
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        ++m_idle_blocking;
+        m_wake_blocking.wait(lock, [this, &queue] () {
+            return m_shutdown || !queue.empty();
+        });
+        --m_idle_blocking;
+
+        if (queue.empty())
+            break;
+
+        std::shared_ptr<task> t = std::move(queue.front());
+        queue.pop_front();
+
+        lock.unlock();
+        complete(*t);
+        lock.lock();
+    }
+}
+
+//------------------------------------------------------------------------------
+void task_scheduler::complete(task& t)
+{
+    t.run();
+    t.finish();
+
+#ifdef _WIN32
+    if (m_event)
+        SetEvent(m_event);
+#endif
+}
+
+//------------------------------------------------------------------------------
+task_scheduler& task_scheduler::get()
+{
+    // Intentionally never destroyed:  joining threads from a static destructor
+    // while the DLL unloads would deadlock on the loader lock.
+    static task_scheduler* s_scheduler = new task_scheduler();
+    return *s_scheduler;
+}
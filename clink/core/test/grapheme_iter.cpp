@@ -0,0 +1,128 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/grapheme_iter.h>
+
+#include <new>
+
+//------------------------------------------------------------------------------
+static void verify_clusters(const char* s, std::initializer_list<unsigned int> lengths)
+{
+    grapheme_iter iter(s);
+    for (unsigned int length : lengths)
+    {
+        REQUIRE(iter.next() != 0);
+        REQUIRE(iter.get_cluster_length() == length);
+    }
+    REQUIRE(iter.next() == 0);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Grapheme clusters")
+{
+    SECTION("Properties")
+    {
+        REQUIRE(get_grapheme_break('a') == grapheme_break::other);
+        REQUIRE(get_grapheme_break('\r') == grapheme_break::cr);
+        REQUIRE(get_grapheme_break('\n') == grapheme_break::lf);
+        REQUIRE(get_grapheme_break(0x7f) == grapheme_break::control);
+        REQUIRE(get_grapheme_break(0x0301) == grapheme_break::extend);
+        REQUIRE(get_grapheme_break(0x0600) == grapheme_break::prepend);
+        REQUIRE(get_grapheme_break(0x0903) == grapheme_break::spacing_mark);
+        REQUIRE(get_grapheme_break(0x1100) == grapheme_break::l);
+        REQUIRE(get_grapheme_break(0x1161) == grapheme_break::v);
+        REQUIRE(get_grapheme_break(0x11a8) == grapheme_break::t);
+        REQUIRE(get_grapheme_break(0xac00) == grapheme_break::lv);
+        REQUIRE(get_grapheme_break(0xac01) == grapheme_break::lvt);
+        REQUIRE(get_grapheme_break(0x200d) == grapheme_break::zwj);
+        REQUIRE(get_grapheme_break(0xfe0f) == grapheme_break::extend);
+        REQUIRE(get_grapheme_break(0x1f1e6) == grapheme_break::regional_indicator);
+        REQUIRE(get_grapheme_break(0x1f3fd) == grapheme_break::extend);
+        REQUIRE(get_grapheme_break(0x1f600) == grapheme_break::extended_pictographic);
+        REQUIRE(get_grapheme_break(0x20000) == grapheme_break::other);
+        REQUIRE(get_grapheme_break(0xe0001) == grapheme_break::control);
+        REQUIRE(get_grapheme_break(0xe0061) == grapheme_break::extend);
+    }
+
+    SECTION("ASCII")
+    {
+        verify_clusters("", {});
+        verify_clusters("abc", { 1, 1, 1 });
+        verify_clusters("a\r\nb\n\r", { 1, 2, 1, 1, 1 });
+    }
+
+    SECTION("Combining marks")
+    {
+        verify_clusters("e\xcc\x81x", { 3, 1 });                 // e U+0301 x
+        verify_clusters("\xcc\x81" "a", { 2, 1 });               // Leading U+0301.
+        verify_clusters("\xd8\x80" "a" "b", { 3, 1 });           // U+0600 prepends.
+        verify_clusters("\xe0\xa4\x95\xe0\xa4\x83", { 6 });      // U+0915 U+0903
+        verify_clusters("\r\xcc\x81", { 1, 2 });                 // Controls don't extend.
+    }
+
+    SECTION("Hangul")
+    {
+        verify_clusters("\xe1\x84\x80\xe1\x85\xa1\xe1\x86\xa8", { 9 });   // L V T
+        verify_clusters("\xea\xb0\x80\xe1\x86\xa8" "a", { 6, 1 });        // LV T
+        verify_clusters("\xea\xb0\x81\xe1\x85\xa1", { 3, 3 });            // LVT V
+    }
+
+    SECTION("Emoji")
+    {
+        grapheme_iter iter("\xf0\x9f\x87\xba\xf0\x9f\x87\xb8"       // U+1F1FA U+1F1F8
+                           "\xf0\x9f\x87\xab\xf0\x9f\x87\xb7"       // U+1F1EB U+1F1F7
+                           "\xf0\x9f\x87\xa6");                     // U+1F1E6
+        REQUIRE(iter.next() == 0x1f1fa);
+        REQUIRE(iter.get_cluster_length() == 8);
+        REQUIRE(iter.is_emoji());
+        REQUIRE(iter.next() == 0x1f1eb);
+        REQUIRE(iter.get_cluster_length() == 8);
+        REQUIRE(iter.next() == 0x1f1e6);
+        REQUIRE(iter.get_cluster_length() == 4);
+        REQUIRE(!iter.is_emoji());
+        REQUIRE(iter.next() == 0);
+
+        // Family:  U+1F468 ZWJ U+1F469 ZWJ U+1F467.
+        new (&iter) grapheme_iter("\xf0\x9f\x91\xa8\xe2\x80\x8d\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x91\xa7" "a");
+        REQUIRE(iter.next() == 0x1f468);
+        REQUIRE(iter.get_cluster_length() == 18);
+        REQUIRE(iter.is_emoji());
+        REQUIRE(iter.next() == 'a');
+        REQUIRE(!iter.is_emoji());
+
+        // ZWJ only joins pictographs.
+        verify_clusters("a\xe2\x80\x8d\xf0\x9f\x91\xa8", { 4, 4 });
+
+        // Skin tone modifier, and variation selector 16.
+        new (&iter) grapheme_iter("\xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd" "\xe2\x9d\xa4\xef\xb8\x8f");
+        REQUIRE(iter.next() == 0x1f44d);
+        REQUIRE(iter.get_cluster_length() == 8);
+        REQUIRE(iter.is_emoji());
+        REQUIRE(iter.next() == 0x2764);
+        REQUIRE(iter.get_cluster_length() == 6);
+        REQUIRE(iter.is_emoji());
+        REQUIRE(iter.next() == 0);
+    }
+
+    SECTION("Subset")
+    {
+        grapheme_iter iter("e\xcc\x81x", 3);
+        REQUIRE(iter.next() == 'e');
+        REQUIRE(iter.get_cluster_length() == 3);
+        REQUIRE(iter.next() == 0);
+
+        // Truncated sequence.
+        verify_clusters("e\xcc", { 1 });
+    }
+
+    SECTION("Wide")
+    {
+        wgrapheme_iter iter(L"e\u0301x");
+        REQUIRE(iter.next() == 'e');
+        REQUIRE(iter.get_cluster_length() == 2);
+        REQUIRE(iter.next() == 'x');
+        REQUIRE(iter.next() == 0);
+    }
+}
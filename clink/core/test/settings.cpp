@@ -204,3 +204,31 @@ TEST_CASE("settings : color")
     test.get_descriptive(tmp);
     REQUIRE(tmp.equals("bright yellow"));
 }
+
+//------------------------------------------------------------------------------
+TEST_CASE("settings : generation")
+{
+    setting_bool test_bool("one", "", "", false);
+    setting_enum test_enum("two", "", "abc,def", 0);
+
+    unsigned int gen = settings::get_generation();
+
+    REQUIRE(test_bool.set("true"));
+    REQUIRE(settings::get_generation() != gen);
+    gen = settings::get_generation();
+
+    // A rejected value changes nothing.
+    REQUIRE(!test_bool.set("bogus"));
+    REQUIRE(settings::get_generation() == gen);
+
+    REQUIRE(test_enum.set("def"));
+    REQUIRE(settings::get_generation() != gen);
+    gen = settings::get_generation();
+
+    REQUIRE(!test_enum.set("xyz"));
+    REQUIRE(settings::get_generation() == gen);
+
+    // Resetting to the default is a change too.
+    test_bool.set();
+    REQUIRE(settings::get_generation() != gen);
+}
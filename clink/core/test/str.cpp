@@ -182,6 +182,55 @@ TEST_CASE("Strings" NAME_SUFFIX)
         REQUIRE(s.equals(STR("abcd1234")) == true);
     }
 
+    SECTION("Large capacity")
+    {
+        // Capacity used to be limited to 15 bits.
+        const unsigned int big = 100000;
+
+        str<16> s;
+        REQUIRE(s.reserve(big) == true);
+        REQUIRE(s.size() > big);
+
+        for (unsigned int i = 0; i < big; ++i)
+            s.concat(STR("x"), 1);
+        REQUIRE(s.length() == big);
+        REQUIRE(s.c_str()[big - 1] == 'x');
+        REQUIRE(s.c_str()[big] == '\0');
+
+        s.truncate(big / 2);
+        REQUIRE(s.length() == big / 2);
+
+        str<16, false> fixed;
+        REQUIRE(fixed.reserve(big) == false);
+        REQUIRE(fixed.size() == 16);
+    }
+
+    SECTION("Geometric growth")
+    {
+        // Appending one character at a time must not reallocate for every
+        // small increment; count how many times the capacity changes.
+        str<16> s;
+        unsigned int reallocs = 0;
+        unsigned int size = s.size();
+        for (unsigned int i = 0; i < 200000; ++i)
+        {
+            s << STR("y");
+            if (s.size() != size)
+            {
+                size = s.size();
+                ++reallocs;
+            }
+        }
+
+        REQUIRE(s.length() == 200000);
+        REQUIRE(reallocs < 32);
+
+        // Exact reservations are honored precisely.
+        str<16> e;
+        REQUIRE(e.reserve(1000, true) == true);
+        REQUIRE(e.size() == 1000);
+    }
+
     SECTION("Construction")
     {
         char buffer[] = "test";
@@ -143,3 +143,137 @@ TEST_CASE("String iterator (null str_iter)")
     REQUIRE(null.length() == 0);
     REQUIRE(null.get_pointer() != nullptr);
 }
+
+//------------------------------------------------------------------------------
+// The decoder as it was before it became table driven; its results for any
+// input (valid or not) must not change.
+static int legacy_utf8_next(const char*& ptr, const char* end)
+{
+    auto more = [&] () { return ptr != end && *ptr != '\0'; };
+
+    if (!more())
+        return 0;
+
+    int ax = 0;
+    int encode_length = 0;
+    while (int c = (unsigned char)*ptr++)
+    {
+        ax = (ax << 6) | (c & 0x7f);
+        if (encode_length)
+        {
+            --encode_length;
+            continue;
+        }
+
+        if ((c & 0xc0) < 0xc0)
+            return ax;
+
+        if (encode_length = !!(c & 0x20))
+            encode_length += !!(c & 0x10);
+
+        ax &= (0x1f >> encode_length);
+
+        if (!more())
+            break;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static bool matches_legacy(const char* s, int len)
+{
+    str_iter iter(s, len);
+    const char* ptr = s;
+    const char* end = s + len;
+    while (true)
+    {
+        const int expected = legacy_utf8_next(ptr, end);
+        const int actual = iter.next();
+        if (expected != actual || iter.get_pointer() != ptr)
+            return false;
+        if (!expected && !iter.more())
+            return true;
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("String iterator (str_iter) decoder")
+{
+    SECTION("All byte pairs")
+    {
+        char s[4] = {};
+        for (int a = 1; a < 256; ++a)
+            for (int b = 0; b < 256; ++b)
+            {
+                s[0] = char(a);
+                s[1] = char(b);
+                REQUIRE(matches_legacy(s, -1));
+                REQUIRE(matches_legacy(s, 1));
+            }
+    }
+
+    SECTION("Random sequences")
+    {
+        static const unsigned char c_bytes[] = { 'a', 0x7f, 0x80, 0x9b, 0xbf, 0xc2, 0xdf, 0xe0, 0xe2, 0xef, 0xf0, 0xf4, 0xf8, 0xff };
+
+        unsigned int seed = 1;
+        char s[12];
+        for (int i = 0; i < 100000; ++i)
+        {
+            for (int j = 0; j < sizeof_array(s) - 1; ++j)
+            {
+                seed = seed * 1103515245 + 12345;
+                s[j] = char(c_bytes[(seed >> 16) % sizeof_array(c_bytes)]);
+            }
+            s[sizeof_array(s) - 1] = '\0';
+
+            REQUIRE(matches_legacy(s, -1));
+            REQUIRE(matches_legacy(s, int((seed >> 8) % (sizeof_array(s) - 1))));
+        }
+    }
+
+    SECTION("ASCII spans")
+    {
+        const char* span;
+        str_iter iter("ab\xc2\x9b" "cd");
+        REQUIRE(iter.next_ascii(span) == 2);
+        REQUIRE(strncmp(span, "ab", 2) == 0);
+        REQUIRE(iter.next_ascii(span) == 0);
+        REQUIRE(iter.next() == 0x9b);
+        REQUIRE(iter.next_ascii(span, 1) == 1);
+        REQUIRE(*span == 'c');
+        REQUIRE(iter.next_ascii(span) == 1);
+        REQUIRE(*span == 'd');
+        REQUIRE(iter.next_ascii(span) == 0);
+        REQUIRE(!iter.more());
+
+        new (&iter) str_iter("abc", 2);
+        REQUIRE(iter.next_ascii(span) == 2);
+        REQUIRE(!iter.more());
+    }
+}
+
+//------------------------------------------------------------------------------
+// Run with "clink_test -t str_iter_throughput" to measure decoding speed.
+TEST_CASE("str_iter_throughput")
+{
+    str_moveable text;
+    for (int i = 0; i < 20000; ++i)
+        text << "plain ascii text \xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80 ";
+
+    wstr_moveable out;
+    int total = 0;
+    for (int pass = 0; pass < 20; ++pass)
+    {
+        str_iter iter(text.c_str(), text.length());
+        while (int c = iter.next())
+            total += c;
+
+        out.clear();
+        to_utf16(out, text.c_str());
+    }
+
+    REQUIRE(total != 0);
+    REQUIRE(out.length() == 20000 * 22);
+}
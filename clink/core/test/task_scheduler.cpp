@@ -0,0 +1,153 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/task_scheduler.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+static void wait_for(const std::atomic<bool>& flag)
+{
+    while (!flag)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Task scheduler")
+{
+    SECTION("Run")
+    {
+        task_scheduler scheduler(3);
+        std::atomic<int> count(0);
+
+        std::vector<std::shared_ptr<task>> tasks;
+        for (int i = 0; i < 20; ++i)
+            tasks.push_back(scheduler.submit(task_priority::idle, [&count] (task&) { ++count; }));
+
+        for (auto& t : tasks)
+            REQUIRE(t->wait());
+        REQUIRE(count == 20);
+        REQUIRE(tasks.front()->is_done());
+    }
+
+    SECTION("Priority order")
+    {
+        task_scheduler scheduler(1);
+        std::atomic<bool> release(false);
+        std::mutex mutex;
+        std::vector<int> order;
+
+        auto record = [&] (int value) {
+            return [&, value] (task&) {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(value);
+            };
+        };
+
+        auto blocker = scheduler.submit(task_priority::interactive, [&] (task&) { wait_for(release); });
+        auto c = scheduler.submit(task_priority::background, record(3));
+        auto b = scheduler.submit(task_priority::idle, record(2));
+        auto a = scheduler.submit(task_priority::interactive, record(1));
+        release = true;
+
+        REQUIRE(c->wait());
+        REQUIRE(order.size() == 3);
+        REQUIRE(order[0] == 1);
+        REQUIRE(order[1] == 2);
+        REQUIRE(order[2] == 3);
+    }
+
+    SECTION("Cancel")
+    {
+        task_scheduler scheduler(1);
+        std::atomic<bool> release(false);
+        std::atomic<bool> ran(false);
+
+        auto blocker = scheduler.submit(task_priority::interactive, [&] (task&) { wait_for(release); });
+        auto t = scheduler.submit(task_priority::interactive, [&] (task&) { ran = true; });
+        t->cancel();
+        release = true;
+
+        REQUIRE(t->wait());
+        REQUIRE(t->is_cancelled());
+        REQUIRE(!ran);
+    }
+
+    SECTION("Deadline")
+    {
+        task_scheduler scheduler(1);
+        std::atomic<bool> ran(false);
+
+        // Expires while queued.
+        auto blocker = scheduler.submit(task_priority::interactive, [] (task&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        });
+        auto expired = scheduler.submit(task_priority::interactive, [&] (task&) { ran = true; }, 10);
+        REQUIRE(expired->wait());
+        REQUIRE(!ran);
+
+        // Expires while running.
+        auto running = scheduler.submit(task_priority::interactive, [] (task& self) {
+            while (!self.is_cancelled())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }, 20);
+        REQUIRE(running->wait(5000));
+    }
+
+    SECTION("Background leaves a worker free")
+    {
+        task_scheduler scheduler(2);
+        std::atomic<bool> release(false);
+
+        auto bg1 = scheduler.submit(task_priority::background, [&] (task&) { wait_for(release); });
+        auto bg2 = scheduler.submit(task_priority::background, [&] (task&) { wait_for(release); });
+        auto fg = scheduler.submit(task_priority::interactive, [] (task&) {});
+
+        REQUIRE(fg->wait(5000));
+        REQUIRE(!bg2->is_done());
+
+        release = true;
+        REQUIRE(bg1->wait());
+        REQUIRE(bg2->wait());
+    }
+
+    SECTION("Blocking has its own workers")
+    {
+        task_scheduler scheduler(1, 2);
+        std::atomic<bool> release(false);
+        std::atomic<int> started(0);
+
+        auto blocking = [&] (task&) { ++started; wait_for(release); };
+        auto b1 = scheduler.submit(task_priority::blocking, blocking);
+        auto b2 = scheduler.submit(task_priority::blocking, blocking);
+        auto b3 = scheduler.submit(task_priority::blocking, blocking);
+
+        // The fixed pool is still free while the blocking budget is used up.
+        auto fg = scheduler.submit(task_priority::interactive, [] (task&) {});
+        REQUIRE(fg->wait(5000));
+
+        while (started < 2)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        REQUIRE(started == 2);
+
+        release = true;
+        REQUIRE(b1->wait());
+        REQUIRE(b2->wait());
+        REQUIRE(b3->wait());
+        REQUIRE(started == 3);
+    }
+
+    SECTION("Shutdown")
+    {
+        task_scheduler scheduler(1);
+        std::atomic<bool> ran(false);
+
+        scheduler.shutdown();
+        auto t = scheduler.submit(task_priority::interactive, [&] (task&) { ran = true; });
+        REQUIRE(t->is_done());
+        REQUIRE(!ran);
+    }
+}
@@ -35,6 +35,8 @@ public:
     bool            add_alias(const char* alias, const char* text);
     bool            remove_alias(const char* alias);
     void            resolve(const char* chars, doskey_alias& out, int* point=nullptr);
+    static void     invalidate_aliases();
+    static bool     is_alias(const char* alias);
 
 private:
     bool            resolve_impl(str_iter& s, class str_stream& out, int* point);
@@ -0,0 +1,62 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str_map.h>
+
+#include <vector>
+
+class str_base;
+class word_collector;
+
+//------------------------------------------------------------------------------
+struct history_arg
+{
+    const char*         arg;
+    unsigned int        count;
+};
+
+//------------------------------------------------------------------------------
+// Index from command names to the argument words previously used with them,
+// so that scripts can look up e.g. past `git checkout` branches instead of
+// scanning the whole history.  Command names are compared without regard to
+// case, directory, or extension; arguments are kept exactly as typed.
+class history_args
+{
+    struct arg_entry
+    {
+        char*           arg;
+        unsigned int    count;
+        unsigned int    last_used;
+    };
+
+    struct command_entry
+    {
+        str_map_case<unsigned int>::type lookup; // Index into args.
+        std::vector<arg_entry> args;
+    };
+
+    typedef str_map_caseless<command_entry*>::type command_map;
+
+public:
+                        history_args();
+                        ~history_args();
+    void                clear();
+    void                add(const char* line);
+    void                remove(const char* line);
+    bool                get(const char* command, std::vector<history_arg>& out, unsigned int max=0) const;
+    bool                empty() const { return m_commands.empty(); }
+
+private:
+    template <typename T> void for_each_arg(const char* line, bool create, T&& callback);
+    void                add_arg(command_entry& entry, const char* arg, unsigned int length);
+    void                remove_arg(command_entry& entry, const char* arg, unsigned int length);
+    static void         get_command_name(const char* command, unsigned int length, str_base& out);
+    word_collector*     m_collector;
+    command_map         m_commands;
+    unsigned int        m_sequence = 0;
+
+    static const unsigned int c_max_arg_length = 256;
+    static const unsigned int c_max_args_per_command = 200;
+};
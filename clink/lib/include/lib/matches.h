@@ -192,6 +192,9 @@ public:
     void                    set_append_character(char append);
     void                    set_suppress_append(bool suppress=true);
     void                    set_suppress_quoting(int suppress=1); //0=no, 1=yes, 2=suppress end quote
+    void                    begin_run();                    // Following matches come from a different source.
+    void                    set_sorted(bool sorted=true);   // Matches from this generator are already in sort order.
+    void                    set_unique(bool unique=true);   // Matches from this generator have no duplicates.
 
     void                    set_deprecated_mode();
     void                    set_matches_are_files(bool files=true);
@@ -36,6 +36,28 @@ struct word_class_info
     bool            argmatcher;
 };
 
+//------------------------------------------------------------------------------
+// A run of input characters [start, end) that share the same face.
+struct face_span
+{
+    bool            operator == (const face_span& other) const { return start == other.start && end == other.end && face == other.face; }
+    unsigned int    start;
+    unsigned int    end;
+    char            face;
+};
+
+//------------------------------------------------------------------------------
+// Classification results for a single command, with positions relative to the
+// start of the command, so they can be reused while the command's text stays
+// the same.  Custom faces are numbered by their index in face_definitions.
+struct command_classification
+{
+    std::vector<word_class_info> info;
+    std::vector<face_span> faces;
+    std::vector<str_moveable> face_definitions;
+    unsigned int    length = 0;
+};
+
 //------------------------------------------------------------------------------
 class word_classifications : public no_copy
 {
@@ -43,7 +65,6 @@ class word_classifications : public no_copy
 
 public:
                     word_classifications() = default;
-                    ~word_classifications();
                     word_classifications(word_classifications&& other);
 
     void            clear();
@@ -58,6 +79,7 @@ public:
 
     bool            get_word_class(unsigned int index, word_class& wc) const;
     char            get_face(unsigned int pos) const;
+    const std::vector<face_span>& get_face_spans() const { return m_faces; }
     const char*     get_face_output(char face) const;
 
     char            ensure_face(const char* sgr);
@@ -65,10 +87,16 @@ public:
     void            classify_word(unsigned int index, char wc, bool overwrite=true);
     bool            is_word_classified(unsigned int index);
 
+    void            save_command(unsigned int index, unsigned int count, unsigned int start, unsigned int length, command_classification& out) const;
+    void            restore_command(unsigned int index, unsigned int start, const command_classification& in);
+
 private:
+    void            fill_face(unsigned int start, unsigned int end, char face, bool overwrite);
+
     std::vector<word_class_info> m_info;
     std::vector<str_moveable> m_face_definitions;
-    char*           m_faces = nullptr;
+    std::vector<face_span> m_faces;         // Sorted; omits ' ' (not classified).
     unsigned int    m_length = 0;
+    mutable unsigned int m_hint = 0;        // Speeds up sequential get_face().
     faces_map       m_face_map;             // Points into m_face_definitions.
 };
@@ -6,13 +6,18 @@
 #include "terminal_helpers.h"
 
 #include <core/base.h>
+#include <core/os.h>
 #include <core/settings.h>
 #include <core/str.h>
 #include <core/str_iter.h>
+#include <core/str_map.h>
 #include <core/str_tokeniser.h>
 
 #include "terminal/printer.h"
 
+#include <memory>
+#include <vector>
+
 //------------------------------------------------------------------------------
 static setting_bool g_enhanced_doskey(
     "doskey.enhanced",
@@ -25,15 +30,220 @@ static setting_bool g_enhanced_doskey(
 
 
 //------------------------------------------------------------------------------
-static bool get_alias(const wchar_t* shell_name, str_iter& in, str_base& alias, str_base& text, bool relaxed=false)
+// A doskey macro compiled into a list of ops, so that expanding it is a single
+// linear pass instead of re-parsing the macro text for every invocation.  The
+// $$, $G, $L, $B, and $T tags are already converted in the literal runs.
+struct doskey_macro
+{
+    enum op_type : unsigned char { literal, arg, all_args };
+
+    struct op
+    {
+        op_type         type;
+        unsigned char   arg;        // 0..8 for $1..$9.
+        unsigned int    offset;     // Into literals.
+        unsigned int    length;
+    };
+
+    void                compile(const char* text);
+    void                add_literal(const char* chars, unsigned int length);
+
+    str_moveable        literals;
+    std::vector<op>     ops;
+    bool                arg_in_quotes = false;
+};
+
+//------------------------------------------------------------------------------
+void doskey_macro::add_literal(const char* chars, unsigned int length)
+{
+    if (ops.empty() || ops.back().type != literal)
+        ops.push_back({ literal, 0, literals.length(), 0 });
+
+    literals.concat(chars, length);
+    ops.back().length += length;
+}
+
+//------------------------------------------------------------------------------
+void doskey_macro::compile(const char* text)
+{
+    bool quote = false;
+    for (const char* read = text; *read; ++read)
+    {
+        char c = *read;
+        if (c != '$')
+        {
+            if (c == '\"')
+                quote = !quote;
+            add_literal(&c, 1);
+            continue;
+        }
+
+        c = *++read;
+        if (!c)
+            break;
+
+        // Convert $x tags.
+        char o = 0;
+        switch (c)
+        {
+        case '$':           o = '$';  break;
+        case 'g': case 'G': o = '>';  break;
+        case 'l': case 'L': o = '<';  break;
+        case 'b': case 'B': o = '|';  break;
+        case 't': case 'T': o = '\n'; break;
+        }
+        if (o)
+        {
+            add_literal(&o, 1);
+            continue;
+        }
+
+        // Unknown tag? Perhaps it is a argument one?
+        if (unsigned(c - '1') < 9 || c == '*')
+        {
+            // $* or $1..9 exists inside quotes:  don't split.
+            // Suppose `ps=powershell "$*"`, then the `|` should be passed
+            // to powershell when `ps applet |Format-Table` is used.
+            if (quote)
+                arg_in_quotes = true;
+            if (c == '*')
+                ops.push_back({ all_args, 0, 0, 0 });
+            else
+                ops.push_back({ arg, (unsigned char)(c - '1'), 0, 0 });
+            continue;
+        }
+
+        if (c == '\"')
+            quote = !quote;
+        const char tag[] = { '$', c };
+        add_literal(tag, sizeof(tag));
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+// Snapshot of a shell's console alias table.  Fetching the whole table is one
+// console call, so it's refreshed at most once per generation (see
+// doskey::invalidate_aliases).  Macros are compiled on first use and are kept
+// until the contents of the table change.
+class doskey_table
+{
+public:
+                        doskey_table(const wchar_t* shell_name) : m_shell_name(shell_name) {}
+    const doskey_macro* find(const char* alias);
+    void                invalidate() { m_stale = true; }
+    bool                is_shell(const wchar_t* shell_name) const { return wcsicmp(m_shell_name.c_str(), shell_name) == 0; }
+
+private:
+    struct entry
+    {
+        str_moveable                    name;
+        str_moveable                    text;
+        std::unique_ptr<doskey_macro>   macro;
+    };
+
+    void                refresh();
+    wstr_moveable       m_shell_name;
+    std::vector<wchar_t> m_raw;
+    std::vector<entry>  m_entries;
+    str_map_caseless<unsigned int>::type m_lookup; // Index into m_entries.
+    bool                m_stale = true;
+};
+
+static std::vector<std::unique_ptr<doskey_table>> s_tables;
+
+//------------------------------------------------------------------------------
+static doskey_table* get_table(const wchar_t* shell_name)
+{
+    for (auto& table : s_tables)
+        if (table->is_shell(shell_name))
+            return table.get();
+
+    s_tables.emplace_back(new doskey_table(shell_name));
+    return s_tables.back().get();
+}
+
+//------------------------------------------------------------------------------
+void doskey_table::refresh()
+{
+    if (!m_stale)
+        return;
+    m_stale = false;
+
+    // Not const because Windows' alias API won't accept it.
+    wchar_t* shell_name = const_cast<wchar_t*>(m_shell_name.c_str());
+
+    std::vector<wchar_t> raw;
+    const DWORD bytes = GetConsoleAliasesLengthW(shell_name);
+    if (bytes)
+    {
+        raw.resize(bytes / sizeof(wchar_t) + 1);
+        if (!GetConsoleAliasesW(raw.data(), DWORD(raw.size() * sizeof(wchar_t)), shell_name))
+            raw.clear();
+    }
+
+    // Same contents; the compiled macros are still good.
+    if (raw == m_raw)
+        return;
+
+    m_raw = std::move(raw);
+    m_lookup.clear();
+    m_entries.clear();
+
+    const wchar_t* alias = m_raw.data();
+    const wchar_t* end = alias + m_raw.size();
+    while (alias < end && *alias)
+    {
+        const wchar_t* eq = wcschr(alias, '=');
+        if (eq == nullptr)
+            break;
+
+        entry e;
+        wstr_moveable wname;
+        wname.concat(alias, int(eq - alias));
+        e.name = wname.c_str();
+        e.text = eq + 1;
+        if (!e.text.empty())
+            m_entries.emplace_back(std::move(e));
+
+        alias = eq + 1 + wcslen(eq + 1) + 1;
+    }
+
+    // Only index once m_entries is complete, since the keys point into it.
+    for (unsigned int i = 0; i < m_entries.size(); ++i)
+        m_lookup.emplace(m_entries[i].name.c_str(), i);
+}
+
+//------------------------------------------------------------------------------
+const doskey_macro* doskey_table::find(const char* alias)
+{
+    refresh();
+
+    auto iter = m_lookup.find(alias);
+    if (iter == m_lookup.end())
+        return nullptr;
+
+    entry& e = m_entries[iter->second];
+    if (!e.macro)
+    {
+        e.macro = std::unique_ptr<doskey_macro>(new doskey_macro);
+        e.macro->compile(e.text.c_str());
+    }
+    return e.macro.get();
+}
+
+
+
+//------------------------------------------------------------------------------
+static const doskey_macro* get_alias(const wchar_t* shell_name, str_iter& in, str_base& alias, bool relaxed=false)
 {
     alias.clear();
-    text.clear();
 
     // Legacy doskey doesn't allow macros that begin with whitespace.
     const char* start = in.get_pointer();
     if (in.more() && *start == ' ')
-        return false;
+        return nullptr;
 
     while (true)
     {
@@ -56,32 +266,19 @@ static bool get_alias(const wchar_t* shell_name, str_iter& in, str_base& alias,
         in.next();
     }
 
-    if (alias.empty())
+    const doskey_macro* macro = nullptr;
+    if (alias.empty() || !(macro = get_table(shell_name)->find(alias.c_str())))
     {
-fallback:
         in.reset_pointer(start);
         if (relaxed || !g_enhanced_doskey.get())
-            return false;
-        return get_alias(shell_name, in, alias, text, true);
+            return nullptr;
+        return get_alias(shell_name, in, alias, true);
     }
 
-    // Find the alias' text. First check it exists.
-    wchar_t unused;
-    wstr<32> walias(alias.c_str());
-    if (!GetConsoleAliasW(walias.data(), &unused, sizeof(unused), const_cast<wchar_t*>(shell_name)))
-        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
-            goto fallback;
-
-    // It does. Allocate space and fetch it.
-    wstr_moveable wtext;
-    wtext.reserve(8192, true/*exact*/);
-    GetConsoleAliasW(walias.data(), wtext.data(), wtext.size(), const_cast<wchar_t*>(shell_name));
-    text = wtext.c_str();
-
     // Advance the iterator.
     while (in.peek() == ' ')
         in.next();
-    return true;
+    return macro;
 }
 
 //------------------------------------------------------------------------------
@@ -275,6 +472,7 @@ bool doskey::add_alias(const char* alias, const char* text)
 {
     wstr<64> walias(alias);
     wstr<> wtext(text);
+    get_table(m_shell_name.c_str())->invalidate();
     return (AddConsoleAliasW(walias.data(), wtext.data(), m_shell_name.data()) == TRUE);
 }
 
@@ -282,9 +480,25 @@ bool doskey::add_alias(const char* alias, const char* text)
 bool doskey::remove_alias(const char* alias)
 {
     wstr<64> walias(alias);
+    get_table(m_shell_name.c_str())->invalidate();
     return (AddConsoleAliasW(walias.data(), nullptr, m_shell_name.data()) == TRUE);
 }
 
+//------------------------------------------------------------------------------
+// Aliases can be changed outside of Clink (e.g. by running doskey.exe), so the
+// cached alias tables must be refreshed whenever that could have happened.
+void doskey::invalidate_aliases()
+{
+    for (auto& table : s_tables)
+        table->invalidate();
+}
+
+//------------------------------------------------------------------------------
+bool doskey::is_alias(const char* alias)
+{
+    return !!get_table(os::get_shellname())->find(alias);
+}
+
 //------------------------------------------------------------------------------
 //#define DEBUG_RESOLVEIMPL
 bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
@@ -292,10 +506,10 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
     str_iter command = s;
     str_iter in = s;
 
-    // Get alias and macro text.
+    // Get alias and compiled macro.
     str<32> alias;
-    str<32> text;
-    if (!get_alias(m_shell_name.data(), in, alias, text))
+    const doskey_macro* macro = get_alias(m_shell_name.data(), in, alias);
+    if (!macro)
         return false;
 
     // Find the point range for the alias name.
@@ -334,38 +548,7 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
 
     // Either split the input at the next command separator, or use the entire
     // input, depending on the doskey.enhanced setting and the macro text.
-    bool split = g_enhanced_doskey.get();
-    if (split)
-    {
-        bool quote = false;
-        str_iter macro(text.c_str(), text.length());
-        while (macro.more())
-        {
-            const int c = macro.next();
-            if (c == '\"')
-                quote = !quote;
-            if (c != '$')
-                continue;
-
-            const int tag = macro.peek();
-            if ((tag == '*') || (tag >= '1' && tag <= '9'))
-            {
-                // $* or $1..9 exists inside quotes:  don't split.
-                // Suppose `ps=powershell "$*"`, then the `|` should be passed
-                // to powershell when `ps applet |Format-Table` is used.
-                if (quote)
-                {
-                    split = false;
-                    break;
-                }
-            }
-            else if (tag == '$')
-            {
-                // Skip both chars of '$$' tag.
-                macro.next();
-            }
-        }
-    }
+    const bool split = g_enhanced_doskey.get() && !macro->arg_in_quotes;
     if (split)
     {
         // Restrict to resolve only up to the command separator.
@@ -452,50 +635,19 @@ bool doskey::resolve_impl(str_iter& s, str_stream& out, int* _point)
     }
 #endif
 
-    // Expand the alias' text into 'out'.
-    bool set_point = !!point;
+    // Expand the alias' compiled macro into 'out'.
     str_stream& stream = out;
-    const char* read = text.c_str();
     int last_arg_resolved = -1;
-    for (int c = *read; c = *read; ++read)
+    for (const auto& op : macro->ops)
     {
-        if (c != '$')
+        if (op.type == doskey_macro::literal)
         {
-            stream << c;
+            stream << str_stream::range(macro->literals.c_str() + op.offset, op.length);
             continue;
         }
 
-        c = *++read;
-        if (!c)
-            break;
-
-        // Convert $x tags.
-        char o = 0;
-        switch (c)
-        {
-        case '$':           o = '$';  break;
-        case 'g': case 'G': o = '>';  break;
-        case 'l': case 'L': o = '<';  break;
-        case 'b': case 'B': o = '|';  break;
-        case 't': case 'T': o = '\n'; break;
-        }
-        if (o)
-        {
-            if (o == '\n')
-                set_point = false; // Only adjust point for the first line.
-            stream << o;
-            continue;
-        }
-
-        // Unknown tag? Perhaps it is a argument one?
-        if (unsigned(c - '1') < 9)  c -= '1';
-        else if (c == '*')          c = -1;
-        else
-        {
-            stream << '$';
-            stream << c;
-            continue;
-        }
+        // The arg index, or -1 if it is all of them to be inserted.
+        int c = (op.type == doskey_macro::all_args) ? -1 : op.arg;
 
         int arg_count = args.size();
         if (!arg_count)
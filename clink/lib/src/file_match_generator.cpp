@@ -72,6 +72,11 @@ static class : public match_generator
                 root = collapsed.c_str();
         }
 
+        // A directory can't contain duplicate names, and NTFS returns names
+        // in collation order (which the pipeline verifies before relying on).
+        builder.set_unique();
+        builder.set_sorted();
+
         str<288> buffer;
         globber::extrainfo info;
         while (globber.next(buffer, false, &info))
@@ -0,0 +1,224 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "history_args.h"
+#include "cmd_tokenisers.h"
+#include "line_state.h"
+#include "word_collector.h"
+
+#include <core/base.h>
+#include <core/path.h>
+#include <core/str.h>
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+// Indexing history must not call into Lua, so don't ask about deprecated
+// argmatchers; it only affects how flag words are split.
+class history_command_tokeniser : public cmd_command_tokeniser
+{
+public:
+    bool has_deprecated_argmatcher(const char* command) override { return false; }
+};
+
+static history_command_tokeniser s_command_tokeniser;
+static cmd_word_tokeniser s_word_tokeniser;
+
+
+
+//------------------------------------------------------------------------------
+history_args::history_args()
+: m_collector(new word_collector(&s_command_tokeniser, &s_word_tokeniser))
+{
+}
+
+//------------------------------------------------------------------------------
+history_args::~history_args()
+{
+    clear();
+    delete m_collector;
+}
+
+//------------------------------------------------------------------------------
+void history_args::clear()
+{
+    for (auto& command : m_commands)
+    {
+        for (auto& entry : command.second->args)
+            free(entry.arg);
+        delete command.second;
+        free(const_cast<char*>(command.first));
+    }
+
+    m_commands.clear();
+    m_sequence = 0;
+}
+
+//------------------------------------------------------------------------------
+// Calls callback(entry, arg, length) for each argument word in line, with the
+// entry for the command it belongs to.  Missing command entries are created
+// when create is true, otherwise their arguments are skipped.
+template <typename T>
+void history_args::for_each_arg(const char* line, bool create, T&& callback)
+{
+    const unsigned int length = static_cast<unsigned int>(strlen(line));
+
+    std::vector<word> words;
+    m_collector->collect_words(line, length, length, words, collect_words_mode::whole_command);
+
+    str<32> name;
+    command_entry* entry = nullptr;
+    for (const word& word : words)
+    {
+        if (word.command_word)
+        {
+            entry = nullptr;
+            get_command_name(line + word.offset, word.length, name);
+            if (name.empty())
+                continue;
+
+            auto iter = m_commands.find(name.c_str());
+            if (iter != m_commands.end())
+            {
+                entry = iter->second;
+            }
+            else if (create)
+            {
+                entry = new command_entry;
+                m_commands.emplace(_strdup(name.c_str()), entry);
+            }
+            continue;
+        }
+
+        if (!entry || word.is_redir_arg || !word.length || word.length > c_max_arg_length)
+            continue;
+
+        callback(*entry, line + word.offset, word.length);
+    }
+}
+
+//------------------------------------------------------------------------------
+void history_args::add(const char* line)
+{
+    for_each_arg(line, true, [this] (command_entry& entry, const char* arg, unsigned int length) {
+        add_arg(entry, arg, length);
+    });
+}
+
+//------------------------------------------------------------------------------
+// Undoes one add() of line.  Arguments whose count drops to zero are removed;
+// the recency of the others is left alone.
+void history_args::remove(const char* line)
+{
+    for_each_arg(line, false, [this] (command_entry& entry, const char* arg, unsigned int length) {
+        remove_arg(entry, arg, length);
+    });
+}
+
+//------------------------------------------------------------------------------
+void history_args::add_arg(command_entry& entry, const char* arg, unsigned int length)
+{
+    str<64> tmp;
+    tmp.concat(arg, length);
+
+    auto iter = entry.lookup.find(tmp.c_str());
+    if (iter != entry.lookup.end())
+    {
+        arg_entry& existing = entry.args[iter->second];
+        existing.count++;
+        existing.last_used = ++m_sequence;
+        return;
+    }
+
+    // When a command accumulates too many distinct arguments, keep only the
+    // most recently used half.
+    if (entry.args.size() >= c_max_args_per_command)
+    {
+        std::sort(entry.args.begin(), entry.args.end(), [] (const arg_entry& a, const arg_entry& b) {
+            return a.last_used > b.last_used;
+        });
+
+        const size_t keep = c_max_args_per_command / 2;
+        for (size_t i = keep; i < entry.args.size(); ++i)
+            free(entry.args[i].arg);
+        entry.args.resize(keep);
+
+        entry.lookup.clear();
+        for (size_t i = 0; i < entry.args.size(); ++i)
+            entry.lookup.emplace(entry.args[i].arg, static_cast<unsigned int>(i));
+    }
+
+    char* copy = _strdup(tmp.c_str());
+    entry.lookup.emplace(copy, static_cast<unsigned int>(entry.args.size()));
+    entry.args.push_back({ copy, 1, ++m_sequence });
+}
+
+//------------------------------------------------------------------------------
+void history_args::remove_arg(command_entry& entry, const char* arg, unsigned int length)
+{
+    str<64> tmp;
+    tmp.concat(arg, length);
+
+    auto iter = entry.lookup.find(tmp.c_str());
+    if (iter == entry.lookup.end())
+        return;
+
+    const unsigned int index = iter->second;
+    if (--entry.args[index].count)
+        return;
+
+    // Move the last entry into the vacated slot.
+    entry.lookup.erase(iter);
+    free(entry.args[index].arg);
+    if (index + 1 < entry.args.size())
+    {
+        entry.args[index] = entry.args.back();
+        entry.lookup[entry.args[index].arg] = index;
+    }
+    entry.args.pop_back();
+}
+
+//------------------------------------------------------------------------------
+// Returns the arguments used with the command, most recently used first.  The
+// returned strings remain valid until the index is next modified.
+bool history_args::get(const char* command, std::vector<history_arg>& out, unsigned int max) const
+{
+    out.clear();
+
+    str<32> name;
+    get_command_name(command, static_cast<unsigned int>(strlen(command)), name);
+
+    auto iter = m_commands.find(name.c_str());
+    if (iter == m_commands.end())
+        return false;
+
+    std::vector<const arg_entry*> sorted;
+    sorted.reserve(iter->second->args.size());
+    for (const auto& entry : iter->second->args)
+        sorted.push_back(&entry);
+
+    std::sort(sorted.begin(), sorted.end(), [] (const arg_entry* a, const arg_entry* b) {
+        return a->last_used > b->last_used;
+    });
+
+    if (max && sorted.size() > max)
+        sorted.resize(max);
+
+    out.reserve(sorted.size());
+    for (const arg_entry* entry : sorted)
+        out.push_back({ entry->arg, entry->count });
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void history_args::get_command_name(const char* command, unsigned int length, str_base& out)
+{
+    str<280> tmp;
+    for (unsigned int i = 0; i < length; ++i)
+        if (command[i] != '"')
+            tmp.concat(command + i, 1);
+
+    if (!path::get_base_name(tmp.c_str(), out))
+        out.clear();
+}
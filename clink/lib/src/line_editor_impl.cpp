@@ -4,6 +4,7 @@
 #include "pch.h"
 #include <assert.h>
 #include "line_editor_impl.h"
+#include "doskey.h"
 #include "line_buffer.h"
 #include "match_generator.h"
 #include "match_pipeline.h"
@@ -94,6 +95,15 @@ void reset_generate_matches()
     s_editor->reset_generate_matches();
 }
 
+//------------------------------------------------------------------------------
+void refresh_async_matches()
+{
+    if (!s_editor)
+        return;
+
+    s_editor->refresh_async_matches();
+}
+
 //------------------------------------------------------------------------------
 bool is_regen_blocked()
 {
@@ -344,6 +354,10 @@ void line_editor_impl::begin_line()
     m_buffer.begin_line();
     m_prev_generate.clear();
     m_prev_classify.clear();
+    m_classify_cache.clear();
+
+    // Running the previous line may have changed the doskey aliases.
+    doskey::invalidate_aliases();
 
     rl_before_display_function = before_display;
 
@@ -478,6 +492,18 @@ void line_editor_impl::reset_generate_matches()
     m_prev_generate.clear();
 }
 
+//------------------------------------------------------------------------------
+// Called when an async match generator has finished.  Matches are generated
+// again the next time they're needed, or immediately if clink-select-complete
+// is showing them so it can update in place.
+void line_editor_impl::refresh_async_matches()
+{
+    reset_generate_matches();
+
+    if (m_selectcomplete.is_active())
+        m_selectcomplete.refresh();
+}
+
 //------------------------------------------------------------------------------
 void line_editor_impl::force_update_internal(bool restrict)
 {
@@ -914,7 +940,87 @@ void line_editor_impl::classify()
         i++;
     }
 
-    m_classifier->classify(linestates, m_classifications);
+    // Each command spans from its command offset to the start of the next
+    // command, so that separators and redirection symbols belong to the
+    // command before them.  Commands whose text (including whether it's the
+    // last command) is unchanged since the previous classify reuse the cached
+    // results, and only the rest are passed to the classifiers.
+    const unsigned int line_length = m_buffer.get_length();
+    std::vector<classify_cache_entry> cache;
+    std::vector<const command_classification*> cached;
+    std::vector<line_state> uncached;
+    cache.reserve(linestates.size());
+    cached.reserve(linestates.size());
+    for (size_t ii = 0; ii < linestates.size(); ++ii)
+    {
+        const unsigned int start = ii ? linestates[ii].get_command_offset() : 0;
+        const unsigned int end = (ii + 1 < linestates.size()) ? linestates[ii + 1].get_command_offset() : line_length;
+
+        cache.emplace_back();
+        str_moveable& text = cache.back().text;
+        text.concat(ii + 1 < linestates.size() ? "-" : "$", 1);
+        text.concat(m_buffer.get_buffer() + start, end - start);
+
+        const command_classification* found = nullptr;
+        for (const auto& entry : m_classify_cache)
+        {
+            if (entry.text.equals(text.c_str()))
+            {
+                found = &entry.classification;
+                break;
+            }
+        }
+
+        cached.push_back(found);
+        if (!found)
+            uncached.push_back(linestates[ii]);
+    }
+
+    if (uncached.size() == linestates.size())
+    {
+        m_classifier->classify(linestates, m_classifications);
+    }
+    else
+    {
+        word_classifications fresh;
+        fresh.init(line_length, &m_classifications);
+        if (!uncached.empty())
+            m_classifier->classify(uncached, fresh);
+
+        unsigned int fresh_index = 0;
+        command_classification tmp;
+        for (size_t ii = 0; ii < linestates.size(); ++ii)
+        {
+            const unsigned int index = m_classifications.add_command(linestates[ii]);
+            const unsigned int start = ii ? linestates[ii].get_command_offset() : 0;
+            if (!cached[ii])
+            {
+                const unsigned int count = linestates[ii].get_word_count();
+                const unsigned int length = cache[ii].text.length() - 1;
+                fresh.save_command(fresh_index, count, start, length, tmp);
+                fresh_index += count;
+                m_classifications.restore_command(index, start, tmp);
+            }
+            else
+            {
+                m_classifications.restore_command(index, start, *cached[ii]);
+            }
+        }
+    }
+
+    // Remember the results for each command (before finish() fills in the
+    // default faces), for use by the next classify.
+    unsigned int info_index = 0;
+    for (size_t ii = 0; ii < linestates.size(); ++ii)
+    {
+        const unsigned int count = linestates[ii].get_word_count();
+        const unsigned int start = ii ? linestates[ii].get_command_offset() : 0;
+        const unsigned int length = cache[ii].text.length() - 1;
+        m_classifications.save_command(info_index, count, start, length, cache[ii].classification);
+        info_index += count;
+    }
+    m_classify_cache = std::move(cache);
+
     m_classifications.finish(is_showing_argmatchers());
 
 #ifdef DEBUG
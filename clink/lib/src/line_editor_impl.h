@@ -70,6 +70,7 @@ public:
     virtual void        set_keyseq_len(int len) override;
 
     void                reset_generate_matches();
+    void                refresh_async_matches();
     void                reset_prev_suggest();
     void                force_update_internal(bool restrict=false);
     bool                call_lua_rl_global_function(const char* func_name);
@@ -150,9 +151,16 @@ private:
     words               m_words;
     unsigned short      m_command_offset = 0;
 
+    struct classify_cache_entry
+    {
+        str_moveable            text;       // Text of the command (plus 1 char flag for last command).
+        command_classification  classification;
+    };
+
     prev_buffer         m_prev_classify;
     words               m_classify_words;
     unsigned short      m_classify_command_offset = 0;
+    std::vector<classify_cache_entry> m_classify_cache;
 
     const char*         m_insert_on_begin = nullptr;
 
@@ -9,6 +9,7 @@
 #include "matches_impl.h"
 
 #include <core/array.h>
+#include <core/base.h>
 #include <core/path.h>
 #include <core/match_wild.h>
 #include <core/str_compare.h>
@@ -155,6 +156,77 @@ static void alpha_sorter(match_info* infos, int count)
     std::sort(infos, infos + count, predicate);
 }
 
+//------------------------------------------------------------------------------
+// When every run of matches was declared sorted by its generator, the runs can
+// be merged instead of sorting everything again.  Generators can only know
+// their own order (e.g. NTFS collation), which may differ from Clink's order,
+// so each run is verified first.  Returns false if a full sort is needed.
+static bool merge_sorter(match_info* infos, int count, const std::vector<match_run>& runs)
+{
+    if (runs.empty() || runs[0].begin > 0)
+        return false;
+
+    int order = g_sort_dirs.get();
+    wstr<> ltmp;
+    wstr<> rtmp;
+
+    auto predicate = [&] (const match_info& lhs, const match_info& rhs) {
+        ltmp.clear();
+        rtmp.clear();
+        to_utf16(ltmp, lhs.match);
+        to_utf16(rtmp, rhs.match);
+        return sort_worker(ltmp, lhs.type, rtmp, rhs.type, order);
+    };
+
+    // Each cursor is the [first, second) range of a run not yet merged.
+    typedef std::pair<int, int> cursor;
+    std::vector<cursor> cursors;
+    for (size_t r = 0; r < runs.size(); ++r)
+    {
+        const int begin = min<int>(runs[r].begin, count);
+        const int end = (r + 1 < runs.size()) ? min<int>(runs[r + 1].begin, count) : count;
+        if (begin >= end)
+            continue;
+
+        if (!runs[r].sorted)
+            return false;
+
+        for (int i = begin + 1; i < end; ++i)
+            if (predicate(infos[i], infos[i - 1]))
+                return false;
+
+        cursors.emplace_back(begin, end);
+    }
+
+    if (cursors.size() <= 1)
+        return true;
+
+    // K-way merge, using a heap ordered so its top is the cursor whose next
+    // match sorts first.
+    auto heap_predicate = [&] (const cursor& lhs, const cursor& rhs) {
+        return predicate(infos[rhs.first], infos[lhs.first]);
+    };
+
+    std::vector<match_info> merged;
+    merged.reserve(count);
+
+    std::make_heap(cursors.begin(), cursors.end(), heap_predicate);
+    while (!cursors.empty())
+    {
+        std::pop_heap(cursors.begin(), cursors.end(), heap_predicate);
+        cursor& next = cursors.back();
+        merged.push_back(infos[next.first]);
+        if (++next.first < next.second)
+            std::push_heap(cursors.begin(), cursors.end(), heap_predicate);
+        else
+            cursors.pop_back();
+    }
+
+    assert(merged.size() == size_t(count));
+    std::copy(merged.begin(), merged.end(), infos);
+    return true;
+}
+
 //------------------------------------------------------------------------------
 void sort_match_list(char** matches, int len)
 {
@@ -211,8 +283,11 @@ void match_pipeline::generate(
 
     match_builder builder(m_matches);
     for (auto* generator : generators)
+    {
+        m_matches.begin_run();
         if (generator->generate(state, builder, old_filtering))
             break;
+    }
 
     m_matches.done_building();
 
@@ -319,5 +394,6 @@ void match_pipeline::sort() const
     if (!count)
         return;
 
-    alpha_sorter(m_matches.get_infos(), count);
+    if (!merge_sorter(m_matches.get_infos(), count, m_matches.get_runs()))
+        alpha_sorter(m_matches.get_infos(), count);
 }
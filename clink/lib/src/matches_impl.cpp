@@ -248,6 +248,24 @@ void match_builder::set_suppress_quoting(int suppress)
     return ((matches_impl&)m_matches).set_suppress_quoting(suppress);
 }
 
+//------------------------------------------------------------------------------
+void match_builder::begin_run()
+{
+    return ((matches_impl&)m_matches).begin_run();
+}
+
+//------------------------------------------------------------------------------
+void match_builder::set_sorted(bool sorted)
+{
+    return ((matches_impl&)m_matches).set_run_sorted(sorted);
+}
+
+//------------------------------------------------------------------------------
+void match_builder::set_unique(bool unique)
+{
+    return ((matches_impl&)m_matches).set_run_unique(unique);
+}
+
 //------------------------------------------------------------------------------
 void match_builder::set_deprecated_mode()
 {
@@ -414,9 +432,77 @@ const char* matches_impl::store_impl::store_front(const char* str)
 
 
 
+//------------------------------------------------------------------------------
+struct matches_impl::string_pool::hasher
+{
+    size_t operator()(const char* str) const
+    {
+        return str_hash(str);
+    }
+};
+
+//------------------------------------------------------------------------------
+struct matches_impl::string_pool::comparator
+{
+    bool operator()(const char* s1, const char* s2) const
+    {
+        return strcmp(s1, s2) == 0;
+    }
+};
+
+//------------------------------------------------------------------------------
+matches_impl::string_pool::string_pool(unsigned int size)
+: m_store(max<unsigned int>(4096, size))
+{
+}
+
+//------------------------------------------------------------------------------
+matches_impl::string_pool::~string_pool()
+{
+    delete m_set;
+}
+
+//------------------------------------------------------------------------------
+const char* matches_impl::string_pool::intern(const char* str)
+{
+    if (!m_set)
+        m_set = new string_set;
+
+    const auto found = m_set->find(str);
+    if (found != m_set->end())
+        return *found;
+
+    const unsigned int size = strlen(str) + 1;
+    char* ret = (char*)m_store.alloc(size);
+    if (!ret)
+        return nullptr;
+
+    memcpy(ret, str, size);
+    m_set->emplace(ret);
+    m_bytes += size;
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// Discards the pooled strings if they exceed max_bytes.  Must only be called
+// when no matches refer to pooled strings.
+void matches_impl::string_pool::trim(unsigned int max_bytes)
+{
+    if (m_bytes <= max_bytes)
+        return;
+
+    if (m_set)
+        m_set->clear();
+    m_store.reset();
+    m_bytes = 0;
+}
+
+
+
 //------------------------------------------------------------------------------
 matches_impl::matches_impl(generators* generators, unsigned int store_size)
 : m_store(min(store_size, 0x10000u))
+, m_pool(min(store_size, 0x10000u))
 , m_generators(generators)
 , m_filename_completion_desired(false)
 , m_filename_display_desired(false)
@@ -678,7 +764,9 @@ bool matches_impl::match_display_filter(const char* needle, char** matches, matc
 void matches_impl::reset()
 {
     m_store.reset();
+    m_pool.trim(0x100000);
     m_infos.clear();
+    m_runs.clear();
     m_any_infer_type = false;
     m_can_infer_type = true;
     m_coalesced = false;
@@ -737,6 +825,47 @@ void matches_impl::set_matches_are_files(bool files)
     m_filename_display_desired.set_explicit(files);
 }
 
+//------------------------------------------------------------------------------
+void matches_impl::begin_run()
+{
+    // Reuse the current run if nothing has been added to it yet.
+    const unsigned int begin = static_cast<unsigned int>(m_infos.size());
+    if (m_runs.empty() || m_runs.back().begin < begin)
+        m_runs.push_back({ begin });
+    else
+        m_runs.back() = { begin };
+}
+
+//------------------------------------------------------------------------------
+void matches_impl::set_run_sorted(bool sorted)
+{
+    if (m_runs.empty())
+        begin_run();
+    m_runs.back().sorted = sorted;
+}
+
+//------------------------------------------------------------------------------
+void matches_impl::set_run_unique(bool unique)
+{
+    if (m_runs.empty())
+        begin_run();
+    m_runs.back().unique = unique;
+}
+
+//------------------------------------------------------------------------------
+// Dedup is skipped while all matches so far come from a single run that was
+// declared unique.  As soon as anything else needs the dedup set, fill it with
+// the matches added so far.
+void matches_impl::ensure_dedup()
+{
+    if (m_dedup)
+        return;
+
+    m_dedup = new match_lookup_unordered_set;
+    for (const auto& info : m_infos)
+        m_dedup->emplace(match_lookup({ info.match, info.type }));
+}
+
 //------------------------------------------------------------------------------
 bool matches_impl::add_match(const match_desc& desc, bool already_normalized)
 {
@@ -793,11 +922,16 @@ bool matches_impl::add_match(const match_desc& desc, bool already_normalized)
         match = tmp.c_str();
     }
 
-    if (!m_dedup)
-        m_dedup = new match_lookup_unordered_set;
-
-    if (m_dedup->find({ match, type }) != m_dedup->end())
-        return false;
+    const bool skip_dedup = (!m_dedup &&
+                             !m_runs.empty() &&
+                             m_runs.back().unique &&
+                             m_runs.back().begin == 0);
+    if (!skip_dedup)
+    {
+        ensure_dedup();
+        if (m_dedup->find({ match, type }) != m_dedup->end())
+            return false;
+    }
 
     if (is_none)
     {
@@ -821,12 +955,15 @@ bool matches_impl::add_match(const match_desc& desc, bool already_normalized)
         m_any_infer_type = true;
     }
 
-    const char* store_display = (desc.display && *desc.display) ? m_store.store_front(desc.display) : nullptr;
-    const char* store_description = (desc.description && *desc.description) ? m_store.store_front(desc.description) : nullptr;
+    const char* store_display = (desc.display && *desc.display) ? m_pool.intern(desc.display) : nullptr;
+    const char* store_description = (desc.description && *desc.description) ? m_pool.intern(desc.description) : nullptr;
     bool append_display = (desc.append_display && store_display);
 
-    match_lookup lookup = { store_match, type };
-    m_dedup->emplace(std::move(lookup));
+    if (!skip_dedup)
+    {
+        match_lookup lookup = { store_match, type };
+        m_dedup->emplace(std::move(lookup));
+    }
 
     match_info info = { store_match, store_display, store_description, type, desc.append_char, desc.suppress_append, append_display, false/*select*/, is_none/*infer_type*/ };
     m_infos.emplace_back(std::move(info));
@@ -850,6 +987,8 @@ void matches_impl::done_building()
         else if (s_slash_translation == 3)
             sep = '\\';
 
+        ensure_dedup();
+
         for (unsigned int i = m_count; i--;)
         {
             if (m_infos[i].infer_type)
@@ -888,7 +1027,12 @@ void matches_impl::done_building()
 
                 // Check if it has become a duplicate.
                 if (m_dedup->find(lookup) != m_dedup->end())
+                {
                     m_infos.erase(m_infos.begin() + i);
+                    for (auto& run : m_runs)
+                        if (run.begin > i)
+                            --run.begin;
+                }
                 else
                     m_dedup->emplace(std::move(lookup));
             }
@@ -907,9 +1051,16 @@ void matches_impl::coalesce(unsigned int count_hint, bool restrict)
     bool any_pathish = false;
     bool all_pathish = true;
 
+    // Selected matches keep their relative order, so each run stays intact;
+    // only where it begins changes.
+    unsigned int run = 0;
+
     unsigned int j = 0;
     for (unsigned int i = 0, n = m_infos.size(); i < n && j < count_hint; ++i)
     {
+        while (run < m_runs.size() && m_runs[run].begin <= i)
+            m_runs[run++].begin = j;
+
         if (!infos[i].select)
             continue;
 
@@ -927,6 +1078,9 @@ void matches_impl::coalesce(unsigned int count_hint, bool restrict)
         ++j;
     }
 
+    while (run < m_runs.size())
+        m_runs[run++].begin = j;
+
     m_filename_completion_desired.set_implicit(any_pathish);
     m_filename_display_desired.set_implicit(any_pathish && all_pathish);
 
@@ -31,6 +31,16 @@ struct match_lookup
     match_type      type;
 };
 
+//------------------------------------------------------------------------------
+// A contiguous range of matches added by one generator.  The generator can
+// declare the run to already be sorted and/or free of duplicates.
+struct match_run
+{
+    unsigned int    begin;              // Index of the first match in the run.
+    bool            sorted;
+    bool            unique;
+};
+
 
 
 //------------------------------------------------------------------------------
@@ -101,12 +111,17 @@ private:
     void                    set_suppress_quoting(int suppress);
     void                    set_deprecated_mode();
     void                    set_matches_are_files(bool files);
+    void                    begin_run();
+    void                    set_run_sorted(bool sorted);
+    void                    set_run_unique(bool unique);
+    const std::vector<match_run>& get_runs() const { return m_runs; }
     bool                    add_match(const match_desc& desc, bool already_normalised=false);
     unsigned int            get_info_count() const;
     const match_info*       get_infos() const;
     match_info*             get_infos();
     void                    reset();
     void                    coalesce(unsigned int count_hint, bool restrict=false);
+    void                    ensure_dedup();
 
 private:
     class store_impl : public linear_allocator
@@ -116,11 +131,34 @@ private:
         const char*         store_front(const char* str);
     };
 
+    // Display strings and descriptions are interned in a pool that outlives
+    // reset(), so that generators which add the same strings every time (e.g.
+    // argmatchers with flag descriptions) don't copy them again.
+    class string_pool
+    {
+        struct hasher;
+        struct comparator;
+        typedef std::unordered_set<const char*, hasher, comparator> string_set;
+
+    public:
+                            string_pool(unsigned int size);
+                            ~string_pool();
+        const char*         intern(const char* str);
+        void                trim(unsigned int max_bytes);
+
+    private:
+        linear_allocator    m_store;
+        string_set*         m_set = nullptr;
+        unsigned int        m_bytes = 0;
+    };
+
     typedef std::vector<match_info> infos;
 
     store_impl              m_store;
+    string_pool             m_pool;
     generators*             m_generators;
     infos                   m_infos;
+    std::vector<match_run>  m_runs;
     unsigned short          m_count = 0;
     bool                    m_any_infer_type = false;
     bool                    m_can_infer_type = true;
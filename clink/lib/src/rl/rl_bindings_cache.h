@@ -0,0 +1,49 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <core/str.h>
+
+//------------------------------------------------------------------------------
+// Remembers the inputs that produced the current key bindings and config
+// variables, so that reloading scripts doesn't rebind the defaults and parse
+// the inputrc file again when nothing has changed.
+class rl_bindings_cache
+{
+public:
+    bool            is_current(const char* inputrc, unsigned int hash, int default_bindings, int editing_mode) const
+                    {
+                        return (m_valid &&
+                                m_hash == hash &&
+                                m_default_bindings == default_bindings &&
+                                m_editing_mode == editing_mode &&
+                                m_inputrc.equals(inputrc));
+                    }
+
+    void            update(const char* inputrc, unsigned int hash, int default_bindings, int editing_mode)
+                    {
+                        m_valid = true;
+                        m_inputrc = inputrc;
+                        m_hash = hash;
+                        m_default_bindings = default_bindings;
+                        m_editing_mode = editing_mode;
+                    }
+
+    // Called when something other than initialise_readline() changes bindings
+    // or config variables (e.g. Lua scripts, or an explicit reload), so that
+    // the next initialise_readline() rebuilds them.
+    void            invalidate() { m_valid = false; }
+    bool            is_valid() const { return m_valid; }
+
+private:
+    bool            m_valid = false;
+    str_moveable    m_inputrc;
+    unsigned int    m_hash = 0;
+    int             m_default_bindings = -1;
+    int             m_editing_mode = -1;
+};
+
+//------------------------------------------------------------------------------
+rl_bindings_cache& get_rl_bindings_cache();
+void invalidate_rl_bindings_cache();
@@ -87,6 +87,7 @@ extern line_buffer* g_rl_buffer;
 extern word_collector* g_word_collector;
 extern editor_module::result* g_result;
 extern void host_cmd_enqueue_lines(std::list<str_moveable>& lines);
+extern void invalidate_rl_bindings_cache();
 extern int host_add_history(int, const char* line);
 extern void host_get_app_context(int& id, str_base& binaries, str_base& profile, str_base& scripts);
 extern "C" int show_cursor(int visible);
@@ -2012,6 +2013,7 @@ void clear_force_reload_scripts()
 int force_reload_scripts()
 {
     s_force_reload_scripts = true;
+    invalidate_rl_bindings_cache();
     if (g_result)
         g_result->done(true); // Force a new edit line so scripts can be reloaded.
     return rl_re_read_init_file(0, 0);
@@ -16,8 +16,10 @@
 #include "textlist_impl.h"
 
 #include "rl_suggestions.h"
+#include "rl_bindings_cache.h"
 
 #include <core/base.h>
+#include <core/grapheme_iter.h>
 #include <core/os.h>
 #include <core/path.h>
 #include <core/str_compare.h>
@@ -637,6 +639,31 @@ int count_prompt_lines(const char* prompt_prefix, int len)
     return lines;
 }
 
+//------------------------------------------------------------------------------
+// Cursor motion steps over whole grapheme clusters, so that e.g. a flag or an
+// emoji ZWJ sequence moves and deletes as a single character.
+static int find_next_cluster_func(const char* string, int point)
+{
+    grapheme_iter iter(string + point);
+    if (!iter.next())
+        return string[point] ? point + 1 : point;
+    return int(iter.get_pointer() - string);
+}
+
+//------------------------------------------------------------------------------
+static int find_prev_cluster_func(const char* string, int point)
+{
+    int prev = 0;
+    grapheme_iter iter(string, point);
+    while (iter.next())
+        prev = int(iter.get_cluster() - string);
+
+    // A partial sequence at the end counts as one character.
+    if (iter.get_pointer() < string + point)
+        prev = int(iter.get_pointer() - string);
+    return prev;
+}
+
 //------------------------------------------------------------------------------
 static char get_face_func(int in, int active_begin, int active_end)
 {
@@ -666,82 +693,98 @@ inline const char* fallback_color(const char* preferred, const char* fallback)
 }
 
 //------------------------------------------------------------------------------
+static void append_face_sgr(str_base& out, char face)
+{
+    static const char c_normal[] = "\x1b[m";
+
+    switch (face)
+    {
+    default:
+        if (s_classifications)
+        {
+            const char* color = s_classifications->get_face_output(face);
+            if (color)
+            {
+                out << "\x1b[" << color << "m";
+                break;
+            }
+        }
+        // fall through
+    case '0':   out << c_normal; break;
+    case '1':   out << "\x1b[0;7m"; break;
+
+    case '2':   out << fallback_color(s_input_color, c_normal); break;
+    case '*':   out << fallback_color(_rl_display_modmark_color, c_normal); break;
+    case '(':   out << fallback_color(_rl_display_message_color, c_normal); break;
+    case '<':   out << fallback_color(_rl_display_horizscroll_color, c_normal); break;
+    case '#':   out << fallback_color(s_selection_color, "\x1b[0;7m"); break;
+    case '-':   out << fallback_color(s_suggestion_color, "\x1b[0;90m"); break;
+
+    case 'o':   out << fallback_color(s_input_color, c_normal); break;
+    case 'c':
+        if (_rl_command_color)
+            out << "\x1b[" << _rl_command_color << "m";
+        else
+            out << c_normal;
+        break;
+    case 'd':
+        if (_rl_alias_color)
+            out << "\x1b[" << _rl_alias_color << "m";
+        else
+            out << c_normal;
+        break;
+    case 'm':
+        assert(s_argmatcher_color); // Shouldn't reach here otherwise.
+        if (s_argmatcher_color) // But avoid crashing, just in case.
+            out << s_argmatcher_color;
+        break;
+    case 'a':   out << fallback_color(s_arg_color, fallback_color(s_input_color, c_normal)); break;
+    case 'f':   out << fallback_color(s_flag_color, c_normal); break;
+    case 'n':   out << fallback_color(s_none_color, c_normal); break;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Emits one SGR code per run of characters with the same face, and skips it
+// when the run's face resolves to the same SGR code as the run before it (e.g.
+// input text next to a word with no classification color of its own).
 static void puts_face_func(const char* s, const char* face, int n)
 {
     static const char c_normal[] = "\x1b[m";
 
     str<280> out;
+    str<64> cur_sgr(c_normal);
+    str<64> sgr;
     char cur_face = '0';
 
-    while (n)
+    while (n > 0)
     {
+        // Measure the run of characters with the same face.
+        int len = 1;
+        while (len < n && face[len] == *face)
+            len++;
+
         // Append face string if face changed.
         if (cur_face != *face)
         {
             cur_face = *face;
-            switch (cur_face)
+            sgr.clear();
+            append_face_sgr(sgr, cur_face);
+            if (!sgr.equals(cur_sgr.c_str()))
             {
-            default:
-                if (s_classifications)
-                {
-                    const char* color = s_classifications->get_face_output(cur_face);
-                    if (color)
-                    {
-                        out << "\x1b[" << color << "m";
-                        break;
-                    }
-                }
-                // fall through
-            case '0':   out << c_normal; break;
-            case '1':   out << "\x1b[0;7m"; break;
-
-            case '2':   out << fallback_color(s_input_color, c_normal); break;
-            case '*':   out << fallback_color(_rl_display_modmark_color, c_normal); break;
-            case '(':   out << fallback_color(_rl_display_message_color, c_normal); break;
-            case '<':   out << fallback_color(_rl_display_horizscroll_color, c_normal); break;
-            case '#':   out << fallback_color(s_selection_color, "\x1b[0;7m"); break;
-            case '-':   out << fallback_color(s_suggestion_color, "\x1b[0;90m"); break;
-
-            case 'o':   out << fallback_color(s_input_color, c_normal); break;
-            case 'c':
-                if (_rl_command_color)
-                    out << "\x1b[" << _rl_command_color << "m";
-                else
-                    out << c_normal;
-                break;
-            case 'd':
-                if (_rl_alias_color)
-                    out << "\x1b[" << _rl_alias_color << "m";
-                else
-                    out << c_normal;
-                break;
-            case 'm':
-                assert(s_argmatcher_color); // Shouldn't reach here otherwise.
-                if (s_argmatcher_color) // But avoid crashing, just in case.
-                    out << s_argmatcher_color;
-                break;
-            case 'a':   out << fallback_color(s_arg_color, fallback_color(s_input_color, c_normal)); break;
-            case 'f':   out << fallback_color(s_flag_color, c_normal); break;
-            case 'n':   out << fallback_color(s_none_color, c_normal); break;
+                out.concat(sgr.c_str(), sgr.length());
+                cur_sgr = sgr.c_str();
             }
         }
 
-        // Get run of characters with the same face.
-        const char* s_concat = s;
-        const char* face_concat = face;
-        while (n && cur_face == *face)
-        {
-            s++;
-            face++;
-            n--;
-        }
-
         // Append the characters.
-        int len = int(s - s_concat);
-        out.concat(s_concat, len);
+        out.concat(s, len);
+        s += len;
+        face += len;
+        n -= len;
     }
 
-    if (cur_face != '0')
+    if (!cur_sgr.equals(c_normal))
         out.concat(c_normal);
 
     if (g_debug_log_terminal.get())
@@ -1464,7 +1507,29 @@ int clink_popup_history(int count, int invoking_key)
 }
 
 //------------------------------------------------------------------------------
-static void load_user_inputrc(const char* state_dir)
+static bool read_file_contents(const char* path, str_base& out)
+{
+    out.clear();
+
+    wstr_moveable wpath(path);
+    FILE* file = _wfopen(wpath.c_str(), L"rb");
+    if (!file)
+        return false;
+
+    char buffer[4096];
+    while (true)
+    {
+        const int len = int(fread(buffer, 1, sizeof(buffer), file));
+        if (len <= 0)
+            break;
+        out.concat(buffer, len);
+    }
+    fclose(file);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static bool find_user_inputrc(const char* state_dir, str_base& out, str_base& contents)
 {
 #if defined(PLATFORM_WINDOWS)
     // Remember to update clink_info() if anything changes in here.
@@ -1499,14 +1564,33 @@ static void load_user_inputrc(const char* state_dir)
             path.truncate(base_len);
             path::append(path, file_names[j]);
 
-            if (!rl_read_init_file(path.c_str()))
+            if (read_file_contents(path.c_str(), contents))
             {
-                LOG("Found Readline inputrc at '%s'", path.c_str());
-                return;
+                out = path.c_str();
+                return true;
             }
         }
     }
 #endif // PLATFORM_WINDOWS
+
+    out.clear();
+    contents.clear();
+    return false;
+}
+
+//------------------------------------------------------------------------------
+static rl_bindings_cache s_bindings_cache;
+
+//------------------------------------------------------------------------------
+rl_bindings_cache& get_rl_bindings_cache()
+{
+    return s_bindings_cache;
+}
+
+//------------------------------------------------------------------------------
+void invalidate_rl_bindings_cache()
+{
+    s_bindings_cache.invalidate();
 }
 
 //------------------------------------------------------------------------------
@@ -1520,6 +1604,20 @@ static void bind_keyseq_list(const two_strings* list, Keymap map)
 //------------------------------------------------------------------------------
 void initialise_readline(const char* shell_name, const char* state_dir)
 {
+    // Find the inputrc file and hash its contents.  If neither it nor the
+    // settings that select the default bindings have changed, then the key
+    // bindings and config variables from last time are still correct.
+    str_moveable inputrc;
+    str_moveable contents;
+    const bool found_inputrc = find_user_inputrc(state_dir, inputrc, contents);
+    const unsigned int hash = str_hash(contents.c_str(), contents.length());
+    const int default_bindings = g_default_bindings.get();
+    if (s_bindings_cache.is_current(inputrc.c_str(), hash, default_bindings, rl_editing_mode))
+    {
+        rl_set_keymap_from_edit_mode();
+        return;
+    }
+
     // Readline needs a tweak of its handling of 'meta' (i.e. IO bytes >=0x80)
     // so that it handles UTF-8 correctly (convert=input, output=output).
     // Because these affect key binding translations, these are set even before
@@ -1789,7 +1887,7 @@ void initialise_readline(const char* shell_name, const char* state_dir)
     bind_keyseq_list(general_key_binds, emacs_standard_keymap);
     bind_keyseq_list(emacs_key_binds, emacs_standard_keymap);
     bind_keyseq_list(bash_emacs_key_binds, emacs_standard_keymap);
-    if (g_default_bindings.get() == 1)
+    if (default_bindings == 1)
         bind_keyseq_list(windows_emacs_key_binds, emacs_standard_keymap);
 
     rl_unbind_key_in_map(27, vi_insertion_keymap);
@@ -1799,11 +1897,14 @@ void initialise_readline(const char* shell_name, const char* state_dir)
     bind_keyseq_list(vi_movement_key_binds, vi_movement_keymap);
 
     // Finally, load the inputrc file.
-    load_user_inputrc(state_dir);
+    if (found_inputrc && !rl_read_init_file(inputrc.c_str()))
+        LOG("Found Readline inputrc at '%s'", inputrc.c_str());
 
     // Override the effect of any 'set keymap' assignments in the inputrc file.
     // This mimics what rl_initialize() does.
     rl_set_keymap_from_edit_mode();
+
+    s_bindings_cache.update(inputrc.c_str(), hash, default_bindings, rl_editing_mode);
 }
 
 
@@ -1981,6 +2082,8 @@ rl_module::rl_module(terminal_in* input)
     rl_get_face_func = get_face_func;
     rl_puts_face_func = puts_face_func;
     rl_macro_hook_func = macro_hook_func;
+    rl_find_next_cluster_func = find_next_cluster_func;
+    rl_find_prev_cluster_func = find_prev_cluster_func;
     rl_last_func_hook_func = last_func_hook_func;
     rl_ignore_completion_duplicates = 0; // We'll handle de-duplication.
     rl_sort_completion_matches = 0; // We'll handle sorting.
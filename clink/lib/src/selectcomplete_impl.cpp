@@ -12,6 +12,7 @@
 #include "matches_lookaside.h"
 
 #include <core/base.h>
+#include <core/grapheme_iter.h>
 #include <core/settings.h>
 #include <core/str_compare.h>
 #include <core/str_iter.h>
@@ -122,11 +123,10 @@ int ellipsify(const char* in, int limit, str_base& out, bool expand_ctrl)
             break;
         if (code.get_type() == ecma48_code::type_chars)
         {
-            const char* prev = code.get_pointer();
-            str_iter inner_iter(code.get_pointer(), code.get_length());
+            grapheme_iter inner_iter(code.get_pointer(), code.get_length());
             while (const int c = inner_iter.next())
             {
-                const int clen = (expand_ctrl && (CTRL_CHAR(c) || c == RUBOUT)) ? 2 : clink_wcwidth(c);
+                const int clen = (expand_ctrl && (CTRL_CHAR(c) || c == RUBOUT)) ? 2 : clink_wcwidth(inner_iter);
                 if (truncate_visible < 0 && visible_len + clen > limit - ellipsis_len)
                 {
                     truncate_visible = visible_len;
@@ -144,8 +144,7 @@ int ellipsify(const char* in, int limit, str_base& out, bool expand_ctrl)
                     return visible_len;
                 }
                 visible_len += clen;
-                out.concat(prev, inner_iter.get_pointer() - prev);
-                prev = inner_iter.get_pointer();
+                out.concat(inner_iter.get_cluster(), inner_iter.get_cluster_length());
             }
         }
         else
@@ -331,6 +330,16 @@ const char* match_adapter::get_match(unsigned int index) const
     return nullptr;
 }
 
+//------------------------------------------------------------------------------
+int match_adapter::find_match(const char* match) const
+{
+    const unsigned int count = get_match_count();
+    for (unsigned int i = 0; i < count; i++)
+        if (strcmp(get_match(i), match) == 0)
+            return i;
+    return -1;
+}
+
 //------------------------------------------------------------------------------
 const char* match_adapter::get_match_display(unsigned int index) const
 {
@@ -611,6 +620,46 @@ cant_activate:
     return true;
 }
 
+//------------------------------------------------------------------------------
+// Generates matches again while active (e.g. after an async match generator
+// finishes), keeping the same match selected if it's still present.
+void selectcomplete_impl::refresh()
+{
+    assert(is_active());
+
+    str<> selected;
+    if (m_index >= 0 && m_index < int(m_matches.get_match_count()))
+        selected = m_matches.get_match(m_index);
+
+    insert_needle();
+    reset_generate_matches();
+    update_matches(false/*restrict*/, true/*regen*/);
+
+    // If the selected match is gone, start over from the first match, the same
+    // as when the needle changes; the old index may be past the end now.
+    const int count = m_matches.get_match_count();
+    const int index = m_matches.find_match(selected.c_str());
+    if (index >= 0)
+        m_index = index;
+    else
+    {
+        m_top = 0;
+        m_index = 0;
+        m_prev_displayed = -1;
+    }
+
+    // If no matches are left, the needle stays inserted, and the next input
+    // cancels.
+    if (count)
+    {
+        update_top();
+        insert_match();
+        update_display();
+    }
+
+    m_buffer->draw();
+}
+
 //------------------------------------------------------------------------------
 bool selectcomplete_impl::point_within(int in) const
 {
@@ -1070,7 +1119,7 @@ void selectcomplete_impl::cancel(editor_module::result& result)
 }
 
 //------------------------------------------------------------------------------
-void selectcomplete_impl::update_matches(bool restrict)
+void selectcomplete_impl::update_matches(bool restrict, bool regen)
 {
     ::force_update_internal(restrict);
     m_matches.set_regen_matches(nullptr);
@@ -1110,6 +1159,10 @@ void selectcomplete_impl::update_matches(bool restrict)
         // Initialize whether descriptions are available.
         m_matches.init_has_descriptions();
     }
+    else if (regen)
+    {
+        m_matches.init_has_descriptions();
+    }
 
     // Perform match display filtering.
     const display_filter_flags flags = display_filter_flags::selectable;
@@ -1174,7 +1227,7 @@ void selectcomplete_impl::update_matches(bool restrict)
     }
 
     // Determine the longest match.
-    if (restrict || filtered)
+    if (restrict || regen || filtered)
     {
         if (restrict)
             m_match_longest = 0;
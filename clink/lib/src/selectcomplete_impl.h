@@ -33,6 +33,7 @@ public:
     void            get_lcd(str_base& out) const;
     unsigned int    get_match_count() const;
     const char*     get_match(unsigned int index) const;
+    int             find_match(const char* match) const;
     const char*     get_match_display(unsigned int index) const;
     unsigned int    get_match_visible_display(unsigned int index) const;
     const char*     get_match_description(unsigned int index) const;
@@ -66,6 +67,7 @@ public:
                     selectcomplete_impl(input_dispatcher& dispatcher);
 
     bool            activate(editor_module::result& result, bool reactivate);
+    void            refresh();
     bool            point_within(int in) const;
     bool            is_active() const;
 
@@ -80,7 +82,7 @@ private:
 
     // Internal methods.
     void            cancel(editor_module::result& result);
-    void            update_matches(bool restrict=false);
+    void            update_matches(bool restrict=false, bool regen=false);
     void            update_len();
     void            update_layout();
     void            update_top();
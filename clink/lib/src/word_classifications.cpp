@@ -8,40 +8,33 @@
 #include <core/base.h>
 #include <core/str.h>
 
+#include <algorithm>
 #include <assert.h>
 
 //------------------------------------------------------------------------------
 const size_t face_base = 128;
 const size_t face_max = 100;
 
-//------------------------------------------------------------------------------
-word_classifications::~word_classifications()
-{
-    free(m_faces);
-}
-
 //------------------------------------------------------------------------------
 word_classifications::word_classifications(word_classifications&& other)
 {
     m_info = std::move(other.m_info);
     m_face_definitions = std::move(other.m_face_definitions);
-    m_faces = other.m_faces;
+    m_faces = std::move(other.m_faces);
     m_length = other.m_length;
-    m_face_map = std::move(m_face_map);
+    m_face_map = std::move(other.m_face_map);
 
-    other.m_faces = nullptr;    // Transferred ownership above.
     other.clear();
 }
 
 //------------------------------------------------------------------------------
 void word_classifications::clear()
 {
-    free(m_faces);
-
     m_info.clear();
     m_face_definitions.clear();
-    m_faces = nullptr;
+    m_faces.clear();
     m_length = 0;
+    m_hint = 0;
     m_face_map.clear();
 }
 
@@ -60,16 +53,8 @@ void word_classifications::init(size_t line_length, const word_classifications*
         }
     }
 
-    if (line_length)
-    {
-        m_faces = static_cast<char*>(malloc(line_length));
-        if (m_faces)
-        {
-            m_length = static_cast<unsigned int>(line_length);
-            // Space means not classified; use default color.
-            memset(m_faces, ' ', line_length);
-        }
-    }
+    // No spans means nothing is classified yet; use default color.
+    m_length = static_cast<unsigned int>(line_length);
 }
 
 //------------------------------------------------------------------------------
@@ -114,28 +99,23 @@ void word_classifications::finish(bool show_argmatchers)
 
     for (const auto& info : m_info)
     {
-        const size_t end = min<unsigned int>(info.end, m_length);
-        for (size_t pos = info.start; pos < end; ++pos)
-        {
-            if (info.argmatcher && show_argmatchers)
-                m_faces[pos] = 'm';
-            else if (m_faces[pos] == ' ' && info.word_class < word_class::max)
-                m_faces[pos] = c_faces[int(info.word_class)];
-        }
+        if (info.argmatcher && show_argmatchers)
+            fill_face(info.start, info.end, 'm', true);
+        else if (info.word_class < word_class::max)
+            fill_face(info.start, info.end, c_faces[int(info.word_class)], false);
     }
 }
 
 //------------------------------------------------------------------------------
 bool word_classifications::equals(const word_classifications& other) const
 {
-    if (!m_faces && !other.m_faces)
-        return true;
-    if (!m_faces || !other.m_faces)
+    if (m_length != other.m_length)
         return false;
 
+    // Spans are kept coalesced, so equal faces means equal spans.
     if (m_face_definitions.size() != other.m_face_definitions.size())
         return false;
-    if (strcmp(m_faces, other.m_faces) != 0)
+    if (m_faces != other.m_faces)
         return false;
 
     for (size_t ii = m_face_definitions.size(); ii--;)
@@ -158,11 +138,35 @@ bool word_classifications::get_word_class(unsigned int index, word_class& wc) co
 }
 
 //------------------------------------------------------------------------------
+// Readline asks for the face of each character in order, so this first checks
+// the gap before the span used last time, the span itself, and the gap after
+// it, and only falls back to a binary search when pos is elsewhere.
 char word_classifications::get_face(unsigned int pos) const
 {
-    if (pos < 0 || pos >= m_length)
+    if (pos >= m_length || m_faces.empty())
+        return ' ';
+
+    unsigned int index = m_hint;
+    if (index >= m_faces.size() ||
+        (index && pos < m_faces[index - 1].end) ||
+        (index + 1 < m_faces.size() && pos >= m_faces[index + 1].start))
+    {
+        // Find the first span that ends after pos.
+        const auto it = std::upper_bound(m_faces.begin(), m_faces.end(), pos, [] (unsigned int pos, const face_span& span) {
+            return pos < span.end;
+        });
+        index = static_cast<unsigned int>(it - m_faces.begin());
+        if (index >= m_faces.size())
+            return ' ';
+        m_hint = index;
+    }
+
+    const face_span& span = m_faces[index];
+    if (pos < span.start)
         return ' ';
-    return m_faces[pos];
+    if (pos < span.end)
+        return span.face;
+    return ' ';
 }
 
 //------------------------------------------------------------------------------
@@ -195,13 +199,78 @@ char word_classifications::ensure_face(const char* sgr)
 //------------------------------------------------------------------------------
 void word_classifications::apply_face(unsigned int start, unsigned int length, char face, bool overwrite)
 {
-    while (length > 0 && start < m_length)
+    if (start < m_length)
+        fill_face(start, start + min<unsigned int>(length, m_length - start), face, overwrite);
+}
+
+//------------------------------------------------------------------------------
+// Sets the face for [start, end), or only for the parts of it that aren't
+// classified yet when overwrite is false.  Only the spans that overlap the
+// range are rebuilt, and adjacent spans with the same face are merged so that
+// the span list stays canonical.
+void word_classifications::fill_face(unsigned int start, unsigned int end, char face, bool overwrite)
+{
+    end = min<unsigned int>(end, m_length);
+    if (start >= end)
+        return;
+    if (face == ' ' && !overwrite)
+        return;
+
+    // Spans [first, last) overlap [start, end).
+    const auto first = std::upper_bound(m_faces.begin(), m_faces.end(), start, [] (unsigned int pos, const face_span& span) {
+        return pos < span.end;
+    });
+    const auto last = std::lower_bound(first, m_faces.end(), end, [] (const face_span& span, unsigned int pos) {
+        return span.start < pos;
+    });
+
+    std::vector<face_span> replace;
+    if (overwrite)
+    {
+        if (first != last && first->start < start)
+            replace.push_back({ first->start, start, first->face });
+        if (face != ' ')
+            replace.push_back({ start, end, face });
+        if (first != last && (last - 1)->end > end)
+            replace.push_back({ end, (last - 1)->end, (last - 1)->face });
+    }
+    else
     {
-        if (overwrite || m_faces[start] == ' ')
-            m_faces[start] = face;
-        start++;
-        length--;
+        unsigned int pos = start;
+        for (auto it = first; it != last; ++it)
+        {
+            if (it->start > pos)
+                replace.push_back({ pos, it->start, face });
+            replace.push_back(*it);
+            pos = it->end;
+        }
+        if (pos < end)
+            replace.push_back({ pos, end, face });
     }
+
+    // Merge with each other and with the neighboring spans.
+    size_t index = first - m_faces.begin();
+    m_faces.insert(m_faces.erase(first, last), replace.begin(), replace.end());
+    if (index)
+        --index;
+    size_t stop = index + replace.size() + 1;
+    while (index + 1 < m_faces.size() && index < stop)
+    {
+        face_span& a = m_faces[index];
+        const face_span& b = m_faces[index + 1];
+        if (a.end == b.start && a.face == b.face)
+        {
+            a.end = b.end;
+            m_faces.erase(m_faces.begin() + index + 1);
+            --stop;
+        }
+        else
+        {
+            ++index;
+        }
+    }
+
+    m_hint = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -217,3 +286,68 @@ bool word_classifications::is_word_classified(unsigned int word_index)
 {
     return (word_index < m_info.size() && m_info[word_index].word_class < word_class::max);
 }
+
+//------------------------------------------------------------------------------
+void word_classifications::save_command(unsigned int index, unsigned int count, unsigned int start, unsigned int length, command_classification& out) const
+{
+    out.info.clear();
+    out.faces.clear();
+    out.face_definitions.clear();
+    out.length = 0;
+
+    for (unsigned int i = index; i < index + count && i < m_info.size(); ++i)
+        out.info.push_back(m_info[i]);
+
+    if (start >= m_length)
+        return;
+
+    char local_faces[face_max] = {};
+    const unsigned int end = min<unsigned int>(start + length, m_length);
+    out.length = end - start;
+    for (const auto& span : m_faces)
+    {
+        if (span.end <= start)
+            continue;
+        if (span.start >= end)
+            break;
+
+        char face = span.face;
+        const unsigned int custom = static_cast<unsigned char>(face) - face_base;
+        if (custom < m_face_definitions.size())
+        {
+            if (!local_faces[custom])
+            {
+                local_faces[custom] = char(face_base + out.face_definitions.size());
+                out.face_definitions.emplace_back(m_face_definitions[custom].c_str());
+            }
+            face = local_faces[custom];
+        }
+        out.faces.push_back({ max<unsigned int>(span.start, start) - start, min<unsigned int>(span.end, end) - start, face });
+    }
+}
+
+//------------------------------------------------------------------------------
+void word_classifications::restore_command(unsigned int index, unsigned int start, const command_classification& in)
+{
+    for (size_t i = 0; i < in.info.size() && index + i < m_info.size(); ++i)
+    {
+        m_info[index + i].word_class = in.info[i].word_class;
+        m_info[index + i].argmatcher = in.info[i].argmatcher;
+    }
+
+    fill_face(start, start + in.length, ' ', true);
+
+    char faces[face_max] = {};
+    for (const auto& span : in.faces)
+    {
+        char face = span.face;
+        const unsigned int custom = static_cast<unsigned char>(face) - face_base;
+        if (custom < in.face_definitions.size())
+        {
+            if (!faces[custom])
+                faces[custom] = ensure_face(in.face_definitions[custom].c_str());
+            face = faces[custom] ? faces[custom] : ' ';
+        }
+        fill_face(start + span.start, start + span.end, face, true);
+    }
+}
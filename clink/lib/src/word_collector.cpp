@@ -2,6 +2,7 @@
 // License: http://opensource.org/licenses/MIT
 
 #include "pch.h"
+#include "doskey.h"
 #include "line_buffer.h"
 #include "line_state.h"
 #include "word_collector.h"
@@ -10,7 +11,6 @@
 #include <core/str.h>
 #include <core/str_iter.h>
 #include <core/str_tokeniser.h>
-#include <core/os.h>
 
 #include <vector>
 #include <memory>
@@ -145,9 +145,8 @@ unsigned int word_collector::collect_words(const char* line_buffer, unsigned int
             if (first_word_len > 0)
             {
                 str<32> lookup;
-                str<32> alias;
                 lookup.concat(line_buffer + command.offset, first_word_len);
-                if (os::get_alias(lookup.c_str(), alias))
+                if (doskey::is_alias(lookup.c_str()))
                 {
                     unsigned char delim = (doskey_len < command.length) ? line_buffer[command.offset + doskey_len] : 0;
                     doskey_len = first_word_len;
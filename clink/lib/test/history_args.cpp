@@ -0,0 +1,84 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lib/history_args.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("History args")
+{
+    history_args args;
+    args.add("git checkout main");
+    args.add("ssh host1");
+    args.add("git checkout feature & ssh host2 > nul");
+    args.add("C:\\tools\\SSH.exe host1");
+
+    std::vector<history_arg> out;
+
+    SECTION("Most recent first")
+    {
+        REQUIRE(args.get("ssh", out));
+        REQUIRE(out.size() == 2);
+        REQUIRE(strcmp(out[0].arg, "host1") == 0);
+        REQUIRE(out[0].count == 2);
+        REQUIRE(strcmp(out[1].arg, "host2") == 0);
+        REQUIRE(out[1].count == 1);
+    }
+
+    SECTION("Multiple commands per line")
+    {
+        REQUIRE(args.get("git", out));
+        REQUIRE(out.size() == 3);
+        REQUIRE(strcmp(out[0].arg, "feature") == 0);
+        REQUIRE(strcmp(out[1].arg, "checkout") == 0);
+        REQUIRE(out[1].count == 2);
+        REQUIRE(strcmp(out[2].arg, "main") == 0);
+    }
+
+    SECTION("Max")
+    {
+        REQUIRE(args.get("git.exe", out, 1));
+        REQUIRE(out.size() == 1);
+    }
+
+    SECTION("Unknown command")
+    {
+        REQUIRE(!args.get("hg", out));
+        REQUIRE(out.empty());
+    }
+
+    SECTION("Remove")
+    {
+        args.remove("ssh host1");
+        REQUIRE(args.get("ssh", out));
+        REQUIRE(out.size() == 2);
+        REQUIRE(strcmp(out[0].arg, "host1") == 0);
+        REQUIRE(out[0].count == 1);
+
+        args.remove("ssh host1");
+        args.remove("git checkout main");
+        REQUIRE(args.get("ssh", out));
+        REQUIRE(out.size() == 1);
+        REQUIRE(strcmp(out[0].arg, "host2") == 0);
+        REQUIRE(args.get("git", out));
+        REQUIRE(out.size() == 2);
+        REQUIRE(strcmp(out[0].arg, "feature") == 0);
+        REQUIRE(strcmp(out[1].arg, "checkout") == 0);
+        REQUIRE(out[1].count == 1);
+
+        // Removing something that was never added is harmless.
+        args.remove("hg update");
+        args.remove("ssh host3");
+        REQUIRE(!args.get("hg", out));
+        REQUIRE(args.get("ssh", out));
+        REQUIRE(out.size() == 1);
+    }
+
+    SECTION("Clear")
+    {
+        args.clear();
+        REQUIRE(args.empty());
+        REQUIRE(!args.get("git", out));
+    }
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lib/matches.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+//------------------------------------------------------------------------------
+// Simulates an argmatcher with a static table of flags and descriptions.
+static void add_flags(match_builder& builder)
+{
+    // Copy the table each time, so that interning can't rely on the caller's
+    // pointers being the same.
+    char desc_a[] = "Show all entries";
+    char desc_b[] = "Show brief output";
+    char desc_c[] = "Show all entries";
+
+    builder.add_match(match_desc("-a", nullptr, desc_a, match_type::arg));
+    builder.add_match(match_desc("-b", "-b [level]", desc_b, match_type::arg));
+    builder.add_match(match_desc("-c", nullptr, desc_c, match_type::arg));
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match string pool")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    match_builder builder(matches);
+
+    pipeline.reset();
+    add_flags(builder);
+    pipeline.select("");
+    pipeline.sort();
+
+    REQUIRE(matches.get_match_count() == 3);
+    const char* desc_a = matches.get_match_description(0);
+    const char* desc_b = matches.get_match_description(1);
+    const char* desc_c = matches.get_match_description(2);
+    const char* display_b = matches.get_match_display(1);
+    REQUIRE(strcmp(desc_a, "Show all entries") == 0);
+    REQUIRE(strcmp(desc_b, "Show brief output") == 0);
+    REQUIRE(strcmp(display_b, "-b [level]") == 0);
+
+    SECTION("Identical content is stored once")
+    {
+        REQUIRE(desc_a == desc_c);
+        REQUIRE(desc_a != desc_b);
+    }
+
+    SECTION("Stable across generations")
+    {
+        for (int generation = 0; generation < 3; ++generation)
+        {
+            pipeline.reset();
+            add_flags(builder);
+            pipeline.select("");
+            pipeline.sort();
+
+            REQUIRE(matches.get_match_count() == 3);
+            REQUIRE(matches.get_match_description(0) == desc_a);
+            REQUIRE(matches.get_match_description(1) == desc_b);
+            REQUIRE(matches.get_match_description(2) == desc_c);
+            REQUIRE(matches.get_match_display(1) == display_b);
+        }
+    }
+
+    SECTION("Other generators reuse the same entries")
+    {
+        pipeline.reset();
+        builder.add_match(match_desc("--all", nullptr, "Show all entries", match_type::arg));
+        builder.add_match(match_desc("--new", nullptr, "Something new", match_type::arg));
+        pipeline.select("");
+        pipeline.sort();
+
+        REQUIRE(matches.get_match_count() == 2);
+        REQUIRE(matches.get_match_description(0) == desc_a);
+        REQUIRE(strcmp(matches.get_match_description(1), "Something new") == 0);
+    }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lib/matches.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+
+//------------------------------------------------------------------------------
+static void add_words(match_builder& builder, std::initializer_list<const char*> words)
+{
+    for (const char* word : words)
+        builder.add_match(word, match_type::word);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Match runs")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    match_builder builder(matches);
+    pipeline.reset();
+
+    SECTION("Merge sorted runs")
+    {
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "apple", "cherry", "grape" });
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "banana", "date" });
+
+        pipeline.select("");
+        pipeline.sort();
+
+        REQUIRE(matches.get_match_count() == 5);
+        REQUIRE(strcmp(matches.get_match(0), "apple") == 0);
+        REQUIRE(strcmp(matches.get_match(1), "banana") == 0);
+        REQUIRE(strcmp(matches.get_match(2), "cherry") == 0);
+        REQUIRE(strcmp(matches.get_match(3), "date") == 0);
+        REQUIRE(strcmp(matches.get_match(4), "grape") == 0);
+    }
+
+    SECTION("Wrongly declared sorted")
+    {
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "cherry", "apple" });
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "banana" });
+
+        pipeline.select("");
+        pipeline.sort();
+
+        REQUIRE(matches.get_match_count() == 3);
+        REQUIRE(strcmp(matches.get_match(0), "apple") == 0);
+        REQUIRE(strcmp(matches.get_match(1), "banana") == 0);
+        REQUIRE(strcmp(matches.get_match(2), "cherry") == 0);
+    }
+
+    SECTION("Merge after select")
+    {
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "bar", "cat", "cob" });
+        builder.begin_run();
+        builder.set_sorted();
+        add_words(builder, { "cab", "car", "dog" });
+
+        pipeline.select("c");
+        pipeline.sort();
+
+        REQUIRE(matches.get_match_count() == 4);
+        REQUIRE(strcmp(matches.get_match(0), "cab") == 0);
+        REQUIRE(strcmp(matches.get_match(1), "car") == 0);
+        REQUIRE(strcmp(matches.get_match(2), "cat") == 0);
+        REQUIRE(strcmp(matches.get_match(3), "cob") == 0);
+    }
+
+    SECTION("Unique run still dedups later runs")
+    {
+        builder.begin_run();
+        builder.set_unique();
+        add_words(builder, { "abc", "def" });
+        builder.begin_run();
+        REQUIRE(!builder.add_match("abc", match_type::word));
+        REQUIRE(builder.add_match("xyz", match_type::word));
+        matches.done_building();
+
+        pipeline.select("");
+        REQUIRE(matches.get_match_count() == 3);
+    }
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/str.h>
+#include <lua/lua_state.h>
+#include <rl/rl_bindings_cache.h>
+#include <readline/readline.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Readline bindings cache")
+{
+    SECTION("Inputs")
+    {
+        rl_bindings_cache cache;
+        REQUIRE(!cache.is_valid());
+        REQUIRE(!cache.is_current("", 0, -1, -1));
+
+        cache.update("c:\\inputrc", 123, 1, 1);
+        REQUIRE(cache.is_valid());
+        REQUIRE(cache.is_current("c:\\inputrc", 123, 1, 1));
+
+        REQUIRE(!cache.is_current("c:\\other", 123, 1, 1));
+        REQUIRE(!cache.is_current("c:\\inputrc", 124, 1, 1));
+        REQUIRE(!cache.is_current("c:\\inputrc", 123, 0, 1));
+        REQUIRE(!cache.is_current("c:\\inputrc", 123, 1, 0));
+
+        cache.invalidate();
+        REQUIRE(!cache.is_valid());
+        REQUIRE(!cache.is_current("c:\\inputrc", 123, 1, 1));
+
+        // No inputrc file found is a valid state too.
+        cache.update("", 0, 0, 1);
+        REQUIRE(cache.is_current("", 0, 0, 1));
+        REQUIRE(!cache.is_current("c:\\inputrc", 0, 0, 1));
+    }
+
+    SECTION("Lua invalidates")
+    {
+        rl_bindings_cache& cache = get_rl_bindings_cache();
+        cache.update("", 0, 0, 1);
+        REQUIRE(cache.is_valid());
+
+        lua_state lua;
+
+        // Unknown variables are rejected and leave the cache alone.
+        REQUIRE(lua.do_string("assert(rl.setvariable('not-a-variable', 'on') == nil)"));
+        REQUIRE(cache.is_valid());
+
+        str<> old(rl_variable_value("completion-ignore-case"));
+        REQUIRE(!old.empty());
+
+        str<> script;
+        script.format("assert(rl.setvariable('completion-ignore-case', '%s'))", old.c_str());
+        REQUIRE(lua.do_string(script.c_str()));
+        REQUIRE(!cache.is_valid());
+    }
+}
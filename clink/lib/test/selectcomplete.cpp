@@ -0,0 +1,59 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lib/matches.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+#include <selectcomplete_impl.h>
+
+//------------------------------------------------------------------------------
+static void generate(match_pipeline& pipeline, match_builder& builder, std::initializer_list<const char*> words)
+{
+    pipeline.reset();
+    for (const char* word : words)
+        builder.add_match(word, match_type::word);
+    pipeline.select("");
+    pipeline.sort();
+}
+
+//------------------------------------------------------------------------------
+// When an async match generator finishes, clink-select-complete regenerates the
+// matches and looks for the selected match again to decide where the selection
+// goes.
+TEST_CASE("Select complete refresh")
+{
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    match_builder builder(matches);
+
+    match_adapter adapter;
+    adapter.set_matches(&matches);
+
+    generate(pipeline, builder, { "alpha", "beta", "gamma" });
+    REQUIRE(adapter.get_match_count() == 3);
+    REQUIRE(adapter.find_match("gamma") == 2);
+
+    SECTION("Selected match still present")
+    {
+        generate(pipeline, builder, { "alpha", "beta", "delta", "gamma" });
+        REQUIRE(adapter.get_match_count() == 4);
+        REQUIRE(adapter.find_match("gamma") == 3);
+    }
+
+    SECTION("Selected match disappears")
+    {
+        generate(pipeline, builder, { "alpha", "beta" });
+        REQUIRE(adapter.get_match_count() == 2);
+        REQUIRE(adapter.find_match("gamma") == -1);
+        REQUIRE(adapter.find_match("beta") == 1);
+    }
+
+    SECTION("No matches left")
+    {
+        generate(pipeline, builder, {});
+        REQUIRE(adapter.get_match_count() == 0);
+        REQUIRE(adapter.find_match("gamma") == -1);
+    }
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lib/word_classifications.h>
+
+//------------------------------------------------------------------------------
+static void verify_faces(const word_classifications& classifications, const char* expected)
+{
+    str<> faces;
+    for (unsigned int i = 0; expected[i]; ++i)
+    {
+        char face = classifications.get_face(i);
+        faces.concat(&face, 1);
+    }
+
+    REQUIRE(faces.equals(expected), [&] () {
+        printf("expected '%s'\n     got '%s'\n", expected, faces.c_str());
+    });
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Word classification faces")
+{
+    word_classifications classifications;
+    classifications.init(12, nullptr);
+
+    SECTION("Empty")
+    {
+        verify_faces(classifications, "            ");
+        REQUIRE(classifications.get_face_spans().empty());
+        REQUIRE(classifications.get_face(100) == ' ');
+    }
+
+    SECTION("Overwrite")
+    {
+        classifications.apply_face(2, 6, 'a');
+        classifications.apply_face(4, 2, 'f');
+        verify_faces(classifications, "  aaffaa    ");
+        REQUIRE(classifications.get_face_spans().size() == 3);
+
+        classifications.apply_face(3, 4, 'a');
+        verify_faces(classifications, "  aaaaaa    ");
+        REQUIRE(classifications.get_face_spans().size() == 1);
+
+        classifications.apply_face(8, 100, 'c');
+        verify_faces(classifications, "  aaaaaacccc");
+        REQUIRE(classifications.get_face(12) == ' ');
+    }
+
+    SECTION("Fill gaps only")
+    {
+        classifications.apply_face(2, 2, 'a');
+        classifications.apply_face(6, 2, 'f');
+        classifications.apply_face(0, 10, 'c', false);
+        verify_faces(classifications, "ccaaccffcc  ");
+        REQUIRE(classifications.get_face_spans().size() == 5);
+    }
+
+    SECTION("Random access")
+    {
+        classifications.apply_face(1, 1, 'a');
+        classifications.apply_face(5, 3, 'f');
+        REQUIRE(classifications.get_face(6) == 'f');
+        REQUIRE(classifications.get_face(0) == ' ');
+        REQUIRE(classifications.get_face(1) == 'a');
+        REQUIRE(classifications.get_face(11) == ' ');
+        REQUIRE(classifications.get_face(4) == ' ');
+        REQUIRE(classifications.get_face(7) == 'f');
+        REQUIRE(classifications.get_face(8) == ' ');
+    }
+
+    SECTION("Equals")
+    {
+        word_classifications other;
+        other.init(12, nullptr);
+        REQUIRE(classifications.equals(other));
+
+        classifications.apply_face(0, 4, 'a');
+        classifications.apply_face(4, 4, 'a');
+        other.apply_face(0, 8, 'a');
+        REQUIRE(classifications.equals(other));
+
+        other.apply_face(3, 1, 'f');
+        REQUIRE(!classifications.equals(other));
+
+        word_classifications shorter;
+        shorter.init(8, nullptr);
+        shorter.apply_face(0, 8, 'a');
+        REQUIRE(!classifications.equals(shorter));
+    }
+
+    SECTION("Custom faces")
+    {
+        const char face = classifications.ensure_face("38;5;123");
+        REQUIRE(face);
+        REQUIRE(classifications.ensure_face("38;5;123") == face);
+        REQUIRE(strcmp(classifications.get_face_output(face), "38;5;123") == 0);
+
+        classifications.apply_face(3, 2, face);
+        REQUIRE(classifications.get_face(3) == face);
+        REQUIRE(classifications.get_face(5) == ' ');
+    }
+
+    SECTION("Save and restore")
+    {
+        const char face = classifications.ensure_face("1;33");
+        classifications.apply_face(2, 2, 'c');
+        classifications.apply_face(5, 3, face);
+
+        command_classification saved;
+        classifications.save_command(0, 0, 3, 6, saved);
+        REQUIRE(saved.length == 6);
+        REQUIRE(saved.faces.size() == 2);
+
+        word_classifications other;
+        other.init(12, nullptr);
+        other.apply_face(0, 12, 'o');
+        other.restore_command(0, 5, saved);
+        verify_faces(other, "oooooc ");
+        const char restored = other.get_face(7);
+        REQUIRE(restored);
+        REQUIRE(strcmp(other.get_face_output(restored), "1;33") == 0);
+        REQUIRE(other.get_face(9) == restored);
+        REQUIRE(other.get_face(10) == ' ');
+        REQUIRE(other.get_face(11) == 'o');
+    }
+}
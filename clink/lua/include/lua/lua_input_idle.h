@@ -13,7 +13,6 @@ class lua_input_idle
 {
 public:
                     lua_input_idle(lua_state& state);
-                    ~lua_input_idle();
     void            reset() override;
     bool            is_enabled() override;
     unsigned        get_timeout() override;
@@ -24,7 +23,6 @@ private:
     bool            has_coroutines();
     void            resume_coroutines();
     lua_state&      m_state;
-    void*           m_event = 0;
     unsigned        m_iterations = 0;
     bool            m_enabled = true;
 };
@@ -44,6 +44,7 @@ public:
     bool            send_event_cancelable(const char* event_name, int nargs=0);
     bool            send_event_cancelable_string_inout(const char* event_name, const char* string, str_base& out);
     bool            call_lua_rl_global_function(const char* func_name, line_state* line);
+    void            refresh_settings();
 
     void            print_error(const char* error);
 
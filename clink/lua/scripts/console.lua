@@ -27,8 +27,9 @@ function console.screengrab(candidate_pattern, accept_pattern)
         _start = console.getnumlines() - 1
     end
 
-    for i = _start,_end,-1 do
-        local line = console.getlinetext(i)
+    -- Fetch the lines as a batch; reading them one at a time is slow.
+    local lines = _start >= _end and console._getlinetexts(_start, _end) or {}
+    for _,line in ipairs(lines) do
         if line then
             -- Collect candidates from the line.
             local words = {}
@@ -392,6 +392,64 @@ function clink.removecoroutine(coroutine)
     end
 end
 
+--------------------------------------------------------------------------------
+-- Runs func in a coroutine and caches its return value in entry.result; used by
+-- clink.promptcoroutine and clink.generatorcoroutine.  When func returns,
+-- entry.done is set and ondone(async) is called.  If the prompt.async setting
+-- is enabled the coroutine runs during idle and after_func runs after each pass
+-- resuming coroutines, otherwise the coroutine runs to completion before this
+-- returns.
+function clink._runcoroutine(entry, func, ondone, after_func)
+    -- Wrap the supplied function to track completion and end result.
+    local dependency_inversion = { c=nil }
+    coroutine.override_src(func)
+    local c = coroutine.create(function (async)
+        -- Call the supplied function.
+        local o = func(async)
+        -- Update the entry indicating completion.
+        entry.done = true
+        entry.result = o
+        ondone(async)
+        if async then
+            clink.removecoroutine(dependency_inversion.c)
+        end
+    end)
+    dependency_inversion.c = c
+
+    if settings.get("prompt.async") then
+        -- Add the coroutine.
+        clink.addcoroutine(c)
+        clink._after_coroutines(after_func)
+    else
+        -- Run the coroutine synchronously if async is disabled.
+        local max_iter = 25
+        for iteration = 1, max_iter + 1, 1 do
+            -- Pass false to let it know it is not async.
+            local result, _ = coroutine.resume(c, false--[[async]])
+            if result then
+                if coroutine.status(c) == "dead" then
+                    break
+                end
+            else
+                if _ and type(_) == "string" then
+                    _error_handler(_)
+                end
+                break
+            end
+            -- Cap iterations when running synchronously, in case it's poorly
+            -- behaved.
+            if iteration >= max_iter then
+                -- Ideally this could print an error message about abandoning a
+                -- misbehaving coroutine, but it would mess up the prompt and
+                -- input line display.
+                break
+            end
+        end
+        -- Update the entry indicating completion.
+        entry.done = true
+    end
+end
+
 --------------------------------------------------------------------------------
 --- -name:  io.popenyield
 --- -ver:   1.2.10
@@ -411,11 +469,19 @@ end
 --- "t" for text mode (the default if omitted) or "b" for binary mode.  Write
 --- mode is not supported, so it cannot contain "w".
 ---
+--- The output is collected in memory (spilling into a temp file only if it
+--- is very large).  The returned file handle supports the
+--- <code>read()</code>, <code>lines()</code>, <code>seek()</code>,
+--- <code>setvbuf()</code>, and <code>close()</code> methods, and works with
+--- <code><span class="hljs-built_in">io</span>.type()</code> and
+--- <code><span class="hljs-built_in">io</span>.close()</code>.  Like a read
+--- mode <code><span class="hljs-built_in">io</span>.popen()</code> file handle,
+--- it can't be written to.
+---
 --- <strong>Note:</strong> if the <code>prompt.async</code> setting is disabled,
 --- or while a <a href="transientprompts">transient prompt filter</a> is
---- executing, then this behaves like
---- <code><span class="hljs-built_in">io</span>.<span class="hljs-built_in">popen</span>(<span class="arg">command</span>, <span class="arg">mode</span>)</code>
---- instead.
+--- executing, then this doesn't yield; reading from the file handle waits
+--- until the command has finished instead.
 --- -show:  local file = io.popenyield("git status")
 --- -show:
 --- -show:  while (true) do
@@ -453,7 +519,13 @@ function io.popenyield(command, mode)
         end
         return file
     else
-        return io.popen(command, mode)
+        -- Return the same kind of file handle as when yielding; reading from
+        -- it waits until the output is ready.
+        local file, message, code = io.popenyield_internal(command, mode)
+        if file then
+            return file
+        end
+        return nil, message, code
     end
 end
 
@@ -205,6 +205,25 @@ function clink.onaftercommand(func)
     _add_event_callback("onaftercommand", func)
 end
 
+--------------------------------------------------------------------------------
+--- -name:  clink.onsettingchanged
+--- -ver:   1.3.1
+--- -arg:   func:function
+--- Registers <span class="arg">func</span> to be called when the value of a
+--- setting changes.  Changes are only reported for settings that have a handle
+--- from <a href="#settings.gethandle">settings.gethandle()</a>.  The function
+--- receives three arguments:  the name of the setting, the new value, and the
+--- old value.  It has no return values.
+--- -show:  local strategy = settings.gethandle("autosuggest.strategy")
+--- -show:  clink.onsettingchanged(function(name, value, old)
+--- -show:  &nbsp;   if name == strategy.name then
+--- -show:  &nbsp;       print("autosuggest.strategy changed to "..value)
+--- -show:  &nbsp;   end
+--- -show:  end)
+function clink.onsettingchanged(func)
+    _add_event_callback("onsettingchanged", func)
+end
+
 --------------------------------------------------------------------------------
 function clink._send_onfiltermatches_event(matches, completion_type, filename_completion_desired)
     local ret = nil
@@ -43,6 +43,19 @@ local function generator_onbeginedit()
 end
 clink.onbeginedit(generator_onbeginedit)
 
+--------------------------------------------------------------------------------
+-- Coroutines created by clink.generatorcoroutine(), keyed by where their
+-- function is defined plus the input line text before the word being
+-- completed, so different commands get different coroutines.
+local _generator_coroutines = {}
+local _generator_key = nil              -- Line text before the end word, while generating.
+local _generated_key = nil              -- Same, from the most recent generation.
+local function clear_generator_coroutines()
+    _generator_coroutines = {}
+    _generated_key = nil
+end
+clink.onbeginedit(clear_generator_coroutines)
+
 
 --------------------------------------------------------------------------------
 local function prepare()
@@ -68,6 +81,7 @@ function clink._generate(line_state, match_builder, old_filtering)
         clink.generator_stopped = nil
 
         for _, generator in ipairs(_generators) do
+            match_builder:_beginrun()
             local ret = generator:generate(line_state, match_builder)
             if ret == true then
                 -- Remember the generator function that stopped.
@@ -82,6 +96,11 @@ function clink._generate(line_state, match_builder, old_filtering)
     clink._reset_display_filter()
     clink.use_old_filtering = old_filtering
 
+    local line = line_state:getline()
+    local info = line_state:getwordinfo(line_state:getwordcount())
+    _generator_key = info and line:sub(1, info.offset - 1) or line
+    _generated_key = _generator_key
+
     prepare()
     _current_builder = match_builder
 
@@ -91,15 +110,99 @@ function clink._generate(line_state, match_builder, old_filtering)
         print("match generator failed:")
         print(ret)
         _current_builder = nil
+        _generator_key = nil
         clink.use_old_filtering = nil
         return
     end
 
     _current_builder = nil
+    _generator_key = nil
     clink.use_old_filtering = nil
     return ret or false
 end
 
+--------------------------------------------------------------------------------
+-- Refresh at most once per resume; so if N generator coroutines finish in the
+-- same pass the matches don't regenerate separately N times.  Coroutines for
+-- other input line text don't affect the current matches, so they only cache
+-- their results for later.
+local function refreshmatches_after_coroutines()
+    local refresh = false
+    for _,entry in pairs(_generator_coroutines) do
+        if entry.refresh then
+            refresh = refresh or entry.key == _generated_key
+            entry.refresh = false
+        end
+    end
+    if refresh then
+        clink._refreshmatches()
+    end
+end
+
+--------------------------------------------------------------------------------
+--- -name:  clink.generatorcoroutine
+--- -ver:   1.3.1
+--- -arg:   func:function
+--- -ret:   [return value from func]
+--- This is like <a href="#clink.promptcoroutine">clink.promptcoroutine</a>,
+--- but for match generators.  It runs the <span class="arg">func</span>
+--- function in the background, so that a match generator can collect matches
+--- from something slow (e.g. running <code>git branch</code>) without making
+--- completion wait.  It returns nil until the <span class="arg">func</span>
+--- function has finished, and after that it returns whatever the function
+--- returned.  Completion proceeds immediately with whatever matches are
+--- available.  When the <span class="arg">func</span> function completes,
+--- Clink generates matches again, and if
+--- <code>clink-select-complete</code> is active it updates the list of matches
+--- in place.
+---
+--- A coroutine is only created the first time each function calls this API
+--- for a given input line text preceding the word being completed.
+--- Subsequent calls reuse the already-created coroutine.
+--- -show:  local function get_branches()
+--- -show:  &nbsp;   local branches = {}
+--- -show:  &nbsp;   local f = io.popenyield("git branch --list --format=%(refname:short)")
+--- -show:  &nbsp;   if f then
+--- -show:  &nbsp;       for line in f:lines() do
+--- -show:  &nbsp;           table.insert(branches, line)
+--- -show:  &nbsp;       end
+--- -show:  &nbsp;       f:close()
+--- -show:  &nbsp;   end
+--- -show:  &nbsp;   return branches
+--- -show:  end
+--- -show:
+--- -show:  local g = clink.generator(10)
+--- -show:  function g:generate(line_state, match_builder)
+--- -show:  &nbsp;   if line_state:getword(1) == "checkout" then
+--- -show:  &nbsp;       match_builder:addmatches(clink.generatorcoroutine(get_branches) or {}, "word")
+--- -show:  &nbsp;   end
+--- -show:  end
+function clink.generatorcoroutine(func)
+    if not _generator_key then
+        error("clink.generatorcoroutine can only be used in a match generator", 2)
+    end
+
+    local info = debug.getinfo(func, 'S')
+    local src = info.short_src..":"..info.linedefined
+    local key = src.."|".._generator_key
+
+    local entry = _generator_coroutines[key]
+    if entry == nil then
+        entry = { done=false, refresh=false, result=nil, key=_generator_key }
+        _generator_coroutines[key] = entry
+
+        clink._runcoroutine(entry, func, function (async)
+            -- Regenerate the matches.
+            if async then
+                entry.refresh = true
+            end
+        end, refreshmatches_after_coroutines)
+    end
+
+    -- Return the result, if any.
+    return entry.result
+end
+
 --------------------------------------------------------------------------------
 function clink._get_word_break_info(line_state)
     local impl = function ()
@@ -15,6 +15,7 @@
 #include <core/str_iter.h>
 #include <core/str_transform.h>
 #include <core/settings.h>
+#include <lib/history_args.h>
 #include <lib/popup.h>
 #include <lib/terminal_helpers.h>
 #include <terminal/printer.h>
@@ -35,6 +36,7 @@ extern "C" {
 extern int force_reload_scripts();
 extern setting_bool g_gui_popups;
 extern setting_enum g_dupe_mode;
+extern bool host_get_history_args(const char* command, std::vector<history_arg>& out, unsigned int max);
 
 
 
@@ -535,6 +537,61 @@ static int get_session(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  clink.gethistoryargs
+/// -ver:   1.3.1
+/// -arg:   command:string
+/// -arg:   [max:integer]
+/// -ret:   table
+/// Returns a table of the arguments previously used with
+/// <span class="arg">command</span> in the history, most recently used first.
+/// Each entry is a table with an <code>arg</code> field containing the
+/// argument exactly as it was typed, and a <code>count</code> field containing
+/// how many times it was used.  If <span class="arg">max</span> is provided and
+/// greater than 0, then at most that many entries are returned.
+///
+/// The command name is matched without regard to case, directory, or
+/// extension, so <code>"git"</code> also finds arguments used with
+/// <code>"C:\Program Files\Git\cmd\git.exe"</code>.  Clink maintains an index
+/// of the history for this, so it's fast enough to use from match generators
+/// and suggesters.
+/// -show:  local ssh_hosts = clink.generator(1)
+/// -show:  function ssh_hosts:generate(line_state, match_builder)
+/// -show:  &nbsp;   if line_state:getwordcount() > 1 and line_state:getword(1) == "ssh" then
+/// -show:  &nbsp;       for _, entry in ipairs(clink.gethistoryargs("ssh")) do
+/// -show:  &nbsp;           match_builder:addmatch(entry.arg)
+/// -show:  &nbsp;       end
+/// -show:  &nbsp;   end
+/// -show:  end
+static int get_history_args(lua_State* state)
+{
+    const char* command = checkstring(state, 1);
+    const int max = optinteger(state, 2, 0);
+    if (!command)
+        return 0;
+
+    std::vector<history_arg> args;
+    host_get_history_args(command, args, max > 0 ? max : 0);
+
+    lua_createtable(state, int(args.size()), 0);
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        lua_createtable(state, 0, 2);
+
+        lua_pushliteral(state, "arg");
+        lua_pushstring(state, args[i].arg);
+        lua_rawset(state, -3);
+
+        lua_pushliteral(state, "count");
+        lua_pushinteger(state, args[i].count);
+        lua_rawset(state, -3);
+
+        lua_rawseti(state, -2, int(i + 1));
+    }
+
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  clink.getansihost
 /// -ver:   1.1.48
@@ -707,6 +764,15 @@ static int get_refilter_redisplay_count(lua_State* state)
     return 2;
 }
 
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.
+static int refresh_matches(lua_State* state)
+{
+    extern void refresh_async_matches();
+    refresh_async_matches();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 // UNDOCUMENTED; internal use only.
 static int is_transient_prompt_filter(lua_State* state)
@@ -802,6 +868,7 @@ void clink_lua_initialise(lua_state& lua)
         { "popuplist",              &popup_list },
         { "getsession",             &get_session },
         { "getansihost",            &get_ansi_host },
+        { "gethistoryargs",         &get_history_args },
         { "translateslashes",       &translate_slashes },
         { "reload",                 &reload },
         // Backward compatibility with the Clink 0.4.8 API.  Clink 1.0.0a1 had
@@ -827,6 +894,7 @@ void clink_lua_initialise(lua_state& lua)
         // UNDOCUMENTED; internal use only.
         { "refilterprompt",         &refilter_prompt },
         { "istransientpromptfilter", &is_transient_prompt_filter },
+        { "_refreshmatches",        &refresh_matches },
         { "get_refilter_redisplay_count", &get_refilter_redisplay_count },
         { "history_suggester",      &history_suggester },
     };
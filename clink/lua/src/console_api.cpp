@@ -90,6 +90,10 @@ static int scroll(lua_State* state)
 ///
 /// Note: backspace characters and line endings are counted as visible character
 /// cells and will skew the resulting count.
+///
+/// Emoji sequences (such as flags and ZWJ sequences) count as two cells, the
+/// same as terminals that render them as one emoji.  Readline measures the
+/// input line one code point at a time, so it can count them differently.
 static int get_cell_count(lua_State* state)
 {
     const char* in = checkstring(state, 1);
@@ -226,6 +230,55 @@ static int get_line_text(lua_State* state)
     return 1;
 }
 
+//------------------------------------------------------------------------------
+// Undocumented; used by console.screengrab.  Returns a table with the text of
+// lines first through last (in that order, either direction), read from a
+// single snapshot of the screen buffer so that many lines cost only a few
+// console reads.
+static int get_line_texts(lua_State* state)
+{
+    if (!g_printer)
+        return 0;
+
+    bool isnum;
+    int first = checkinteger(state, 1, &isnum) - 1;
+    if (!isnum)
+        return 0;
+    int last = checkinteger(state, 2, &isnum) - 1;
+    if (!isnum)
+        return 0;
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (!GetConsoleScreenBufferInfo(h, &csbi))
+        return 0;
+
+    const int num_lines = GetConsoleNumLines(csbi);
+    first = max<int>(min<int>(first, num_lines - 1), 0);
+    last = max<int>(min<int>(last, num_lines - 1), 0);
+    const int step = (first <= last) ? 1 : -1;
+
+    screen_snapshot snapshot;
+    str_moveable out;
+
+    lua_createtable(state, abs(last - first) + 1, 0);
+
+    int i = 1;
+    for (int line = first;; line += step)
+    {
+        if (g_printer->get_line_text(line, out))
+            lua_pushlstring(state, out.c_str(), out.length());
+        else
+            lua_pushboolean(state, false);
+        lua_rawseti(state, -2, i++);
+
+        if (line == last)
+            break;
+    }
+
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  console.gettitle
 /// -ver:   1.1.32
@@ -644,6 +697,7 @@ void console_lua_initialise(lua_state& lua)
         { "getnumlines",            &get_num_lines },
         { "gettop",                 &get_top },
         { "getlinetext",            &get_line_text },
+        { "_getlinetexts",          &get_line_texts },
         { "gettitle",               &get_title },
         { "settitle",               &set_title },
         { "islinedefaultcolor",     &is_line_default_color },
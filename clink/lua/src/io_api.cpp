@@ -8,6 +8,7 @@
 #include <core/os.h>
 #include <core/path.h>
 #include <core/globber.h>
+#include <core/task_scheduler.h>
 
 #include <fcntl.h>
 #include <io.h>
@@ -15,6 +16,7 @@
 #include <process.h>
 #include <list>
 #include <memory>
+#include <vector>
 #include <assert.h>
 
 #ifndef _MSC_VER
@@ -24,19 +26,10 @@
 //------------------------------------------------------------------------------
 struct popenrw_info;
 static popenrw_info* s_head = nullptr;
-static HANDLE s_wake_event = nullptr;
-
-//------------------------------------------------------------------------------
-void set_io_wake_event(HANDLE event)
-{
-    // Borrow a ref from the caller.
-    s_wake_event = event;
-}
 
 //------------------------------------------------------------------------------
 struct popenrw_info
 {
-    friend int io_popenyield(lua_State* state);
     friend int io_popenrw(lua_State* state);
 
     static popenrw_info* find(FILE* f)
@@ -77,7 +70,6 @@ struct popenrw_info
     , r(nullptr)
     , w(nullptr)
     , process_handle(0)
-    , async(false)
     {
     }
 
@@ -111,17 +103,11 @@ struct popenrw_info
         return wait;
     }
 
-    bool is_async()
-    {
-        return async;
-    }
-
 private:
     popenrw_info* next;
     FILE* r;
     FILE* w;
     intptr_t process_handle;
-    bool async;
 };
 
 //------------------------------------------------------------------------------
@@ -158,10 +144,9 @@ static int pclosefile(lua_State *state)
     intptr_t process_handle = info->get_wait_handle();
     if (process_handle)
     {
-        bool wait = !info->is_async();
         popenrw_info::remove(info);
         delete info;
-        return luaL_execresult(state, wait ? pclosewait(process_handle) : 0);
+        return luaL_execresult(state, pclosewait(process_handle));
     }
 
     return luaL_fileresult(state, (res == 0), NULL);
@@ -382,73 +367,44 @@ struct pipe_pair
 };
 
 //------------------------------------------------------------------------------
+// Collects the output from a command in memory, so that reading it doesn't
+// need disk IO.  Output beyond c_spill_threshold spills into a temp file.  The
+// output is collected by a blocking task on the task scheduler, and can only be
+// read after it's ready.  The scheduler's completion event wakes the input loop
+// so that coroutines waiting on the output can resume.
 struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
 {
-    popen_buffering(FILE* r, HANDLE w)
+    popen_buffering(FILE* r)
     : m_read(r)
-    , m_write(w)
     {
         assert(r != nullptr);
-        assert(w != nullptr);
-        assert(w != INVALID_HANDLE_VALUE);
     }
 
     ~popen_buffering()
     {
-        if (m_thread_handle)
-        {
-            cancel();
-            CloseHandle(m_thread_handle);
-        }
         if (m_read)
             fclose(m_read);
-        if (m_write)
-            CloseHandle(m_write);
+        if (m_spill)
+            fclose(m_spill);
         if (m_ready_event)
             CloseHandle(m_ready_event);
-        if (m_wake_event)
-            CloseHandle(m_wake_event);
     }
 
-    bool createthread()
+    bool init()
     {
-        assert(!m_suspended);
-        assert(!m_thread_handle);
-        assert(!m_cancelled);
         assert(!m_ready_event);
-        assert(!m_wake_event);
-        if (s_wake_event)
-        {
-            m_wake_event = dup_handle(GetCurrentProcess(), s_wake_event);
-            if (!m_wake_event)
-                return false;
-        }
         m_ready_event = CreateEvent(nullptr, true, false, nullptr);
-        if (!m_ready_event)
-            return false;
-        m_thread_handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0, &threadproc, this, CREATE_SUSPENDED, nullptr));
-        if (!m_thread_handle)
-            return false;
-        m_holder = shared_from_this(); // Now threadproc holds a strong ref.
-        m_suspended = true;
-        return true;
+        return !!m_ready_event;
     }
 
+    // Starts collecting output.  The task holds a strong ref until it's done.
     void go()
     {
-        assert(m_suspended);
-        if (m_thread_handle)
-        {
-            m_suspended = false;
-            ResumeThread(m_thread_handle);
-        }
-    }
-
-    void cancel()
-    {
-        m_cancelled = true;
-        if (m_suspended) // Can only be true when there's no concurrency.
-            ResumeThread(m_thread_handle);
+        assert(m_ready_event);
+        std::shared_ptr<popen_buffering> self = shared_from_this();
+        task_scheduler::get().submit(task_priority::blocking, [self] (task& t) {
+            self->collect(t);
+        });
     }
 
     bool is_ready()
@@ -458,63 +414,119 @@ struct popen_buffering : public std::enable_shared_from_this<popen_buffering>
         return WaitForSingleObject(m_ready_event, 0) == WAIT_OBJECT_0;
     }
 
+    void wait_ready()
+    {
+        if (m_ready_event)
+            WaitForSingleObject(m_ready_event, INFINITE);
+    }
+
     HANDLE get_ready_event()
     {
         return m_ready_event;
     }
 
+    // Reading; only valid once ready.
+    int getc()
+    {
+        assert(is_ready());
+        if (m_spill)
+            return fgetc(m_spill);
+        return (m_pos < m_data.size()) ? static_cast<unsigned char>(m_data[m_pos++]) : EOF;
+    }
+
+    void ungetc(int c)
+    {
+        if (c == EOF)
+            return;
+        if (m_spill)
+            ::ungetc(c, m_spill);
+        else
+        {
+            assert(m_pos > 0);
+            --m_pos;
+        }
+    }
+
+    // Positions are byte offsets into the raw output, the same as for a text
+    // mode FILE*.  Returns -1 if the position is invalid.
+    long long seek(int whence, long long offset)
+    {
+        assert(is_ready());
+        if (m_spill)
+        {
+            if (_fseeki64(m_spill, offset, whence) != 0)
+                return -1;
+            return _ftelli64(m_spill);
+        }
+
+        long long base = 0;
+        if (whence == SEEK_CUR)
+            base = m_pos;
+        else if (whence == SEEK_END)
+            base = m_data.size();
+        if (base + offset < 0)
+            return -1;
+        m_pos = size_t(base + offset);
+        return m_pos;
+    }
+
 private:
-    static unsigned __stdcall threadproc(void* arg)
+    bool append(const BYTE* data, DWORD len)
+    {
+        if (!m_spill)
+        {
+            if (m_data.size() + len <= c_spill_threshold)
+            {
+                m_data.insert(m_data.end(), data, data + len);
+                return true;
+            }
+
+            os::temp_file_mode tfmode = os::temp_file_mode::delete_on_close|os::temp_file_mode::binary;
+            m_spill = os::create_temp_file(nullptr, "clk", ".tmp", tfmode);
+            if (!m_spill)
+                return false;
+
+            if (!m_data.empty() && fwrite(m_data.data(), 1, m_data.size(), m_spill) != m_data.size())
+                return false;
+
+            std::vector<char>().swap(m_data);
+        }
+
+        return fwrite(data, 1, len, m_spill) == len;
+    }
+
+    void collect(task& t)
     {
-        popen_buffering* _this = static_cast<popen_buffering*>(arg);
-        HANDLE rh = reinterpret_cast<HANDLE>(_get_osfhandle(fileno(_this->m_read)));
-        HANDLE wh = _this->m_write;
+        HANDLE rh = reinterpret_cast<HANDLE>(_get_osfhandle(fileno(m_read)));
 
-        while (!_this->m_cancelled)
+        while (!t.is_cancelled())
         {
             DWORD len;
 TODO("COROUTINES: could use overlapped IO to enable cancelling even a blocking call.");
-            if (!ReadFile(rh, _this->m_buffer, sizeof_array(m_buffer), &len, nullptr))
+            if (!ReadFile(rh, m_buffer, sizeof_array(m_buffer), &len, nullptr))
                 break;
 
-            DWORD written;
-            if (!WriteFile(wh, _this->m_buffer, len, &written, nullptr))
-                break;
-            if (written != len)
+            if (!append(m_buffer, len))
                 break;
         }
 
-        // Reset file pointer so the read handle can read from the beginning.
-        SetFilePointer(wh, 0, nullptr, FILE_BEGIN);
-
-        // Close the write handle since it's finished.
-        CloseHandle(_this->m_write);
-        _this->m_write = nullptr;
-
-        // Signal completion events.
-        SetEvent(_this->m_ready_event);
-        if (_this->m_wake_event)
-            SetEvent(_this->m_wake_event);
-
-        // Release threadproc's strong ref.
-        _this->m_holder = nullptr;
+        // Rewind so reading can start from the beginning.
+        if (m_spill)
+            rewind(m_spill);
 
-        _endthreadex(0);
-        return 0;
+        SetEvent(m_ready_event);
     }
 
     FILE* m_read;
-    HANDLE m_write;
-    HANDLE m_thread_handle = 0;
     HANDLE m_ready_event = 0;
-    HANDLE m_wake_event = 0;
-    bool m_suspended = false;
 
-    volatile long m_cancelled = false;
-    volatile long m_ready = false;
+    std::vector<char> m_data;
+    size_t m_pos = 0;
+    FILE* m_spill = nullptr;
 
-    std::shared_ptr<popen_buffering> m_holder;
     BYTE m_buffer[4096];
+
+    static const size_t c_spill_threshold = 4 * 1024 * 1024;
 };
 
 
@@ -615,6 +627,377 @@ int luaL_YieldGuard::__tostring(lua_State* state)
 
 
 
+//------------------------------------------------------------------------------
+// File-like object for reading the output collected by popen_buffering.  It
+// supports the read(), lines(), seek(), setvbuf(), and close() methods of Lua
+// file handles, and io.type() and io.close() accept it.  Writing and flushing
+// aren't supported, the same as a read mode io.popen() file.
+#define LUA_POPENBUFFER "clink_popen_buffer"
+struct luaL_PopenBuffer
+{
+    static luaL_PopenBuffer* make_new(lua_State* state);
+    static luaL_PopenBuffer* test(lua_State* state, int index);
+
+    void init(std::shared_ptr<popen_buffering>& buffering, intptr_t process_handle, bool binary);
+    bool is_closed() const { return !m_buffering; }
+
+private:
+    static luaL_PopenBuffer* check(lua_State* state, int index);
+    int next();
+    bool test_eof(lua_State* state);
+    bool read_line(lua_State* state, bool chop);
+    void read_all(lua_State* state);
+    bool read_chars(lua_State* state, size_t n);
+    bool read_number(lua_State* state);
+    int read_impl(lua_State* state, int first);
+    void close();
+
+    static int read(lua_State* state);
+    static int lines(lua_State* state);
+    static int lines_iter(lua_State* state);
+    static int seek(lua_State* state);
+    static int setvbuf(lua_State* state);
+    static int close(lua_State* state);
+    static int __gc(lua_State* state);
+    static int __tostring(lua_State* state);
+
+    std::shared_ptr<popen_buffering> m_buffering;
+    intptr_t m_process_handle = 0;
+    bool m_binary = false;
+};
+
+//------------------------------------------------------------------------------
+luaL_PopenBuffer* luaL_PopenBuffer::make_new(lua_State* state)
+{
+#ifdef DEBUG
+    int oldtop = lua_gettop(state);
+#endif
+
+    luaL_PopenBuffer* pb = (luaL_PopenBuffer*)lua_newuserdata(state, sizeof(luaL_PopenBuffer));
+    new (pb) luaL_PopenBuffer();
+
+    static const luaL_Reg pblib[] =
+    {
+        {"read", read},
+        {"lines", lines},
+        {"seek", seek},
+        {"setvbuf", luaL_PopenBuffer::setvbuf}, // Ambiguous because of setvbuf().
+        {"close", luaL_PopenBuffer::close}, // Ambiguous because of close().
+        {"__gc", __gc},
+        {"__tostring", __tostring},
+        {nullptr, nullptr}
+    };
+
+    if (luaL_newmetatable(state, LUA_POPENBUFFER))
+    {
+        lua_pushvalue(state, -1);           // push metatable
+        lua_setfield(state, -2, "__index"); // metatable.__index = metatable
+        luaL_setfuncs(state, pblib, 0);     // add methods to new metatable
+    }
+    lua_setmetatable(state, -2);
+
+#ifdef DEBUG
+    int newtop = lua_gettop(state);
+    assert(oldtop - newtop == -1);
+    luaL_PopenBuffer* test = (luaL_PopenBuffer*)luaL_checkudata(state, -1, LUA_POPENBUFFER);
+    assert(test == pb);
+#endif
+
+    return pb;
+}
+
+//------------------------------------------------------------------------------
+luaL_PopenBuffer* luaL_PopenBuffer::test(lua_State* state, int index)
+{
+    return (luaL_PopenBuffer*)luaL_testudata(state, index, LUA_POPENBUFFER);
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenBuffer::init(std::shared_ptr<popen_buffering>& buffering, intptr_t process_handle, bool binary)
+{
+    m_buffering = buffering;
+    m_process_handle = process_handle;
+    m_binary = binary;
+}
+
+//------------------------------------------------------------------------------
+luaL_PopenBuffer* luaL_PopenBuffer::check(lua_State* state, int index)
+{
+    luaL_PopenBuffer* pb = (luaL_PopenBuffer*)luaL_checkudata(state, index, LUA_POPENBUFFER);
+    if (!pb->m_buffering)
+        luaL_error(state, "attempt to use a closed file");
+
+    // Reading normally starts only after io.popenyield has yielded until the
+    // output is ready, but wait here in case it's used some other way.
+    pb->m_buffering->wait_ready();
+    return pb;
+}
+
+//------------------------------------------------------------------------------
+// Text mode translates CRLF to LF, the same as reading a text mode FILE*.
+int luaL_PopenBuffer::next()
+{
+    int c = m_buffering->getc();
+    if (c == '\r' && !m_binary)
+    {
+        int d = m_buffering->getc();
+        if (d == '\n')
+            return d;
+        m_buffering->ungetc(d);
+    }
+    return c;
+}
+
+//------------------------------------------------------------------------------
+bool luaL_PopenBuffer::test_eof(lua_State* state)
+{
+    int c = m_buffering->getc();
+    m_buffering->ungetc(c);
+    lua_pushlstring(state, nullptr, 0);
+    return (c != EOF);
+}
+
+//------------------------------------------------------------------------------
+bool luaL_PopenBuffer::read_line(lua_State* state, bool chop)
+{
+    luaL_Buffer b;
+    luaL_buffinit(state, &b);
+
+    int c;
+    while ((c = next()) != EOF && c != '\n')
+        luaL_addchar(&b, char(c));
+    if (c == '\n' && !chop)
+        luaL_addchar(&b, char(c));
+
+    luaL_pushresult(&b);
+    return (c == '\n' || lua_rawlen(state, -1) > 0);
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenBuffer::read_all(lua_State* state)
+{
+    luaL_Buffer b;
+    luaL_buffinit(state, &b);
+
+    int c;
+    while ((c = next()) != EOF)
+        luaL_addchar(&b, char(c));
+
+    luaL_pushresult(&b);
+}
+
+//------------------------------------------------------------------------------
+bool luaL_PopenBuffer::read_chars(lua_State* state, size_t n)
+{
+    luaL_Buffer b;
+    luaL_buffinit(state, &b);
+
+    int c;
+    while (n-- && (c = next()) != EOF)
+        luaL_addchar(&b, char(c));
+
+    luaL_pushresult(&b);
+    return (lua_rawlen(state, -1) > 0);
+}
+
+//------------------------------------------------------------------------------
+bool luaL_PopenBuffer::read_number(lua_State* state)
+{
+    int c;
+    do
+    {
+        c = next();
+    }
+    while (c != EOF && isspace(c));
+
+    str<64> tmp;
+    while (c != EOF && (isxdigit(c) || strchr("+-.xXpP", c)))
+    {
+        const char ch = char(c);
+        tmp.concat(&ch, 1);
+        c = next();
+    }
+    m_buffering->ungetc(c);
+
+    char* end = nullptr;
+    const lua_Number d = lua_str2number(tmp.c_str(), &end);
+    if (tmp.empty() || *end)
+    {
+        lua_pushnil(state);
+        return false;
+    }
+
+    lua_pushnumber(state, d);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Same formats as file:read() in Lua 5.2.
+int luaL_PopenBuffer::read_impl(lua_State* state, int first)
+{
+    int nargs = lua_gettop(state) - first + 1;
+    bool success;
+    int n;
+
+    if (nargs <= 0)
+    {
+        success = read_line(state, true/*chop*/);
+        n = first + 1;
+    }
+    else
+    {
+        luaL_checkstack(state, nargs + LUA_MINSTACK, "too many arguments");
+        success = true;
+        for (n = first; nargs-- && success; n++)
+        {
+            if (lua_type(state, n) == LUA_TNUMBER)
+            {
+                size_t l = size_t(lua_tointeger(state, n));
+                success = (l == 0) ? test_eof(state) : read_chars(state, l);
+            }
+            else
+            {
+                const char* p = lua_tostring(state, n);
+                luaL_argcheck(state, p && p[0] == '*', n, "invalid option");
+                switch (p[1])
+                {
+                case 'n':   success = read_number(state); break;
+                case 'l':   success = read_line(state, true/*chop*/); break;
+                case 'L':   success = read_line(state, false/*chop*/); break;
+                case 'a':   read_all(state); success = true; break;
+                default:    return luaL_argerror(state, n, "invalid format");
+                }
+            }
+        }
+    }
+
+    if (!success)
+    {
+        lua_pop(state, 1);
+        lua_pushnil(state);
+    }
+
+    return n - first;
+}
+
+//------------------------------------------------------------------------------
+void luaL_PopenBuffer::close()
+{
+    m_buffering = nullptr;
+    if (m_process_handle)
+    {
+        CloseHandle(reinterpret_cast<HANDLE>(m_process_handle));
+        m_process_handle = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::read(lua_State* state)
+{
+    luaL_PopenBuffer* pb = check(state, 1);
+    return pb->read_impl(state, 2);
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::lines(lua_State* state)
+{
+    check(state, 1);
+
+    int n = lua_gettop(state) - 1;
+    luaL_argcheck(state, n <= LUA_MINSTACK - 3, LUA_MINSTACK - 3, "too many arguments");
+    lua_pushvalue(state, 1);
+    lua_pushinteger(state, n);
+    lua_insert(state, 2);
+    lua_insert(state, 2);
+    lua_pushcclosure(state, lines_iter, 2 + n);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::lines_iter(lua_State* state)
+{
+    luaL_PopenBuffer* pb = (luaL_PopenBuffer*)lua_touserdata(state, lua_upvalueindex(1));
+    if (!pb->m_buffering)
+        return luaL_error(state, "file is already closed");
+
+    int n = int(lua_tointeger(state, lua_upvalueindex(2)));
+    lua_settop(state, 1);
+    for (int i = 1; i <= n; i++)
+        lua_pushvalue(state, lua_upvalueindex(2 + i));
+
+    n = pb->read_impl(state, 2);
+    assert(n > 0);
+    return lua_isnil(state, -n) ? 0 : n;
+}
+
+//------------------------------------------------------------------------------
+// Same arguments and results as file:seek() in Lua 5.2.
+int luaL_PopenBuffer::seek(lua_State* state)
+{
+    static const int modes[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    static const char* const modenames[] = { "set", "cur", "end", nullptr };
+
+    luaL_PopenBuffer* pb = check(state, 1);
+    const int op = luaL_checkoption(state, 2, "cur", modenames);
+    const lua_Number offset = luaL_optnumber(state, 3, 0);
+    luaL_argcheck(state, lua_Number(static_cast<long long>(offset)) == offset, 3, "not an integer in proper range");
+
+    const long long pos = pb->m_buffering->seek(modes[op], static_cast<long long>(offset));
+    if (pos < 0)
+    {
+        errno = EINVAL;
+        return luaL_fileresult(state, 0, nullptr);
+    }
+
+    lua_pushnumber(state, lua_Number(pos));
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// The output is already fully buffered, so this only validates the arguments.
+int luaL_PopenBuffer::setvbuf(lua_State* state)
+{
+    static const char* const modenames[] = { "no", "full", "line", nullptr };
+
+    check(state, 1);
+    luaL_checkoption(state, 2, nullptr, modenames);
+    luaL_optinteger(state, 3, LUAL_BUFFERSIZE);
+    return luaL_fileresult(state, 1, nullptr);
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::close(lua_State* state)
+{
+    luaL_PopenBuffer* pb = check(state, 1);
+    pb->close();
+
+    // Like closing an io.popen file handle, except there's no exit code to
+    // report because io.popenyield doesn't wait for the process.
+    return luaL_execresult(state, 0);
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::__gc(lua_State* state)
+{
+    luaL_PopenBuffer* pb = (luaL_PopenBuffer*)luaL_checkudata(state, 1, LUA_POPENBUFFER);
+    pb->close();
+    pb->~luaL_PopenBuffer();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_PopenBuffer::__tostring(lua_State* state)
+{
+    luaL_PopenBuffer* pb = (luaL_PopenBuffer*)luaL_checkudata(state, 1, LUA_POPENBUFFER);
+    if (pb->m_buffering)
+        lua_pushfstring(state, "file (%p)", pb->m_buffering.get());
+    else
+        lua_pushliteral(state, "file (closed)");
+    return 1;
+}
+
+
+
 //------------------------------------------------------------------------------
 /// -name:  io.popenrw
 /// -ver:   1.1.42
@@ -720,7 +1103,7 @@ int luaL_YieldGuard::__tostring(lua_State* state)
 
 //------------------------------------------------------------------------------
 // UNDOCUMENTED; internal use only.  See io.popenyield in coroutines.lua.
-/*static*/ int io_popenyield(lua_State* state) // gcc can't handle 'friend' and 'static'.
+static int io_popenyield(lua_State* state)
 {
     const char* command = checkstring(state, 1);
     const char* mode = optstring(state, 2, "t");
@@ -738,62 +1121,33 @@ int luaL_YieldGuard::__tostring(lua_State* state)
         return luaL_error(state, "invalid mode " LUA_QS
                           " (should match " LUA_QL("r?[bt]?") " or nil)", mode);
 
-    luaL_Stream* pr = nullptr;
+    luaL_PopenBuffer* pb = nullptr;
     luaL_YieldGuard* yg = nullptr;
     pipe_pair pipe_stdout;
 
-    pr = (luaL_Stream*)lua_newuserdata(state, sizeof(luaL_Stream));
-    luaL_setmetatable(state, LUA_FILEHANDLE);
-    pr->f = nullptr;
-    pr->closef = nullptr;
-
+    pb = luaL_PopenBuffer::make_new(state);
     yg = luaL_YieldGuard::make_new(state);
 
     bool failed = true;
-    FILE* temp_read = nullptr;
-    HANDLE temp_write = nullptr;
     std::shared_ptr<popen_buffering> buffering;
-    popenrw_info* info = nullptr;
 
     do
     {
-        os::temp_file_mode tfmode = os::temp_file_mode::delete_on_close;
-        if (binary)
-            tfmode |= os::temp_file_mode::binary;
-        str<> name;
-        temp_read = os::create_temp_file(&name, "clk", ".tmp", tfmode);
-        if (!temp_read)
-            break;
-
-        temp_write = dup_handle(GetCurrentProcess(), reinterpret_cast<HANDLE>(_get_osfhandle(fileno(temp_read))));
-        if (!temp_write)
-            break;
-
-        // The pipe and temp_write are both binary to simplify the thread's job.
+        // The pipe is binary to simplify the task's job; the popen buffer
+        // handles text mode itself.
         if (!pipe_stdout.init(false/*write*/, true/*binary*/))
             break;
 
-        buffering = std::make_shared<popen_buffering>(pipe_stdout.local, temp_write);
+        buffering = std::make_shared<popen_buffering>(pipe_stdout.local);
         pipe_stdout.transfer_local();
-        temp_write = nullptr;
-        if (!buffering->createthread())
+        if (!buffering->init())
             break;
 
-        info = new popenrw_info;
         intptr_t process_handle = popenrw_internal(command, NULL, pipe_stdout.remote);
         if (!process_handle)
             break;
 
-        pr->f = temp_read;
-        pr->closef = &pclosefile;
-        temp_read = nullptr;
-
-        info->r = pr->f;
-        info->process_handle = process_handle;
-        info->async = true;
-        popenrw_info::add(info);
-        info = nullptr;
-
+        pb->init(buffering, process_handle, binary);
         yg->init(buffering, command);
         buffering->go();
 
@@ -805,11 +1159,6 @@ int luaL_YieldGuard::__tostring(lua_State* state)
     {
         errno_t e = errno;
 
-        if (temp_read)
-            fclose(temp_read);
-        if (temp_write)
-            CloseHandle(temp_write);
-        delete info;
         buffering = nullptr;
 
         if (failed)
@@ -821,6 +1170,47 @@ int luaL_YieldGuard::__tostring(lua_State* state)
     return (failed) ? luaL_fileresult(state, 0, command) : 2;
 }
 
+//------------------------------------------------------------------------------
+// io.type() only knows about Lua's own file handles, so this wraps it (the
+// original is upvalue 1) to also recognize the object from io.popenyield.
+static int io_type(lua_State* state)
+{
+    if (const luaL_PopenBuffer* pb = luaL_PopenBuffer::test(state, 1))
+    {
+        if (pb->is_closed())
+            lua_pushliteral(state, "closed file");
+        else
+            lua_pushliteral(state, "file");
+        return 1;
+    }
+
+    lua_pushvalue(state, lua_upvalueindex(1));
+    lua_insert(state, 1);
+    lua_call(state, lua_gettop(state) - 1, LUA_MULTRET);
+    return lua_gettop(state);
+}
+
+//------------------------------------------------------------------------------
+// io.close() only knows about Lua's own file handles, so this wraps it (the
+// original is upvalue 1) to also close the object from io.popenyield.
+static int io_close(lua_State* state)
+{
+    if (luaL_PopenBuffer::test(state, 1))
+    {
+        lua_settop(state, 1);
+        lua_getfield(state, 1, "close");
+        lua_insert(state, 1);
+    }
+    else
+    {
+        lua_pushvalue(state, lua_upvalueindex(1));
+        lua_insert(state, 1);
+    }
+
+    lua_call(state, lua_gettop(state) - 1, LUA_MULTRET);
+    return lua_gettop(state);
+}
+
 //------------------------------------------------------------------------------
 void io_lua_initialise(lua_state& lua)
 {
@@ -843,5 +1233,19 @@ void io_lua_initialise(lua_state& lua)
         lua_rawset(state, -3);
     }
 
+    static const luaL_Reg wrappers[] =
+    {
+        { "type",   &io_type },
+        { "close",  &io_close },
+    };
+
+    for (const auto& wrapper : wrappers)
+    {
+        lua_pushstring(state, wrapper.name);
+        lua_getfield(state, -2, wrapper.name);
+        lua_pushcclosure(state, wrapper.func, 1);
+        lua_rawset(state, -3);
+    }
+
     lua_pop(state, 1);
 }
@@ -0,0 +1,553 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "lua_state.h"
+
+#include <core/base.h>
+#include <core/os.h>
+#include <core/str.h>
+#include <core/task_scheduler.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+// Immutable snapshot of the inputs available to isolated prompt segments.  It
+// is built once on the main thread and only read by the worker threads.
+struct isolated_inputs
+{
+    str_moveable                cwd;
+    int                         errorlevel = 0;
+    std::vector<str_moveable>   env_names;
+    std::vector<str_moveable>   env_values;
+};
+
+//------------------------------------------------------------------------------
+static void get_isolated_inputs(isolated_inputs& inputs)
+{
+    os::get_current_dir(inputs.cwd);
+    inputs.errorlevel = os::get_errorlevel();
+
+    WCHAR* root = GetEnvironmentStringsW();
+    if (root == nullptr)
+        return;
+
+    WCHAR* strings = root;
+    while (*strings)
+    {
+        // Skip env vars that start with a '='. They're hidden ones.
+        if (*strings == '=')
+        {
+            strings += wcslen(strings) + 1;
+            continue;
+        }
+
+        WCHAR* eq = wcschr(strings, '=');
+        if (eq == nullptr)
+            break;
+
+        // Names are uppercased so scripts can index them predictably; the
+        // environment is case insensitive anyway.
+        *eq = '\0';
+        CharUpperBuffW(strings, DWORD(eq - strings));
+
+        ++eq;
+        inputs.env_names.emplace_back(strings);
+        inputs.env_values.emplace_back(eq);
+
+        strings = eq + wcslen(eq) + 1;
+    }
+
+    FreeEnvironmentStringsW(root);
+}
+
+
+
+//------------------------------------------------------------------------------
+// How long the prompt waits for isolated segments before it uses their cached
+// text instead.
+static const unsigned int c_default_timeout_ms = 1000;
+
+// How many VM instructions a worker state runs between checks for whether its
+// task has been cancelled or has passed its deadline.
+static const int c_hook_count = 1000;
+
+//------------------------------------------------------------------------------
+// The worker side of an isolated segment:  its own Lua state plus the results
+// of the most recent run.  It is shared between the userdata and the task that
+// runs it, so that a task which outlives its deadline (or the main Lua state)
+// can finish safely in the background.
+struct isolated_worker
+{
+                        ~isolated_worker();
+    void                run(task& t, const isolated_inputs& inputs);
+
+    std::vector<char>   chunk;
+    str_moveable        name;
+
+    // Published by the worker thread, read by the main thread.
+    std::mutex          mutex;
+    str_moveable        result;
+    str_moveable        error;
+    bool                has_result = false;
+    bool                failed = false;
+
+private:
+    bool                ensure_state(str_base& error);
+    void                push_inputs(const isolated_inputs& inputs);
+    static void         hook(lua_State* state, lua_Debug* ar);
+
+    // Only used on the worker thread.
+    lua_State*          m_state = nullptr;
+    int                 m_func_ref = LUA_NOREF;
+    task*               m_task = nullptr;
+};
+
+//------------------------------------------------------------------------------
+static const char* const c_worker_key = "clink_isolated_worker";
+
+//------------------------------------------------------------------------------
+isolated_worker::~isolated_worker()
+{
+    if (m_state)
+        lua_close(m_state);
+}
+
+//------------------------------------------------------------------------------
+// The worker state is created on first use, on the worker thread.  It persists
+// so that a segment can cache things in its globals between prompts.
+bool isolated_worker::ensure_state(str_base& error)
+{
+    if (m_state)
+        return true;
+
+    m_state = luaL_newstate();
+    if (!m_state)
+    {
+        error = "unable to create Lua state";
+        return false;
+    }
+
+    luaL_openlibs(m_state);
+
+    if (luaL_loadbuffer(m_state, chunk.data(), chunk.size(), name.c_str()) != LUA_OK)
+    {
+        error = lua_tostring(m_state, -1);
+        lua_close(m_state);
+        m_state = nullptr;
+        return false;
+    }
+
+    // luaL_loadbuffer only sets the first upvalue to the globals table, but
+    // the function may not reference any globals at all.
+    for (int n = 1;; ++n)
+    {
+        const char* upvalue = lua_getupvalue(m_state, -1, n);
+        if (!upvalue)
+            break;
+        lua_pop(m_state, 1);
+        if (strcmp(upvalue, "_ENV") == 0)
+        {
+            lua_pushglobaltable(m_state);
+            lua_setupvalue(m_state, -2, n);
+        }
+    }
+
+    m_func_ref = luaL_ref(m_state, LUA_REGISTRYINDEX);
+
+    // The hook lets a runaway segment be stopped once its task is cancelled
+    // or passes its deadline.
+    lua_pushlightuserdata(m_state, this);
+    lua_setfield(m_state, LUA_REGISTRYINDEX, c_worker_key);
+    lua_sethook(m_state, hook, LUA_MASKCOUNT, c_hook_count);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void isolated_worker::hook(lua_State* state, lua_Debug* ar)
+{
+    lua_getfield(state, LUA_REGISTRYINDEX, c_worker_key);
+    const isolated_worker* worker = (const isolated_worker*)lua_touserdata(state, -1);
+    lua_pop(state, 1);
+
+    if (worker && worker->m_task && worker->m_task->is_cancelled())
+        luaL_error(state, "isolated prompt segment timed out");
+}
+
+//------------------------------------------------------------------------------
+void isolated_worker::push_inputs(const isolated_inputs& inputs)
+{
+    lua_createtable(m_state, 0, 3);
+
+    lua_pushliteral(m_state, "cwd");
+    lua_pushlstring(m_state, inputs.cwd.c_str(), inputs.cwd.length());
+    lua_rawset(m_state, -3);
+
+    lua_pushliteral(m_state, "errorlevel");
+    lua_pushinteger(m_state, inputs.errorlevel);
+    lua_rawset(m_state, -3);
+
+    lua_pushliteral(m_state, "env");
+    lua_createtable(m_state, 0, int(inputs.env_names.size()));
+    for (size_t i = 0; i < inputs.env_names.size(); ++i)
+    {
+        lua_pushlstring(m_state, inputs.env_names[i].c_str(), inputs.env_names[i].length());
+        lua_pushlstring(m_state, inputs.env_values[i].c_str(), inputs.env_values[i].length());
+        lua_rawset(m_state, -3);
+    }
+    lua_rawset(m_state, -3);
+}
+
+//------------------------------------------------------------------------------
+// Runs on a worker thread; must not touch the main Lua state.
+void isolated_worker::run(task& t, const isolated_inputs& inputs)
+{
+    str_moveable out;
+    str_moveable err;
+    bool ok = false;
+    bool has_out = false;
+
+    if (ensure_state(err))
+    {
+        m_task = &t;
+        lua_rawgeti(m_state, LUA_REGISTRYINDEX, m_func_ref);
+        push_inputs(inputs);
+
+        if (lua_pcall(m_state, 1, 1, 0) != LUA_OK)
+        {
+            const char* error = lua_tostring(m_state, -1);
+            err = error ? error : "(error object is not a string)";
+        }
+        else if (lua_isstring(m_state, -1))
+        {
+            size_t len;
+            const char* s = lua_tolstring(m_state, -1, &len);
+            out.concat(s, int(len));
+            has_out = true;
+            ok = true;
+        }
+        else if (lua_isnil(m_state, -1))
+        {
+            ok = true;
+        }
+        else
+        {
+            err.format("isolated prompt segment returned %s instead of a string",
+                       luaL_typename(m_state, -1));
+        }
+
+        lua_settop(m_state, 0);
+        m_task = nullptr;
+    }
+
+    // A segment stopped by its deadline keeps its previous results, which
+    // the prompt falls back to.
+    if (!ok && t.is_cancelled())
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    result = std::move(out);
+    error = std::move(err);
+    has_result = has_out;
+    failed = !ok;
+}
+
+
+
+//------------------------------------------------------------------------------
+// A prompt segment function that runs in its own Lua state on a worker thread.
+// The function is transferred as precompiled bytecode, so it cannot share any
+// upvalues with the main Lua state.  Its worker state only has the standard
+// Lua libraries, since the Clink APIs are not thread safe.
+#define LUA_ISOLATEDSEGMENT "clink_isolated_segment"
+struct luaL_IsolatedSegment
+{
+    static luaL_IsolatedSegment* make_new(lua_State* state);
+    static luaL_IsolatedSegment* check(lua_State* state, int index);
+
+    bool init(lua_State* state, int index);
+    bool is_busy() const { return m_task && !m_task->is_done(); }
+    void submit(const std::shared_ptr<const isolated_inputs>& inputs, unsigned int timeout_ms);
+    bool wait(std::chrono::steady_clock::time_point deadline);
+
+private:
+    static int write_chunk(lua_State* state, const void* p, size_t size, void* ud);
+    static int get(lua_State* state);
+    static int __gc(lua_State* state);
+    static int __tostring(lua_State* state);
+
+    std::shared_ptr<isolated_worker> m_worker;
+    std::shared_ptr<task> m_task;
+    bool                m_timed_out = false;
+};
+
+//------------------------------------------------------------------------------
+luaL_IsolatedSegment* luaL_IsolatedSegment::make_new(lua_State* state)
+{
+#ifdef DEBUG
+    int oldtop = lua_gettop(state);
+#endif
+
+    luaL_IsolatedSegment* seg = (luaL_IsolatedSegment*)lua_newuserdata(state, sizeof(luaL_IsolatedSegment));
+    new (seg) luaL_IsolatedSegment();
+
+    static const luaL_Reg seglib[] =
+    {
+        {"get", get},
+        {"__gc", __gc},
+        {"__tostring", __tostring},
+        {nullptr, nullptr}
+    };
+
+    if (luaL_newmetatable(state, LUA_ISOLATEDSEGMENT))
+    {
+        lua_pushvalue(state, -1);           // push metatable
+        lua_setfield(state, -2, "__index"); // metatable.__index = metatable
+        luaL_setfuncs(state, seglib, 0);    // add methods to new metatable
+    }
+    lua_setmetatable(state, -2);
+
+#ifdef DEBUG
+    int newtop = lua_gettop(state);
+    assert(oldtop - newtop == -1);
+    luaL_IsolatedSegment* test = (luaL_IsolatedSegment*)luaL_checkudata(state, -1, LUA_ISOLATEDSEGMENT);
+    assert(test == seg);
+#endif
+
+    return seg;
+}
+
+//------------------------------------------------------------------------------
+luaL_IsolatedSegment* luaL_IsolatedSegment::check(lua_State* state, int index)
+{
+    return (luaL_IsolatedSegment*)luaL_checkudata(state, index, LUA_ISOLATEDSEGMENT);
+}
+
+//------------------------------------------------------------------------------
+int luaL_IsolatedSegment::write_chunk(lua_State* state, const void* p, size_t size, void* ud)
+{
+    std::vector<char>* chunk = (std::vector<char>*)ud;
+    chunk->insert(chunk->end(), (const char*)p, (const char*)p + size);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Expects a Lua function at index; on failure pushes an error message and
+// returns false.
+bool luaL_IsolatedSegment::init(lua_State* state, int index)
+{
+    if (!lua_isfunction(state, index) || lua_iscfunction(state, index))
+    {
+        lua_pushliteral(state, "isolated prompt segment must be a Lua function");
+        return false;
+    }
+
+    // Only the _ENV upvalue can be re-established in the worker state.
+    for (int n = 1;; ++n)
+    {
+        const char* upvalue = lua_getupvalue(state, index, n);
+        if (!upvalue)
+            break;
+        lua_pop(state, 1);
+        if (strcmp(upvalue, "_ENV") != 0)
+        {
+            lua_pushfstring(state, "isolated prompt segment cannot use upvalue '%s'", upvalue);
+            return false;
+        }
+    }
+
+    m_worker = std::make_shared<isolated_worker>();
+
+    lua_Debug ar = {};
+    lua_pushvalue(state, index);
+    lua_getinfo(state, ">S", &ar);
+    m_worker->name.format("%s:%d", ar.short_src, ar.linedefined);
+
+    lua_pushvalue(state, index);
+    lua_dump(state, write_chunk, &m_worker->chunk);
+    lua_pop(state, 1);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void luaL_IsolatedSegment::submit(const std::shared_ptr<const isolated_inputs>& inputs, unsigned int timeout_ms)
+{
+    // The task holds its own references, so it can safely finish after the
+    // prompt has stopped waiting for it.
+    std::shared_ptr<isolated_worker> worker = m_worker;
+    m_task = task_scheduler::get().submit(task_priority::interactive, [worker, inputs] (task& t) {
+        worker->run(t, *inputs);
+    }, timeout_ms);
+}
+
+//------------------------------------------------------------------------------
+// Returns whether the segment finished before the deadline.  If not, its task
+// is cancelled and the segment reports its cached results.
+bool luaL_IsolatedSegment::wait(std::chrono::steady_clock::time_point deadline)
+{
+    m_timed_out = false;
+    if (!m_task)
+        return true;
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto remaining = (deadline > now) ? std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count() : 0;
+    if (m_task->wait(static_cast<unsigned int>(remaining)))
+        return true;
+
+    m_task->cancel();
+    m_timed_out = true;
+    return false;
+}
+
+//------------------------------------------------------------------------------
+int luaL_IsolatedSegment::get(lua_State* state)
+{
+    luaL_IsolatedSegment* seg = check(state, 1);
+    if (!seg->m_worker)
+        return 0;
+
+    isolated_worker& worker = *seg->m_worker;
+    std::lock_guard<std::mutex> lock(worker.mutex);
+
+    if (seg->m_timed_out)
+    {
+        // Fall back to the text from the last run that finished.
+        if (!worker.failed && worker.has_result)
+            lua_pushlstring(state, worker.result.c_str(), worker.result.length());
+        else
+            lua_pushnil(state);
+        lua_pushliteral(state, "isolated prompt segment timed out");
+        return 2;
+    }
+
+    if (worker.failed)
+    {
+        lua_pushnil(state);
+        lua_pushlstring(state, worker.error.c_str(), worker.error.length());
+        return 2;
+    }
+
+    if (!worker.has_result)
+        return 0;
+
+    lua_pushlstring(state, worker.result.c_str(), worker.result.length());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int luaL_IsolatedSegment::__gc(lua_State* state)
+{
+    luaL_IsolatedSegment* seg = check(state, 1);
+
+    // Don't wait for a running task; it releases the worker when it returns.
+    if (seg->m_task)
+        seg->m_task->cancel();
+
+    seg->~luaL_IsolatedSegment();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_IsolatedSegment::__tostring(lua_State* state)
+{
+    luaL_IsolatedSegment* seg = check(state, 1);
+    lua_pushfstring(state, "isolatedsegment (%s)", seg->m_worker ? seg->m_worker->name.c_str() : "");
+    return 1;
+}
+
+
+
+//------------------------------------------------------------------------------
+/// -name:  clink._newisolatedsegment
+/// -arg:   func:function
+/// -ret:   userdata
+/// UNDOCUMENTED; internal use only.
+static int new_isolated_segment(lua_State* state)
+{
+    luaL_checktype(state, 1, LUA_TFUNCTION);
+
+    luaL_IsolatedSegment* seg = luaL_IsolatedSegment::make_new(state);
+    if (!seg->init(state, 1))
+        return lua_error(state);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  clink._runisolatedsegments
+/// -arg:   segments:table
+/// -arg:   [timeout:integer]
+/// UNDOCUMENTED; internal use only.
+/// Runs the segments in parallel on the task scheduler's workers against the
+/// same snapshot of prompt inputs, and returns when all of them have finished
+/// or the timeout (in milliseconds) has elapsed.  Segments that haven't
+/// finished by then are cancelled, and their :get() returns the text from
+/// their last finished run plus a "timed out" error.
+static int run_isolated_segments(lua_State* state)
+{
+    luaL_checktype(state, 1, LUA_TTABLE);
+    const unsigned int timeout_ms = static_cast<unsigned int>(luaL_optinteger(state, 2, c_default_timeout_ms));
+
+    std::vector<luaL_IsolatedSegment*> segments;
+    for (int i = 1;; ++i)
+    {
+        lua_rawgeti(state, 1, i);
+        if (lua_isnil(state, -1))
+        {
+            lua_pop(state, 1);
+            break;
+        }
+        segments.push_back(luaL_IsolatedSegment::check(state, -1));
+        lua_pop(state, 1);
+    }
+
+    if (segments.empty())
+        return 0;
+
+    auto inputs = std::make_shared<isolated_inputs>();
+    get_isolated_inputs(*inputs);
+
+    // A segment still running from an earlier prompt (despite being
+    // cancelled, e.g. blocked in a C function) isn't started again; it just
+    // times out again.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    for (auto* seg : segments)
+    {
+        if (!seg->is_busy())
+            seg->submit(inputs, timeout_ms);
+    }
+
+    for (auto* seg : segments)
+        seg->wait(deadline);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+void isolated_segment_lua_initialise(lua_state& lua)
+{
+    struct {
+        const char* name;
+        int         (*method)(lua_State*);
+    } methods[] = {
+        { "_newisolatedsegment",        &new_isolated_segment },
+        { "_runisolatedsegments",       &run_isolated_segments },
+    };
+
+    lua_State* state = lua.get_state();
+
+    lua_getglobal(state, "clink");
+
+    for (const auto& method : methods)
+    {
+        lua_pushstring(state, method.name);
+        lua_pushcfunction(state, method.method);
+        lua_rawset(state, -3);
+    }
+
+    lua_pop(state, 1);
+}
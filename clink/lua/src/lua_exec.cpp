@@ -21,6 +21,7 @@
 
 #include "pch.h"
 #include "core/str.h"
+#include "core/task_scheduler.h"
 
 // Lua includes.
 extern "C" {
@@ -137,15 +138,12 @@ static HANDLE create_job()
 }
 
 //------------------------------------------------------------------------------
-static DWORD WINAPI thread_proc(exec_state_t* state)
+// Runs as a blocking task.  Closing the job kills the process if it's still
+// running when the timeout expires, which ends the read loop.
+static void watch_process(exec_state_t* state)
 {
-    HANDLE process = state->pi.hProcess;
-    HANDLE job = state->job;
-    DWORD wait_result = WaitForSingleObject(process, state->timeout);
-
-    CloseHandle(process);
-    CloseHandle(job);
-    return 0;
+    WaitForSingleObject(state->pi.hProcess, state->timeout);
+    CloseHandle(state->job);
 }
 
 //------------------------------------------------------------------------------
@@ -185,7 +183,7 @@ int lua_execute(lua_State* state)
     pipe_t pipe_stdin;
     exec_state_t exec_state;
     DWORD proc_ret;
-    HANDLE thread;
+    std::shared_ptr<task> watcher;
 
     // Get the command line to execute.
     arg_count = lua_gettop(state);
@@ -250,9 +248,9 @@ int lua_execute(lua_State* state)
     }
 
     AssignProcessToJobObject(exec_state.job, exec_state.pi.hProcess);
-    thread = CreateThread(nullptr, 0, (LPTHREAD_START_ROUTINE)thread_proc,
-        &exec_state, 0, nullptr
-    );
+    watcher = task_scheduler::get().submit(task_priority::blocking, [&exec_state] (task&) {
+        watch_process(&exec_state);
+    });
 
     // Release our references to the child-side pipes. We don't use them, and
     // it means ReadFile() will leave the loop below once the child closes
@@ -334,15 +332,17 @@ int lua_execute(lua_State* state)
         VirtualFree(buffer, 0, MEM_RELEASE);
     }
 
+    // The watcher uses exec_state, so wait for it before leaving.  Once it's
+    // done the process has exited or been killed.
+    watcher->wait();
+
     proc_ret = -1;
     GetExitCodeProcess(exec_state.pi.hProcess, &proc_ret);
     lua_pushinteger(state, proc_ret);
 
+    CloseHandle(exec_state.pi.hProcess);
     CloseHandle(exec_state.pi.hThread);
 
-    WaitForSingleObject(thread, INFINITE);
-    CloseHandle(thread);
-
     destroy_pipe(&pipe_stdout);
     destroy_pipe(&pipe_stderr);
     destroy_pipe(&pipe_stdin);
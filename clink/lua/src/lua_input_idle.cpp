@@ -15,35 +15,17 @@ extern "C" {
 #include <lualib.h>
 }
 
-//------------------------------------------------------------------------------
-extern void set_io_wake_event(HANDLE event);
-
 //------------------------------------------------------------------------------
 lua_input_idle::lua_input_idle(lua_state& state)
 : m_state(state)
 {
 }
 
-//------------------------------------------------------------------------------
-lua_input_idle::~lua_input_idle()
-{
-    set_io_wake_event(nullptr);
-}
-
 //------------------------------------------------------------------------------
 void lua_input_idle::reset()
 {
-    HANDLE old_event = m_event;
-
-    // Create new event before closing old handle, to prevent the OS from
-    // reusing the same event handle after it's closed.
     m_enabled = true;
     m_iterations = 0;
-    m_event = CreateEvent(nullptr, false, false, nullptr);
-    set_io_wake_event(m_event);
-
-    if (old_event)
-        CloseHandle(old_event);
 }
 
 //------------------------------------------------------------------------------
@@ -88,12 +70,11 @@ unsigned lua_input_idle::get_timeout()
 }
 
 //------------------------------------------------------------------------------
+// io.popenyield collects output on the task scheduler, whose completion event
+// the input loop already waits on, so there's no separate event here.
 void* lua_input_idle::get_waitevent()
 {
-    if (!m_enabled)
-        return nullptr;
-
-    return m_event;
+    return nullptr;
 }
 
 //------------------------------------------------------------------------------
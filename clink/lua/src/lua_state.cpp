@@ -75,6 +75,8 @@ setting_bool g_lua_strict(
 
 //------------------------------------------------------------------------------
 void clink_lua_initialise(lua_state&);
+void isolated_segment_lua_initialise(lua_state&);
+void pattern_lua_initialise(lua_state&);
 void os_lua_initialise(lua_state&);
 void io_lua_initialise(lua_state&);
 void console_lua_initialise(lua_state&);
@@ -83,6 +85,7 @@ void rl_lua_initialise(lua_state&);
 void settings_lua_initialise(lua_state&);
 void string_lua_initialise(lua_state&);
 void log_lua_initialise(lua_state&);
+int settings_lua_refresh(lua_State*);
 
 
 
@@ -221,6 +224,8 @@ void lua_state::initialise()
 
     // Initialize API namespaces.
     clink_lua_initialise(self);
+    isolated_segment_lua_initialise(self);
+    pattern_lua_initialise(self);
     os_lua_initialise(self);
     io_lua_initialise(self);
     console_lua_initialise(self);
@@ -579,6 +584,29 @@ bool lua_state::call_lua_rl_global_function(const char* func_name, line_state* l
     return true;
 }
 
+//------------------------------------------------------------------------------
+// Refreshes the values in setting handles, and sends the onsettingchanged event
+// for each setting whose value changed.
+void lua_state::refresh_settings()
+{
+    save_stack_top ss(m_state);
+
+    const int count = settings_lua_refresh(m_state);
+    if (!count)
+        return;
+
+    const int changes = lua_gettop(m_state);
+    for (int i = 1; i <= count; ++i)
+    {
+        lua_rawgeti(m_state, changes, i);
+        lua_rawgeti(m_state, -1, 1);
+        lua_rawgeti(m_state, -2, 2);
+        lua_rawgeti(m_state, -3, 3);
+        lua_remove(m_state, -4);
+        send_event("onsettingchanged", 3);
+    }
+}
+
 //------------------------------------------------------------------------------
 void lua_state::print_error(const char* error)
 {
@@ -16,6 +16,10 @@ static match_builder_lua::method g_methods[] = {
     { "setappendcharacter", &match_builder_lua::set_append_character },
     { "setsuppressappend",  &match_builder_lua::set_suppress_append },
     { "setsuppressquoting", &match_builder_lua::set_suppress_quoting },
+    { "setsorted",          &match_builder_lua::set_sorted },
+    { "setunique",          &match_builder_lua::set_unique },
+    // UNDOCUMENTED; internal use only.
+    { "_beginrun",          &match_builder_lua::begin_run },
     // Only for backward compatibility:
     { "deprecated_addmatch", &match_builder_lua::deprecated_add_match },
     { "setmatchesarefiles", &match_builder_lua::set_matches_are_files },
@@ -183,6 +187,53 @@ int match_builder_lua::set_suppress_quoting(lua_State* state)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  builder:setsorted
+/// -ver:   1.3.1
+/// -arg:   [state:boolean]
+/// Declares that the matches this generator adds are already sorted.  When
+/// every generator's matches are sorted, Clink merges them instead of sorting
+/// all of them again.  Clink checks the order before relying on it, so
+/// declaring it incorrectly only costs a little time.
+int match_builder_lua::set_sorted(lua_State* state)
+{
+    bool sorted = true;
+    if (lua_gettop(state) > 0)
+        sorted = (lua_toboolean(state, 1) != 0);
+
+    m_builder.set_sorted(sorted);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  builder:setunique
+/// -ver:   1.3.1
+/// -arg:   [state:boolean]
+/// Declares that the matches this generator adds contain no duplicates.  When
+/// no other generator adds matches first, Clink can then skip checking each
+/// match for duplicates.  Unlike <a href="#builder:setsorted">builder:setsorted()</a>
+/// this is not verified, so only use it when duplicates are impossible.
+int match_builder_lua::set_unique(lua_State* state)
+{
+    bool unique = true;
+    if (lua_gettop(state) > 0)
+        unique = (lua_toboolean(state, 1) != 0);
+
+    m_builder.set_unique(unique);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// UNDOCUMENTED; internal use only.  Each Lua generator's matches are a separate
+// run, so that sorted/unique declarations apply only to that generator.
+int match_builder_lua::begin_run(lua_State* state)
+{
+    m_builder.begin_run();
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 // Undocumented because it exists only to enable the clink.add_match backward
 // compatibility.
@@ -21,6 +21,9 @@ public:
     int             set_append_character(lua_State* state);
     int             set_suppress_append(lua_State* state);
     int             set_suppress_quoting(lua_State* state);
+    int             set_sorted(lua_State* state);
+    int             set_unique(lua_State* state);
+    int             begin_run(lua_State* state);
 
     int             deprecated_add_match(lua_State* state);
     int             set_matches_are_files(lua_State* state);
@@ -5,6 +5,7 @@
 #include "lua_state.h"
 #include "matches_lua.h"
 
+#include <core/str_compare.h>
 #include <lib/matches.h>
 
 //------------------------------------------------------------------------------
@@ -13,11 +14,73 @@ static matches_lua::method g_methods[] = {
     { "getcount",               &matches_lua::get_count },
     { "getmatch",               &matches_lua::get_match },
     { "gettype",                &matches_lua::get_type },
+    { "getmatches",             &matches_lua::get_matches },
+    { "gettypes",               &matches_lua::get_types },
+    { "find",                   &matches_lua::find },
+    { "filter",                 &matches_lua::filter },
     {}
 };
 
 
 
+//------------------------------------------------------------------------------
+// Match type strings are formatted once per Lua state and kept in a registry
+// table keyed by the match_type value, so that repeated queries only push an
+// existing (already interned) Lua string.
+static int push_type_cache(lua_State* state)
+{
+    lua_getfield(state, LUA_REGISTRYINDEX, "clink_match_types");
+    if (lua_isnil(state, -1))
+    {
+        lua_pop(state, 1);
+        lua_createtable(state, 0, 8);
+        lua_pushvalue(state, -1);
+        lua_setfield(state, LUA_REGISTRYINDEX, "clink_match_types");
+    }
+    return lua_gettop(state);
+}
+
+//------------------------------------------------------------------------------
+static void push_match_type(lua_State* state, int cache, match_type type)
+{
+    lua_rawgeti(state, cache, int(type));
+    if (!lua_isnil(state, -1))
+        return;
+
+    lua_pop(state, 1);
+
+    str<> tmp;
+    match_type_to_string(type, tmp);
+    lua_pushlstring(state, tmp.c_str(), tmp.length());
+    lua_pushvalue(state, -1);
+    lua_rawseti(state, cache, int(type));
+}
+
+//------------------------------------------------------------------------------
+// Reads optional from/to arguments as a 0-based half open range, clamped to
+// the number of matches.
+static bool get_range(lua_State* state, int arg, unsigned int count, unsigned int& from, unsigned int& to)
+{
+    bool isnum;
+    int first = optinteger(state, arg, 1, &isnum);
+    if (!isnum)
+        return false;
+    int last = optinteger(state, arg + 1, count, &isnum);
+    if (!isnum)
+        return false;
+
+    if (first < 1)
+        first = 1;
+    if (last > int(count))
+        last = count;
+
+    from = first - 1;
+    to = (last >= first) ? last : from;
+    return true;
+}
+
+
+
 //------------------------------------------------------------------------------
 matches_lua::matches_lua(const matches& matches)
 : lua_bindable("matches", g_methods)
@@ -89,8 +152,141 @@ int matches_lua::get_type(lua_State* state)
     if (index >= m_matches.get_match_count())
         return 0;
 
-    str<> type;
-    match_type_to_string(m_matches.get_match_type(index), type);
-    lua_pushlstring(state, type.c_str(), type.length());
+    int cache = push_type_cache(state);
+    push_match_type(state, cache, m_matches.get_match_type(index));
+    lua_remove(state, cache);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:getmatches
+/// -ver:   1.3.1
+/// -arg:   [from:integer]
+/// -arg:   [to:integer]
+/// -ret:   table
+/// Returns a table containing the match text for the matches from index
+/// <span class="arg">from</span> through <span class="arg">to</span>
+/// (inclusive).  If omitted, they default to the first and last match.  This
+/// is much faster than calling <code>matches:getmatch()</code> in a loop.
+/// -show:  local m = matches:getmatches()
+/// -show:  for i = 1, #m do
+/// -show:  &nbsp;   print(m[i])
+/// -show:  end
+int matches_lua::get_matches(lua_State* state)
+{
+    unsigned int from, to;
+    if (!get_range(state, 1, m_matches.get_match_count(), from, to))
+        return 0;
+
+    lua_createtable(state, to - from, 0);
+    for (unsigned int i = from; i < to; ++i)
+    {
+        lua_pushstring(state, m_matches.get_match(i));
+        lua_rawseti(state, -2, i - from + 1);
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:gettypes
+/// -ver:   1.3.1
+/// -arg:   [from:integer]
+/// -arg:   [to:integer]
+/// -ret:   table
+/// Returns a table containing the match types for the matches from index
+/// <span class="arg">from</span> through <span class="arg">to</span>
+/// (inclusive).  If omitted, they default to the first and last match.  The
+/// table lines up with the one returned by <code>matches:getmatches()</code>
+/// for the same range.
+int matches_lua::get_types(lua_State* state)
+{
+    unsigned int from, to;
+    if (!get_range(state, 1, m_matches.get_match_count(), from, to))
+        return 0;
+
+    int cache = push_type_cache(state);
+    lua_createtable(state, to - from, 0);
+    for (unsigned int i = from; i < to; ++i)
+    {
+        push_match_type(state, cache, m_matches.get_match_type(i));
+        lua_rawseti(state, -2, i - from + 1);
+    }
+    lua_remove(state, cache);
     return 1;
 }
+
+//------------------------------------------------------------------------------
+/// -name:  matches:find
+/// -ver:   1.3.1
+/// -arg:   prefix:string
+/// -arg:   [start:integer]
+/// -ret:   integer | nil
+/// Returns the index of the first match that begins with
+/// <span class="arg">prefix</span>, starting the search at index
+/// <span class="arg">start</span> (default is 1).  Returns nil if no match
+/// begins with <span class="arg">prefix</span>.  The comparison honors the
+/// <code>match.ignore_case</code> and related settings.
+int matches_lua::find(lua_State* state)
+{
+    const char* prefix = checkstring(state, 1);
+    if (!prefix)
+        return 0;
+
+    bool isnum;
+    int start = optinteger(state, 2, 1, &isnum) - 1;
+    if (!isnum)
+        return 0;
+    if (start < 0)
+        start = 0;
+
+    const int prefix_len = int(strlen(prefix));
+    const unsigned int count = m_matches.get_match_count();
+    for (unsigned int i = start; i < count; ++i)
+    {
+        int cmp = str_compare(prefix, m_matches.get_match(i));
+        if (cmp < 0 || cmp >= prefix_len)
+        {
+            lua_pushinteger(state, i + 1);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  matches:filter
+/// -ver:   1.3.1
+/// -arg:   pattern:string
+/// -ret:   table, table
+/// Returns two tables:  the match text and the match types for the matches
+/// that satisfy the wildcard <span class="arg">pattern</span>.  The pattern
+/// is applied the same way as when Clink filters matches for completion.
+/// -show:  local m, t = matches:filter("*.txt")
+/// -show:  for i = 1, #m do
+/// -show:  &nbsp;   print(m[i], t[i])
+/// -show:  end
+int matches_lua::filter(lua_State* state)
+{
+    const char* pattern = checkstring(state, 1);
+    if (!pattern)
+        return 0;
+
+    int cache = push_type_cache(state);
+    lua_createtable(state, 0, 0);
+    lua_createtable(state, 0, 0);
+
+    int n = 0;
+    matches_iter iter = m_matches.get_iter(pattern);
+    while (iter.next())
+    {
+        ++n;
+        lua_pushstring(state, iter.get_match());
+        lua_rawseti(state, -3, n);
+        push_match_type(state, cache, iter.get_match_type());
+        lua_rawseti(state, -2, n);
+    }
+
+    lua_remove(state, cache);
+    return 2;
+}
@@ -18,6 +18,10 @@ public:
     int                 get_count(lua_State* state);
     int                 get_match(lua_State* state);
     int                 get_type(lua_State* state);
+    int                 get_matches(lua_State* state);
+    int                 get_types(lua_State* state);
+    int                 find(lua_State* state);
+    int                 filter(lua_State* state);
 
 private:
     const matches&      m_matches;
@@ -11,6 +11,7 @@
 #include <core/settings.h>
 #include <core/str.h>
 #include <core/str_iter.h>
+#include <core/str_tokeniser.h>
 #include <process/process.h>
 #include <sys/utime.h>
 #include <ntverp.h> // for VER_PRODUCTMAJORVERSION to deduce SDK version
@@ -257,6 +258,128 @@ static void add_type_tag(str_base& out, const char* tag)
     out << tag;
 }
 
+//------------------------------------------------------------------------------
+enum glob_field
+{
+    glob_field_name     = 0x01,
+    glob_field_type     = 0x02,
+    glob_field_size     = 0x04,
+    glob_field_atime    = 0x08,
+    glob_field_mtime    = 0x10,
+    glob_field_ctime    = 0x20,
+    glob_field_basic    = glob_field_name|glob_field_type,
+    glob_field_all      = 0x3f,
+};
+
+//------------------------------------------------------------------------------
+static int extrainfo_to_fields(int extrainfo)
+{
+    if (extrainfo >= 2)
+        return glob_field_all;
+    if (extrainfo)
+        return glob_field_basic;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int parse_glob_fields(const char* fields)
+{
+    static const struct { const char* name; int field; } c_fields[] =
+    {
+        { "name",   glob_field_name },
+        { "type",   glob_field_type },
+        { "size",   glob_field_size },
+        { "atime",  glob_field_atime },
+        { "mtime",  glob_field_mtime },
+        { "ctime",  glob_field_ctime },
+    };
+
+    int result = 0;
+    str_tokeniser tokens(fields, ",; ");
+    const char* start;
+    int length;
+    while (tokens.next(start, length))
+    {
+        for (const auto& f : c_fields)
+            if (strlen(f.name) == length && _strnicmp(f.name, start, length) == 0)
+                result |= f.field;
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------------
+// Pushes a table with the requested fields for a globbed file.  The parent
+// buffer holds the glob's directory, and is used to check whether symlinks are
+// orphaned.
+static void push_glob_info(lua_State* state, const char* file, unsigned int file_len, const globber::extrainfo& info, int fields, str_base& parent)
+{
+    lua_createtable(state, 0, 2);
+
+    if (fields & glob_field_name)
+    {
+        lua_pushliteral(state, "name");
+        lua_pushlstring(state, file, file_len);
+        lua_rawset(state, -3);
+    }
+
+    if (fields & glob_field_type)
+    {
+        str<16> type;
+        add_type_tag(type, (info.attr & FILE_ATTRIBUTE_DIRECTORY) ? "dir" : "file");
+#ifdef S_ISLNK
+        if (S_ISLNK(info.st_mode))
+        {
+            unsigned int len = parent.length();
+            path::append(parent, file);
+
+            add_type_tag(type, "link");
+            wstr<288> wfile(parent.c_str());
+            struct _stat64 st;
+            if (_wstat64(wfile.c_str(), &st) < 0)
+                add_type_tag(type, "orphaned");
+
+            parent.truncate(len);
+        }
+#endif
+        if (info.attr & FILE_ATTRIBUTE_HIDDEN)
+            add_type_tag(type, "hidden");
+        if (info.attr & FILE_ATTRIBUTE_READONLY)
+            add_type_tag(type, "readonly");
+
+        lua_pushliteral(state, "type");
+        lua_pushlstring(state, type.c_str(), type.length());
+        lua_rawset(state, -3);
+    }
+
+    if (fields & glob_field_atime)
+    {
+        lua_pushliteral(state, "atime");
+        lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.accessed)));
+        lua_rawset(state, -3);
+    }
+
+    if (fields & glob_field_mtime)
+    {
+        lua_pushliteral(state, "mtime");
+        lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.modified)));
+        lua_rawset(state, -3);
+    }
+
+    if (fields & glob_field_ctime)
+    {
+        lua_pushliteral(state, "ctime");
+        lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.created)));
+        lua_rawset(state, -3);
+    }
+
+    if (fields & glob_field_size)
+    {
+        lua_pushliteral(state, "size");
+        lua_pushnumber(state, lua_Number(info.size));
+        lua_rawset(state, -3);
+    }
+}
+
 //------------------------------------------------------------------------------
 int glob_impl(lua_State* state, bool dirs_only, bool back_compat=false)
 {
@@ -286,68 +409,15 @@ int glob_impl(lua_State* state, bool dirs_only, bool back_compat=false)
 
     int i = 1;
     str<288> file;
-    str<16> type;
+    const int fields = extrainfo_to_fields(extrainfo);
     globber::extrainfo info;
     globber::extrainfo* info_ptr = extrainfo ? &info : nullptr;
     while (globber.next(file, false, info_ptr))
     {
         if (!extrainfo)
-        {
             lua_pushlstring(state, file.c_str(), file.length());
-        }
         else
-        {
-            lua_createtable(state, 0, 2);
-
-            lua_pushliteral(state, "name");
-            lua_pushlstring(state, file.c_str(), file.length());
-            lua_rawset(state, -3);
-
-            type.clear();
-            add_type_tag(type, (info.attr & FILE_ATTRIBUTE_DIRECTORY) ? "dir" : "file");
-#ifdef S_ISLNK
-            if (S_ISLNK(info.st_mode))
-            {
-                unsigned int len = tmp.length();
-                path::append(tmp, file.c_str());
-
-                add_type_tag(type, "link");
-                wstr<288> wfile(tmp.c_str());
-                struct _stat64 st;
-                if (_wstat64(wfile.c_str(), &st) < 0)
-                    add_type_tag(type, "orphaned");
-
-                tmp.truncate(len);
-            }
-#endif
-            if (info.attr & FILE_ATTRIBUTE_HIDDEN)
-                add_type_tag(type, "hidden");
-            if (info.attr & FILE_ATTRIBUTE_READONLY)
-                add_type_tag(type, "readonly");
-
-            lua_pushliteral(state, "type");
-            lua_pushlstring(state, type.c_str(), type.length());
-            lua_rawset(state, -3);
-
-            if (extrainfo >= 2)
-            {
-                lua_pushliteral(state, "atime");
-                lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.accessed)));
-                lua_rawset(state, -3);
-
-                lua_pushliteral(state, "mtime");
-                lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.modified)));
-                lua_rawset(state, -3);
-
-                lua_pushliteral(state, "ctime");
-                lua_pushnumber(state, lua_Number(os::filetime_to_time_t(info.created)));
-                lua_rawset(state, -3);
-
-                lua_pushliteral(state, "size");
-                lua_pushnumber(state, lua_Number(info.size));
-                lua_rawset(state, -3);
-            }
-        }
+            push_glob_info(state, file.c_str(), file.length(), info, fields, tmp);
 
         lua_rawseti(state, -2, i++);
     }
@@ -421,6 +491,184 @@ int glob_files(lua_State* state)
     return glob_impl(state, false);
 }
 
+//------------------------------------------------------------------------------
+#define LUA_GLOBITER "clink_glob_iter"
+struct luaL_GlobIter
+{
+    static luaL_GlobIter* make_new(lua_State* state);
+
+    void init(const char* mask, bool dirs_only, int fields);
+
+private:
+    static int __call(lua_State* state);
+    static int close(lua_State* state);
+    static int __gc(lua_State* state);
+    static int __tostring(lua_State* state);
+
+    std::unique_ptr<globber> m_globber;
+    str_moveable m_parent;
+    int m_fields = 0;
+};
+
+//------------------------------------------------------------------------------
+luaL_GlobIter* luaL_GlobIter::make_new(lua_State* state)
+{
+#ifdef DEBUG
+    int oldtop = lua_gettop(state);
+#endif
+
+    luaL_GlobIter* gi = (luaL_GlobIter*)lua_newuserdata(state, sizeof(luaL_GlobIter));
+    new (gi) luaL_GlobIter();
+
+    static const luaL_Reg gilib[] =
+    {
+        {"close", close},
+        {"__call", __call},
+        {"__gc", __gc},
+        {"__tostring", __tostring},
+        {nullptr, nullptr}
+    };
+
+    if (luaL_newmetatable(state, LUA_GLOBITER))
+    {
+        lua_pushvalue(state, -1);           // push metatable
+        lua_setfield(state, -2, "__index"); // metatable.__index = metatable
+        luaL_setfuncs(state, gilib, 0);     // add methods to new metatable
+    }
+    lua_setmetatable(state, -2);
+
+#ifdef DEBUG
+    int newtop = lua_gettop(state);
+    assert(oldtop - newtop == -1);
+    luaL_GlobIter* test = (luaL_GlobIter*)luaL_checkudata(state, -1, LUA_GLOBITER);
+    assert(test == gi);
+#endif
+
+    return gi;
+}
+
+//------------------------------------------------------------------------------
+void luaL_GlobIter::init(const char* mask, bool dirs_only, int fields)
+{
+    m_globber = std::make_unique<globber>(mask);
+    m_globber->files(!dirs_only);
+    m_globber->hidden(g_glob_hidden.get());
+    m_globber->system(g_glob_system.get());
+
+    m_parent = mask;
+    path::to_parent(m_parent, nullptr);
+
+    m_fields = fields;
+}
+
+//------------------------------------------------------------------------------
+int luaL_GlobIter::__call(lua_State* state)
+{
+    luaL_GlobIter* gi = (luaL_GlobIter*)luaL_checkudata(state, 1, LUA_GLOBITER);
+    if (!gi->m_globber)
+        return 0;
+
+    str<288> file;
+    globber::extrainfo info;
+    if (!gi->m_globber->next(file, false, gi->m_fields ? &info : nullptr))
+    {
+        // Release the find handle as soon as the iteration is exhausted,
+        // rather than waiting for garbage collection.
+        gi->m_globber.reset();
+        return 0;
+    }
+
+    lua_pushlstring(state, file.c_str(), file.length());
+    if (!gi->m_fields)
+        return 1;
+
+    push_glob_info(state, file.c_str(), file.length(), info, gi->m_fields, gi->m_parent);
+    return 2;
+}
+
+//------------------------------------------------------------------------------
+int luaL_GlobIter::close(lua_State* state)
+{
+    luaL_GlobIter* gi = (luaL_GlobIter*)luaL_checkudata(state, 1, LUA_GLOBITER);
+    gi->m_globber.reset();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_GlobIter::__gc(lua_State* state)
+{
+    luaL_GlobIter* gi = (luaL_GlobIter*)luaL_checkudata(state, 1, LUA_GLOBITER);
+    gi->~luaL_GlobIter();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_GlobIter::__tostring(lua_State* state)
+{
+    luaL_GlobIter* gi = (luaL_GlobIter*)luaL_checkudata(state, 1, LUA_GLOBITER);
+    lua_pushfstring(state, "globiter (%p)", gi->m_globber.get());
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  os.globiter
+/// -ver:   1.3.1
+/// -arg:   globpattern:string
+/// -arg:   [extrainfo:integer|boolean|string]
+/// -arg:   [dirsonly:boolean]
+/// -ret:   iterator
+/// Returns an iterator that yields files and/or directories matching
+/// <span class="arg">globpattern</span> one at a time, for use in a
+/// <code>for</code> loop.  Unlike <a href="#os.globfiles">os.globfiles()</a>
+/// it doesn't build a table of all the results up front, so a script that only
+/// needs the first few results (or filters them as it goes) doesn't pay for
+/// the rest.
+///
+/// Each iteration yields the file name, and (when
+/// <span class="arg">extrainfo</span> is given) a table with information about
+/// the file.  <span class="arg">extrainfo</span> works the same as in
+/// <a href="#os.globfiles">os.globfiles()</a>, but it can also be a string
+/// listing only the fields to include, separated by commas:  "name", "type",
+/// "size", "atime", "mtime", and "ctime".
+///
+/// When <span class="arg">dirsonly</span> is true, only directories are
+/// yielded, like <a href="#os.globdirs">os.globdirs()</a>.
+///
+/// The file system handle is released as soon as the iteration ends.  If a
+/// loop exits early, call <code>:close()</code> on the iterator to release the
+/// handle immediately instead of waiting for garbage collection.
+/// -show:  local iter = os.globiter("*.lua", "type,size")
+/// -show:  for name, info in iter do
+/// -show:  &nbsp;   if info.size > 100000 then
+/// -show:  &nbsp;       print(name, info.type)
+/// -show:  &nbsp;       break
+/// -show:  &nbsp;   end
+/// -show:  end
+/// -show:  iter:close()
+///
+/// Note: any quotation marks (<code>"</code>) in
+/// <span class="arg">globpattern</span> are stripped.
+int glob_iter(lua_State* state)
+{
+    const char* mask = checkstring(state, 1);
+    if (!mask)
+        return 0;
+
+    int fields;
+    if (lua_isboolean(state, 2))
+        fields = extrainfo_to_fields(lua_toboolean(state, 2));
+    else if (lua_type(state, 2) == LUA_TSTRING)
+        fields = parse_glob_fields(lua_tostring(state, 2));
+    else
+        fields = extrainfo_to_fields(optinteger(state, 2, 0));
+
+    const bool dirs_only = lua_toboolean(state, 3);
+
+    luaL_GlobIter* gi = luaL_GlobIter::make_new(state);
+    gi->init(mask, dirs_only, fields);
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 /// -name:  os.touch
 /// -ver:   1.2.31
@@ -666,20 +914,20 @@ int get_aliases(lua_State* state)
     if (buffer_size == 0)
         return 1;
 
-    // Don't use wstr<> because it only uses 15 bits to store the buffer size.
     buffer_size++;
-    std::unique_ptr<WCHAR[]> buffer = std::unique_ptr<WCHAR[]>(new WCHAR[buffer_size]);
-    if (!buffer)
+    wstr_moveable buffer;
+    if (!buffer.reserve(buffer_size, true))
         return 1;
 
-    ZeroMemory(buffer.get(), buffer_size * sizeof(WCHAR));    // Avoid race condition!
-    if (GetConsoleAliasesW(buffer.get(), buffer_size, shell_name) == 0)
+    WCHAR* data = buffer.data();
+    ZeroMemory(data, buffer_size * sizeof(WCHAR));    // Avoid race condition!
+    if (GetConsoleAliasesW(data, buffer_size, shell_name) == 0)
         return 1;
 
     // Parse the result into a lua table.
     str<> out;
-    WCHAR* alias = buffer.get();
-    for (int i = 1; int(alias - buffer.get()) < buffer_size; ++i)
+    WCHAR* alias = data;
+    for (int i = 1; int(alias - data) < buffer_size; ++i)
     {
         WCHAR* c = wcschr(alias, '=');
         if (c == nullptr)
@@ -1078,6 +1326,7 @@ void os_lua_initialise(lua_state& lua)
         { "copy",        &copy },
         { "globdirs",    &glob_dirs },
         { "globfiles",   &glob_files },
+        { "globiter",    &glob_iter },
         { "touch",       &touch },
         { "getenv",      &get_env },
         { "setenv",      &set_env },
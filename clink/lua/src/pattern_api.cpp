@@ -0,0 +1,883 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+#include "lua_state.h"
+
+#include <core/base.h>
+#include <core/match_wild.h>
+#include <core/str.h>
+#include <core/str_compare.h>
+#include <core/str_iter.h>
+#include <core/str_unordered_set.h>
+
+#include <vector>
+#include <assert.h>
+
+//------------------------------------------------------------------------------
+static bool match_class(int c, int cl)
+{
+    bool res;
+    switch (tolower(cl))
+    {
+    case 'a':   res = !!isalpha(c); break;
+    case 'c':   res = !!iscntrl(c); break;
+    case 'd':   res = !!isdigit(c); break;
+    case 'g':   res = !!isgraph(c); break;
+    case 'l':   res = !!islower(c); break;
+    case 'p':   res = !!ispunct(c); break;
+    case 's':   res = !!isspace(c); break;
+    case 'u':   res = !!isupper(c); break;
+    case 'w':   res = !!isalnum(c); break;
+    case 'x':   res = !!isxdigit(c); break;
+    case 'z':   res = (c == 0); break;
+    default:    return (cl == c);
+    }
+    return islower(cl) ? res : !res;
+}
+
+//------------------------------------------------------------------------------
+static bool has_specials(const char* p, size_t len)
+{
+    for (const char* end = p + len; p < end; ++p)
+        if (*p && strchr("^$*+?.([%-", *p))
+            return true;
+    return false;
+}
+
+//------------------------------------------------------------------------------
+static const char* find_plain(const char* s, size_t len, const char* find, size_t find_len)
+{
+    if (!find_len)
+        return s;
+
+    while (len >= find_len)
+    {
+        const char* first = (const char*)memchr(s, *find, len - find_len + 1);
+        if (!first)
+            break;
+        if (memcmp(first + 1, find + 1, find_len - 1) == 0)
+            return first;
+        len -= (first + 1) - s;
+        s = first + 1;
+    }
+
+    return nullptr;
+}
+
+
+
+//------------------------------------------------------------------------------
+// A character class resolved to a 256 bit set, so testing a character costs
+// one lookup instead of re-parsing the class (e.g. "[%w_.-]") every time.
+struct char_set
+{
+    void                add(unsigned char c) { m_bits[c >> 5] |= 1u << (c & 31); }
+    void                add_range(unsigned char first, unsigned char last);
+    void                add_class(int cl);
+    void                invert();
+    bool                test(unsigned char c) const { return !!(m_bits[c >> 5] & (1u << (c & 31))); }
+
+    unsigned int        m_bits[8] = {};
+};
+
+//------------------------------------------------------------------------------
+void char_set::add_range(unsigned char first, unsigned char last)
+{
+    for (unsigned int c = first; c <= last; ++c)
+        add(c);
+}
+
+//------------------------------------------------------------------------------
+void char_set::add_class(int cl)
+{
+    for (unsigned int c = 0; c < 256; ++c)
+        if (match_class(c, cl))
+            add(c);
+}
+
+//------------------------------------------------------------------------------
+void char_set::invert()
+{
+    for (auto& bits : m_bits)
+        bits = ~bits;
+}
+
+
+
+//------------------------------------------------------------------------------
+// A Lua pattern checked once up front.  Matching uses lstrlib.c's matcher, so
+// results are the same as from string.find and string.match.  What compiling
+// adds is:
+//  - Malformed patterns are rejected when the pattern is created, instead of
+//    when a match happens to reach the bad part.
+//  - Patterns without special characters use a plain search.
+//  - When the first item must consume a char, its class becomes a set that
+//    rejects candidate start positions with a single lookup.
+class lua_pattern
+{
+public:
+    bool                compile(lua_State* state, const char* p, size_t len);
+    bool                exec(MatchState& ms, lua_State* state, const char* s, size_t len, size_t init, const char*& start, const char*& end) const;
+
+private:
+    const char*         parse_set(lua_State* state, const char* p, const char* end, char_set* set);
+
+    str_moveable        m_spec;
+    char_set            m_first;
+    bool                m_has_first = false;
+    bool                m_anchor = false;
+    bool                m_is_plain = false;
+};
+
+//------------------------------------------------------------------------------
+// Checks the single char class at p, and resolves it into set if set isn't
+// null.  Returns the end of the class, or nullptr after pushing an error
+// message.
+const char* lua_pattern::parse_set(lua_State* state, const char* p, const char* end, char_set* set)
+{
+    char_set dummy;
+    if (!set)
+        set = &dummy;
+
+    switch (*p)
+    {
+    case '.':
+        set->invert();
+        return p + 1;
+
+    case '%':
+        if (p + 1 >= end)
+        {
+            lua_pushliteral(state, "malformed pattern (ends with '%')");
+            return nullptr;
+        }
+        set->add_class((unsigned char)p[1]);
+        return p + 2;
+
+    case '[':
+        {
+            const char* q = p + 1;
+            const bool negate = (q < end && *q == '^');
+            if (negate)
+                ++q;
+
+            // Find the closing ']'; the first char never closes the set.
+            const char* const first = q;
+            do
+            {
+                if (q >= end)
+                {
+                    lua_pushliteral(state, "malformed pattern (missing ']')");
+                    return nullptr;
+                }
+                if (*(q++) == '%' && q < end)
+                    q++;
+            }
+            while (q >= end || *q != ']');
+
+            for (const char* c = first; c < q; ++c)
+            {
+                if (*c == '%')
+                    set->add_class((unsigned char)*(++c));
+                else if (c[1] == '-' && c + 2 < q)
+                {
+                    set->add_range((unsigned char)c[0], (unsigned char)c[2]);
+                    c += 2;
+                }
+                else
+                    set->add((unsigned char)*c);
+            }
+
+            if (negate)
+                set->invert();
+            return q + 1;
+        }
+
+    default:
+        set->add((unsigned char)*p);
+        return p + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Walks the pattern the same way lstrlib.c's match() does, reporting the
+// errors it would raise.  On failure pushes an error message and returns
+// false.
+bool lua_pattern::compile(lua_State* state, const char* p, size_t len)
+{
+    const char* const end = p + len;
+
+    m_is_plain = !has_specials(p, len);
+    if (!m_is_plain && p < end && *p == '^')
+    {
+        m_anchor = true;
+        ++p;
+    }
+    m_spec.concat(p, int(end - p));
+    if (m_is_plain)
+        return true;
+
+    std::vector<unsigned char> open;
+    int captures = 0;
+    bool first = true;
+    while (p < end)
+    {
+        switch (*p)
+        {
+        case '(':
+            if (captures >= LUA_MAXCAPTURES)
+            {
+                lua_pushliteral(state, "too many captures");
+                return false;
+            }
+            if (p + 1 < end && p[1] == ')')
+                p += 2;
+            else
+            {
+                open.push_back((unsigned char)captures);
+                ++p;
+            }
+            ++captures;
+            continue;
+
+        case ')':
+            if (open.empty())
+            {
+                lua_pushliteral(state, "invalid pattern capture");
+                return false;
+            }
+            open.pop_back();
+            ++p;
+            continue;
+
+        case '$':
+            if (p + 1 == end)
+            {
+                ++p;
+                continue;
+            }
+            break;
+
+        case '%':
+            if (p + 1 >= end)
+                break;
+            switch (p[1])
+            {
+            case 'b':
+                if (p + 3 >= end)
+                {
+                    lua_pushliteral(state, "malformed pattern (missing arguments to '%b')");
+                    return false;
+                }
+                p += 4;
+                first = false;
+                continue;
+
+            case 'f':
+                p += 2;
+                if (p >= end || *p != '[')
+                {
+                    lua_pushliteral(state, "missing '[' after '%f' in pattern");
+                    return false;
+                }
+                if (!(p = parse_set(state, p, end, nullptr)))
+                    return false;
+                first = false;
+                continue;
+
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                {
+                    // Which captures exist and are closed at this point is
+                    // fixed by the pattern, so back references can be checked
+                    // now.
+                    const int l = p[1] - '1';
+                    bool unfinished = false;
+                    for (unsigned char o : open)
+                        unfinished |= (o == l);
+                    if (l < 0 || l >= captures || unfinished)
+                    {
+                        lua_pushfstring(state, "invalid capture index %%%d", l + 1);
+                        return false;
+                    }
+                    p += 2;
+                    first = false;
+                    continue;
+                }
+            }
+            break;
+        }
+
+        // A single char class, with an optional quantifier.
+        char_set* set = first ? &m_first : nullptr;
+        if (!(p = parse_set(state, p, end, set)))
+            return false;
+        const char quant = (p < end && strchr("?*+-", *p)) ? *(p++) : 0;
+        if (first)
+            m_has_first = (!quant || quant == '+');
+        first = false;
+    }
+
+    if (!open.empty())
+    {
+        lua_pushliteral(state, "unfinished capture");
+        return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Searches s starting at byte offset init (which must be <= len).  Returns
+// true and sets start and end if found; ms then holds the captures.
+bool lua_pattern::exec(MatchState& ms, lua_State* state, const char* s, size_t len, size_t init, const char*& start, const char*& end) const
+{
+    ms.L = state;
+    ms.src_init = s;
+    ms.src_end = s + len;
+    ms.p_end = m_spec.c_str() + m_spec.length();
+    ms.level = 0;
+
+    if (m_is_plain)
+    {
+        start = find_plain(s + init, len - init, m_spec.c_str(), m_spec.length());
+        end = start ? start + m_spec.length() : nullptr;
+        return !!start;
+    }
+
+    const char* s1 = s + init;
+    do
+    {
+        if (m_has_first && (s1 >= ms.src_end || !m_first.test(*s1)))
+            continue;
+
+        ms.level = 0;
+        const char* res = luaL_strmatch(&ms, s1, m_spec.c_str());
+        if (res)
+        {
+            start = s1;
+            end = res;
+            return true;
+        }
+    }
+    while (s1++ < ms.src_end && !m_anchor);
+
+    return false;
+}
+
+
+
+//------------------------------------------------------------------------------
+enum class pattern_kind : char { lua = 'p', wild = 'w', literal = 'l' };
+
+//------------------------------------------------------------------------------
+#define LUA_PATTERN "clink_pattern"
+struct luaL_Pattern
+{
+    static luaL_Pattern* make_new(lua_State* state, pattern_kind kind);
+    static luaL_Pattern* check(lua_State* state, int index);
+
+    bool init(lua_State* state, int index);
+
+private:
+    bool test(lua_State* state, const char* s, size_t len) const;
+    bool find_at(lua_State* state, const char* s, size_t len, size_t init, int& pushed) const;
+
+    static int match(lua_State* state);
+    static int find(lua_State* state);
+    static int filter(lua_State* state);
+    static int __gc(lua_State* state);
+    static int __tostring(lua_State* state);
+
+    const pattern_kind  m_kind;
+    str_moveable        m_spec;
+    lua_pattern         m_pattern;
+    std::vector<str_moveable> m_literals;
+    str_unordered_set   m_literal_set;
+    char_set            m_literal_first;
+    bool                m_literal_empty = false;
+
+    luaL_Pattern(pattern_kind kind) : m_kind(kind) {}
+};
+
+//------------------------------------------------------------------------------
+luaL_Pattern* luaL_Pattern::make_new(lua_State* state, pattern_kind kind)
+{
+#ifdef DEBUG
+    int oldtop = lua_gettop(state);
+#endif
+
+    luaL_Pattern* pat = (luaL_Pattern*)lua_newuserdata(state, sizeof(luaL_Pattern));
+    new (pat) luaL_Pattern(kind);
+
+    static const luaL_Reg patternlib[] =
+    {
+        {"match", match},
+        {"find", find},
+        {"filter", filter},
+        {"__gc", __gc},
+        {"__tostring", __tostring},
+        {nullptr, nullptr}
+    };
+
+    if (luaL_newmetatable(state, LUA_PATTERN))
+    {
+        lua_pushvalue(state, -1);           // push metatable
+        lua_setfield(state, -2, "__index"); // metatable.__index = metatable
+        luaL_setfuncs(state, patternlib, 0);// add methods to new metatable
+    }
+    lua_setmetatable(state, -2);
+
+#ifdef DEBUG
+    int newtop = lua_gettop(state);
+    assert(oldtop - newtop == -1);
+    luaL_Pattern* test = (luaL_Pattern*)luaL_checkudata(state, -1, LUA_PATTERN);
+    assert(test == pat);
+#endif
+
+    return pat;
+}
+
+//------------------------------------------------------------------------------
+luaL_Pattern* luaL_Pattern::check(lua_State* state, int index)
+{
+    return (luaL_Pattern*)luaL_checkudata(state, index, LUA_PATTERN);
+}
+
+//------------------------------------------------------------------------------
+// Compiles the spec at index; on failure pushes an error message and returns
+// false.
+bool luaL_Pattern::init(lua_State* state, int index)
+{
+    if (m_kind == pattern_kind::literal && lua_istable(state, index))
+    {
+        for (int i = 1;; ++i)
+        {
+            // Copy the literal before popping; a number entry is converted to
+            // a string that only the stack slot references.
+            lua_rawgeti(state, index, i);
+            const char* literal = lua_tostring(state, -1);
+            if (!literal)
+            {
+                lua_pop(state, 1);
+                break;
+            }
+            m_literals.emplace_back(literal);
+            lua_pop(state, 1);
+        }
+        m_spec = "{...}";
+    }
+    else
+    {
+        size_t len;
+        const char* spec = lua_tolstring(state, index, &len);
+        m_spec.concat(spec, int(len));
+        if (m_kind == pattern_kind::literal)
+            m_literals.emplace_back(spec);
+    }
+
+    switch (m_kind)
+    {
+    case pattern_kind::lua:
+        return m_pattern.compile(state, m_spec.c_str(), m_spec.length());
+
+    case pattern_kind::literal:
+        // The vector is not modified after this, so the set can point into
+        // its strings.
+        for (const auto& literal : m_literals)
+        {
+            m_literal_set.insert(literal.c_str());
+            if (literal.empty())
+                m_literal_empty = true;
+            else
+                m_literal_first.add((unsigned char)literal.c_str()[0]);
+        }
+        return true;
+
+    default:
+        return true;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Whether the whole of s matches (wild and literal), or whether the pattern
+// occurs anywhere in s (lua).
+bool luaL_Pattern::test(lua_State* state, const char* s, size_t len) const
+{
+    switch (m_kind)
+    {
+    case pattern_kind::wild:
+        {
+            str_compare_scope _(str_compare_scope::caseless, false/*fuzzy_accent*/);
+            return path::match_wild(str_iter(m_spec.c_str(), m_spec.length()), str_iter(s, int(len)));
+        }
+
+    case pattern_kind::literal:
+        return m_literal_set.find(s) != m_literal_set.end();
+
+    default:
+        {
+            MatchState ms;
+            const char* start;
+            const char* end;
+            return m_pattern.exec(ms, state, s, len, 0, start, end);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// Implements :find() for all kinds.  Pushes nothing if there's no match.
+bool luaL_Pattern::find_at(lua_State* state, const char* s, size_t len, size_t init, int& pushed) const
+{
+    pushed = 0;
+
+    switch (m_kind)
+    {
+    case pattern_kind::wild:
+        if (!test(state, s + init, len - init))
+            return false;
+        lua_pushinteger(state, init + 1);
+        lua_pushinteger(state, len);
+        pushed = 2;
+        return true;
+
+    case pattern_kind::literal:
+        {
+            // Earliest occurrence, and the longest literal at that position.
+            for (const char* p = s + init; p <= s + len; ++p)
+            {
+                if (!m_literal_empty && (p == s + len || !m_literal_first.test(*p)))
+                    continue;
+
+                size_t best = 0;
+                bool found = false;
+                for (const auto& literal : m_literals)
+                {
+                    const size_t literal_len = literal.length();
+                    if (literal_len <= size_t(s + len - p) &&
+                        memcmp(p, literal.c_str(), literal_len) == 0 &&
+                        (!found || literal_len > best))
+                    {
+                        best = literal_len;
+                        found = true;
+                    }
+                }
+
+                if (found)
+                {
+                    lua_pushinteger(state, p - s + 1);
+                    lua_pushinteger(state, p - s + best);
+                    pushed = 2;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    default:
+        {
+            MatchState ms;
+            const char* start;
+            const char* end;
+            if (!m_pattern.exec(ms, state, s, len, init, start, end))
+                return false;
+            lua_pushinteger(state, start - s + 1);
+            lua_pushinteger(state, end - s);
+            pushed = 2 + luaL_strpushcaptures(&ms, nullptr, nullptr);
+            return true;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+static size_t get_init(lua_State* state, int index, size_t len, bool& past_end)
+{
+    ptrdiff_t init = optinteger(state, index, 1);
+    if (init < 0)
+        init = ptrdiff_t(len) + init + 1;
+    past_end = (init > ptrdiff_t(len) + 1);
+    return (init < 1) ? 0 : past_end ? len : size_t(init - 1);
+}
+
+//------------------------------------------------------------------------------
+/// -name:  pattern:match
+/// -ver:   1.3.1
+/// -arg:   s:string
+/// -arg:   [init:integer]
+/// -ret:   string | nil
+/// Looks for the first match of the pattern in <span class="arg">s</span>,
+/// starting at <span class="arg">init</span> (default 1; negative values count
+/// from the end).
+///
+/// For a <code>"lua"</code> pattern this is the same as
+/// <code>string.match(s, spec, init)</code>:  it returns the captures, or the
+/// whole match if the pattern has no captures.  For <code>"wild"</code> and
+/// <code>"literal"</code> patterns it returns <span class="arg">s</span> if
+/// the whole string matches.
+///
+/// Returns nil if there's no match.
+int luaL_Pattern::match(lua_State* state)
+{
+    const luaL_Pattern* pat = check(state, 1);
+    size_t len;
+    const char* s = luaL_checklstring(state, 2, &len);
+    bool past_end;
+    const size_t init = get_init(state, 3, len, past_end);
+    if (past_end)
+        goto no_match;
+
+    if (pat->m_kind != pattern_kind::lua)
+    {
+        if (!pat->test(state, s + init, len - init))
+            goto no_match;
+        if (init)
+            lua_pushlstring(state, s + init, len - init);
+        else
+            lua_pushvalue(state, 2);
+        return 1;
+    }
+
+    MatchState ms;
+    const char* start;
+    const char* end;
+    if (!pat->m_pattern.exec(ms, state, s, len, init, start, end))
+        goto no_match;
+
+    return luaL_strpushcaptures(&ms, start, end);
+
+no_match:
+    lua_pushnil(state);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  pattern:find
+/// -ver:   1.3.1
+/// -arg:   s:string
+/// -arg:   [init:integer]
+/// -ret:   integer, integer, ...
+/// Looks for the first match of the pattern in <span class="arg">s</span>,
+/// starting at <span class="arg">init</span> (default 1; negative values count
+/// from the end), and returns the start and end indices of the match.
+///
+/// For a <code>"lua"</code> pattern this is the same as
+/// <code>string.find(s, spec, init)</code>, including returning any captures
+/// after the indices.  A <code>"wild"</code> pattern must match the whole
+/// string from <span class="arg">init</span> onward.  A <code>"literal"</code>
+/// pattern finds the earliest occurrence of any of its strings (the longest,
+/// if several start at the same position).
+///
+/// Returns nil if there's no match.
+int luaL_Pattern::find(lua_State* state)
+{
+    const luaL_Pattern* pat = check(state, 1);
+    size_t len;
+    const char* s = luaL_checklstring(state, 2, &len);
+    bool past_end;
+    const size_t init = get_init(state, 3, len, past_end);
+    if (past_end)
+        goto no_match;
+
+    int pushed;
+    if (!pat->find_at(state, s, len, init, pushed))
+        goto no_match;
+    return pushed;
+
+no_match:
+    lua_pushnil(state);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/// -name:  pattern:filter
+/// -ver:   1.3.1
+/// -arg:   items:table
+/// -ret:   table
+/// Returns a new table containing the items from the
+/// <span class="arg">items</span> table that match the pattern, in the same
+/// order.  Each item can be a string, or a table with a <code>match</code>
+/// field (such as the match tables used by match generators); the items
+/// themselves are put in the new table, so no strings are created.
+///
+/// A <code>"lua"</code> pattern keeps items where it is found anywhere (use a
+/// <code>^</code> anchor to match only at the start).  <code>"wild"</code> and
+/// <code>"literal"</code> patterns keep items that match completely.
+/// -show:  local dirs = clink.pattern("*.git", "wild"):filter(os.globdirs("*"))
+int luaL_Pattern::filter(lua_State* state)
+{
+    const luaL_Pattern* pat = check(state, 1);
+    luaL_checktype(state, 2, LUA_TTABLE);
+
+    const int count = int(lua_rawlen(state, 2));
+    lua_createtable(state, count, 0);
+
+    int out = 0;
+    for (int i = 1; i <= count; ++i)
+    {
+        lua_rawgeti(state, 2, i);
+
+        size_t len = 0;
+        const char* s = nullptr;
+        if (lua_type(state, -1) == LUA_TSTRING)
+        {
+            s = lua_tolstring(state, -1, &len);
+        }
+        else if (lua_istable(state, -1))
+        {
+            lua_getfield(state, -1, "match");
+            if (lua_type(state, -1) == LUA_TSTRING)
+                s = lua_tolstring(state, -1, &len);
+            lua_pop(state, 1);  // The item still references the string.
+        }
+
+        if (s && pat->test(state, s, len))
+            lua_rawseti(state, -2, ++out);
+        else
+            lua_pop(state, 1);
+    }
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int luaL_Pattern::__gc(lua_State* state)
+{
+    luaL_Pattern* pat = check(state, 1);
+    pat->~luaL_Pattern();
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int luaL_Pattern::__tostring(lua_State* state)
+{
+    const luaL_Pattern* pat = check(state, 1);
+    const char* kind = (pat->m_kind == pattern_kind::wild) ? "wild" : (pat->m_kind == pattern_kind::literal) ? "literal" : "lua";
+    lua_pushfstring(state, "pattern (%s: %s)", kind, pat->m_spec.c_str());
+    return 1;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Compiled patterns are cached in a weak table, so repeatedly asking for the
+// same spec (e.g. in a generator that runs on every keystroke) is a lookup.
+static const char c_cache_key = 0;
+
+//------------------------------------------------------------------------------
+/// -name:  clink.pattern
+/// -ver:   1.3.1
+/// -arg:   spec:string|table
+/// -arg:   [kind:string]
+/// -ret:   pattern
+/// Returns a compiled pattern object, for efficiently matching the same
+/// pattern many times (for example in match generators, classifiers, or
+/// prompt filters, which run often).  The pattern is parsed only once, and
+/// <code>clink.pattern()</code> returns the same object when called again with
+/// the same <span class="arg">spec</span> and <span class="arg">kind</span>, so
+/// it's fine to call it inline instead of saving the result in a variable.
+///
+/// <span class="arg">kind</span> can be:
+/// <table>
+/// <tr><th>Kind</th><th>Description</th></tr>
+/// <tr><td><code>"lua"</code></td><td>(The default.)  <span class="arg">spec</span> is a Lua pattern, as used by <code>string.find()</code> and <code>string.match()</code>.</td></tr>
+/// <tr><td><code>"wild"</code></td><td><span class="arg">spec</span> is a wildcard pattern using <code>*</code> and <code>?</code>, matched without regard to case and treating <code>/</code> and <code>\</code> as equal, the same way Clink matches file names.</td></tr>
+/// <tr><td><code>"literal"</code></td><td><span class="arg">spec</span> is a string, or a table of strings, to match exactly.</td></tr>
+/// </table>
+///
+/// The pattern object has <a href="#pattern:match">match()</a>,
+/// <a href="#pattern:find">find()</a>, and
+/// <a href="#pattern:filter">filter()</a> methods.  A malformed Lua pattern
+/// raises an error when the pattern is created; note that
+/// <code>string.find()</code> only raises an error if matching reaches the
+/// malformed part, so e.g. <code>string.find("a", "b%")</code> returns nil
+/// but <code>clink.pattern("b%")</code> raises an error.
+/// -show:  local pat = clink.pattern("^%-%-?[%w-]+=")
+/// -show:  if pat:find(word) then
+/// -show:  &nbsp;   -- word is a flag with a value, e.g. --color=auto.
+/// -show:  end
+static int new_pattern(lua_State* state)
+{
+    const bool is_table = lua_istable(state, 1);
+    if (!is_table)
+        luaL_checkstring(state, 1);
+
+    pattern_kind kind = pattern_kind::lua;
+    const char* kind_name = luaL_optstring(state, 2, "lua");
+    if (strcmp(kind_name, "wild") == 0)
+        kind = pattern_kind::wild;
+    else if (strcmp(kind_name, "literal") == 0)
+        kind = pattern_kind::literal;
+    else if (strcmp(kind_name, "lua") != 0)
+        return luaL_argerror(state, 2, "expected 'lua', 'wild', or 'literal'");
+
+    if (is_table && kind != pattern_kind::literal)
+        return luaL_argerror(state, 1, "only 'literal' patterns accept a table");
+
+    // Build the cache key:  the kind, followed by the spec (or by each of the
+    // literals, NUL terminated).
+    luaL_Buffer b;
+    luaL_buffinit(state, &b);
+    luaL_addchar(&b, char(kind));
+    if (is_table)
+    {
+        for (int i = 1;; ++i)
+        {
+            // luaL_addvalue() pops the entry after adding it, so the string
+            // is still referenced while it's copied.
+            lua_rawgeti(state, 1, i);
+            if (!lua_isstring(state, -1))
+            {
+                lua_pop(state, 1);
+                break;
+            }
+            luaL_addvalue(&b);
+            luaL_addchar(&b, '\0');
+        }
+    }
+    else
+    {
+        size_t len;
+        const char* spec = lua_tolstring(state, 1, &len);
+        luaL_addlstring(&b, spec, len);
+    }
+    luaL_pushresult(&b);
+    const int key = lua_gettop(state);
+
+    lua_rawgetp(state, LUA_REGISTRYINDEX, &c_cache_key);
+    const int cache = lua_gettop(state);
+    lua_pushvalue(state, key);
+    lua_rawget(state, cache);
+    if (!lua_isnil(state, -1))
+        return 1;
+    lua_pop(state, 1);
+
+    luaL_Pattern* pat = luaL_Pattern::make_new(state, kind);
+    if (!pat->init(state, 1))
+        return lua_error(state);
+
+    lua_pushvalue(state, key);
+    lua_pushvalue(state, -2);
+    lua_rawset(state, cache);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void pattern_lua_initialise(lua_state& lua)
+{
+    lua_State* state = lua.get_state();
+
+    // Weak values let unused patterns be collected.
+    lua_newtable(state);
+    lua_createtable(state, 0, 1);
+    lua_pushliteral(state, "v");
+    lua_setfield(state, -2, "__mode");
+    lua_setmetatable(state, -2);
+    lua_rawsetp(state, LUA_REGISTRYINDEX, &c_cache_key);
+
+    lua_getglobal(state, "clink");
+    lua_pushliteral(state, "pattern");
+    lua_pushcfunction(state, new_pattern);
+    lua_rawset(state, -3);
+    lua_pop(state, 1);
+}
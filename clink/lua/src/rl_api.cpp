@@ -33,6 +33,7 @@ extern int              _rl_last_v_pos;
 extern matches* get_mutable_matches(bool nosort=false);
 extern const char* get_last_luafunc();
 extern void override_rl_last_func(rl_command_func_t* func);
+extern void invalidate_rl_bindings_cache();
 
 extern int count_prompt_lines(const char* prompt_prefix, int len);
 
@@ -214,6 +215,7 @@ static int set_rl_variable(lua_State* state)
     if (rl_cvar == nullptr)
         return 0;
 
+    invalidate_rl_bindings_cache();
     int failed = rl_variable_bind(name, value);
     lua_pushboolean(state, !failed);
     return 1;
@@ -415,6 +417,8 @@ static int set_rl_binding(lua_State* state)
     str<> keys;
     unquote_keys(_key, keys);
 
+    invalidate_rl_bindings_cache();
+
     int result = -1;
     if (!binding)
     {
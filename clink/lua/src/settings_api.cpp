@@ -13,43 +13,27 @@
 //------------------------------------------------------------------------------
 extern setting_bool g_lua_strict;
 
+//------------------------------------------------------------------------------
+static const char* const c_handles_key = "clink_setting_handles";
+static const char* const c_generation_key = "clink_setting_generation";
+
 
 
 //------------------------------------------------------------------------------
-/// -name:  settings.get
-/// -ver:   1.0.0
-/// -arg:   name:string
-/// -arg:   [descriptive:boolean]
-/// -ret:   boolean or string or integer
-/// Returns the current value of the <span class="arg">name</span> Clink
-/// setting.
-///
-/// If it's a color setting and the optional
-/// <span class="arg">descriptive</span> parameter is true then the user
-/// friendly color name is returned.
-static int get(lua_State* state)
+static void push_setting_value(lua_State* state, const setting* setting, bool descriptive)
 {
-    const char* key = checkstring(state, 1);
-    if (!key)
-        return 0;
-
-    const setting* setting = settings::find(key);
-    if (setting == nullptr)
-        return 0;
-
-    int type = setting->get_type();
-    switch (type)
+    switch (setting->get_type())
     {
     case setting::type_bool:
         {
-            bool value = ((setting_bool*)setting)->get();
+            bool value = ((const setting_bool*)setting)->get();
             lua_pushboolean(state, value == true);
         }
         break;
 
     case setting::type_int:
         {
-            int value = ((setting_int*)setting)->get();
+            int value = ((const setting_int*)setting)->get();
             lua_pushinteger(state, value);
         }
         break;
@@ -57,7 +41,7 @@ static int get(lua_State* state)
     default:
         {
             str<> value;
-            if (lua_isboolean(state, 2) && lua_toboolean(state, 2))
+            if (descriptive)
                 setting->get_descriptive(value);
             else
                 setting->get(value);
@@ -65,7 +49,98 @@ static int get(lua_State* state)
         }
         break;
     }
+}
+
+//------------------------------------------------------------------------------
+// Pushes the table of setting handles, creating it if necessary.
+static void push_handles(lua_State* state)
+{
+    lua_getfield(state, LUA_REGISTRYINDEX, c_handles_key);
+    if (lua_isnil(state, -1))
+    {
+        lua_pop(state, 1);
+        lua_createtable(state, 0, 0);
+        lua_pushvalue(state, -1);
+        lua_setfield(state, LUA_REGISTRYINDEX, c_handles_key);
+    }
+}
 
+//------------------------------------------------------------------------------
+// Updates the value field of the handle table at handle_index.  If the value
+// changed, the old value is left on the stack and true is returned.
+static bool update_handle(lua_State* state, int handle_index, const setting* setting)
+{
+    lua_getfield(state, handle_index, "value");
+    push_setting_value(state, setting, false);
+    if (lua_rawequal(state, -1, -2))
+    {
+        lua_pop(state, 2);
+        return false;
+    }
+
+    lua_setfield(state, handle_index, "value");
+    return true;
+}
+
+//------------------------------------------------------------------------------
+static void send_setting_changed(lua_State* state, int handle_index, int old_index)
+{
+    lua_getglobal(state, "clink");
+    if (lua_istable(state, -1))
+    {
+        lua_getfield(state, -1, "_send_event");
+        if (lua_isfunction(state, -1))
+        {
+            lua_pushliteral(state, "onsettingchanged");
+            lua_getfield(state, handle_index, "name");
+            lua_getfield(state, handle_index, "value");
+            lua_pushvalue(state, old_index);
+
+            // An error in an event handler must not propagate out of
+            // settings.set(), so report it and carry on.
+            if (lua_state::pcall(state, 4, 0) != 0)
+            {
+                if (const char* error = lua_tostring(state, -1))
+                {
+                    puts("");
+                    puts(error);
+                }
+                lua_pop(state, 1);
+            }
+        }
+        else
+        {
+            lua_pop(state, 1);
+        }
+    }
+    lua_pop(state, 1);
+}
+
+
+
+//------------------------------------------------------------------------------
+/// -name:  settings.get
+/// -ver:   1.0.0
+/// -arg:   name:string
+/// -arg:   [descriptive:boolean]
+/// -ret:   boolean or string or integer
+/// Returns the current value of the <span class="arg">name</span> Clink
+/// setting.
+///
+/// If it's a color setting and the optional
+/// <span class="arg">descriptive</span> parameter is true then the user
+/// friendly color name is returned.
+static int get(lua_State* state)
+{
+    const char* key = checkstring(state, 1);
+    if (!key)
+        return 0;
+
+    const setting* setting = settings::find(key);
+    if (setting == nullptr)
+        return 0;
+
+    push_setting_value(state, setting, lua_isboolean(state, 2) && lua_toboolean(state, 2));
     return 1;
 }
 
@@ -104,10 +179,79 @@ static int set(lua_State* state)
     if (ok)
         ok = settings::sandboxed_set_setting(key, value);
 
+    // Update the handle right away, if there is one, rather than waiting for
+    // the next refresh.
+    if (ok)
+    {
+        int top = lua_gettop(state);
+        push_handles(state);
+        lua_getfield(state, -1, setting->get_name());
+        if (lua_istable(state, -1) && update_handle(state, top + 2, setting))
+            send_setting_changed(state, top + 2, top + 3);
+        lua_settop(state, top);
+    }
+
     lua_pushboolean(state, ok == true);
     return 1;
 }
 
+//------------------------------------------------------------------------------
+/// -name:  settings.gethandle
+/// -ver:   1.3.1
+/// -arg:   name:string
+/// -ret:   table | nil
+/// Returns a handle for the <span class="arg">name</span> Clink setting, or
+/// nil if there is no such setting.
+///
+/// The handle is a table with a <code>name</code> field and a
+/// <code>value</code> field.  The <code>value</code> field holds the same
+/// value <a href="#settings.get">settings.get()</a> would return, and Clink
+/// keeps it up to date when settings are loaded or changed.  Reading a field
+/// is much faster than calling <a href="#settings.get">settings.get()</a>, so
+/// scripts can get a handle once when they're loaded and then read from it in
+/// functions that are called frequently, such as match generators.
+///
+/// Use <a href="#clink.onsettingchanged">clink.onsettingchanged()</a> to be
+/// notified when a setting's value changes.
+/// -show:  local expand = settings.gethandle("match.expand_envvars")
+/// -show:
+/// -show:  function my_generator:generate(line_state, match_builder)
+/// -show:  &nbsp;   if expand.value then
+/// -show:  &nbsp;       -- ...
+/// -show:  &nbsp;   end
+/// -show:  end
+static int get_handle(lua_State* state)
+{
+    const char* key = checkstring(state, 1);
+    if (!key)
+        return 0;
+
+    const setting* setting = settings::find(key);
+    if (setting == nullptr)
+        return 0;
+
+    // Handles are keyed by the setting's own name, since lookup is caseless.
+    push_handles(state);
+    lua_getfield(state, -1, setting->get_name());
+    if (!lua_isnil(state, -1))
+        return 1;
+    lua_pop(state, 1);
+
+    lua_createtable(state, 0, 2);
+
+    lua_pushliteral(state, "name");
+    lua_pushstring(state, setting->get_name());
+    lua_rawset(state, -3);
+
+    lua_pushliteral(state, "value");
+    push_setting_value(state, setting, false);
+    lua_rawset(state, -3);
+
+    lua_pushvalue(state, -1);
+    lua_setfield(state, -3, setting->get_name());
+    return 1;
+}
+
 //------------------------------------------------------------------------------
 template <typename S, typename... V> void add_impl(lua_State* state, V... value)
 {
@@ -362,6 +506,7 @@ void settings_lua_initialise(lua_state& lua)
         { "set",    &set },
         { "add",    &add },
         { "list",   &list },
+        { "gethandle", &get_handle },
     };
 
     lua_State* state = lua.get_state();
@@ -378,6 +523,54 @@ void settings_lua_initialise(lua_state& lua)
     lua_setglobal(state, "settings");
 }
 
+//------------------------------------------------------------------------------
+// Refreshes the values in setting handles if settings may have changed since
+// the last refresh.  Returns the number of handles whose value changed, and if
+// any changed then it pushes a table of { name, value, old } tables.
+int settings_lua_refresh(lua_State* state)
+{
+    lua_getfield(state, LUA_REGISTRYINDEX, c_generation_key);
+    const bool stale = (unsigned int)(lua_tointeger(state, -1)) != settings::get_generation();
+    lua_pop(state, 1);
+    if (!stale)
+        return 0;
+
+    lua_pushinteger(state, settings::get_generation());
+    lua_setfield(state, LUA_REGISTRYINDEX, c_generation_key);
+
+    int top = lua_gettop(state);
+    int handles = top + 1;
+    int changes = top + 2;
+    push_handles(state);
+    lua_createtable(state, 0, 0);
+
+    int count = 0;
+    lua_pushnil(state);
+    while (lua_next(state, handles))
+    {
+        int handle = lua_gettop(state);
+        const setting* setting = settings::find(lua_tostring(state, -2));
+        if (setting && update_handle(state, handle, setting))
+        {
+            lua_createtable(state, 3, 0);
+            lua_getfield(state, handle, "name");
+            lua_rawseti(state, -2, 1);
+            lua_getfield(state, handle, "value");
+            lua_rawseti(state, -2, 2);
+            lua_insert(state, -2);
+            lua_rawseti(state, -2, 3);
+            lua_rawseti(state, changes, ++count);
+        }
+        lua_settop(state, handle - 1);
+    }
+
+    if (count)
+        lua_remove(state, handles);
+    else
+        lua_settop(state, top);
+    return count;
+}
+
 //----------------------------------------------------------------------------
 // Clink 0.4.8 API compatibility!
 int get_clink_setting(lua_State* state)
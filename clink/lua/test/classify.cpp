@@ -378,6 +378,46 @@ TEST_CASE("Lua word classification")
             tester.run();
         }
 
+        SECTION("Separator cached commands")
+        {
+            // Earlier commands are classified once and then reused from the
+            // cache while typing the later commands.
+            const char* counter = "\
+                classified = {}\
+                local counter = clink.classifier(1)\
+                function counter:classify(commands)\
+                    for _, command in ipairs(commands) do\
+                        local offset = command.line_state:getcommandoffset()\
+                        classified[offset] = (classified[offset] or 0) + 1\
+                    end\
+                end\
+            ";
+
+            REQUIRE(lua.do_string(counter));
+
+            tester.set_input("xyz --bee abc & argcmd \"spa ce\" two | xyz --bee nf -a");
+            tester.set_expected_classifications("ofaoaaofan");
+            tester.run();
+
+            // The input is typed one key at a time (56 keys).  A command is
+            // only classified while its text is changing, i.e. while it's
+            // being typed plus once when it stops being the last command.
+            // The last command is classified for every key typed in it.
+            const char* verify = "\
+                local offsets = {}\
+                for offset in pairs(classified) do table.insert(offsets, offset) end\
+                table.sort(offsets)\
+                local first = classified[offsets[1]]\
+                local second = classified[17]\
+                local third = classified[39]\
+                assert(first and first <= #'xyz --bee abc & ' + 2, 'first: '..tostring(first))\
+                assert(second and second <= #'argcmd \"spa ce\" two | ' + 2, 'second: '..tostring(second))\
+                assert(third and third >= #'xyz --bee nf -a' - 2, 'third: '..tostring(third))\
+            ";
+
+            REQUIRE(lua.do_string(verify));
+        }
+
         SECTION("Multiple commands with args")
         {
             tester.set_input("xyz abc green | asdfjkl etc | echo etc | xyz -a def && argcmd t");
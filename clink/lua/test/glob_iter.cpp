@@ -0,0 +1,88 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include "fs_fixture.h"
+
+#include <lua/lua_state.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua os.globiter")
+{
+    fs_fixture fs;
+    lua_state lua;
+
+    SECTION("Same as globfiles")
+    {
+        const char* script = "\
+            local function check(pattern, dirsonly)\
+                local t = dirsonly and os.globdirs(pattern) or os.globfiles(pattern)\
+                local i = 0\
+                for name in os.globiter(pattern, nil, dirsonly) do\
+                    i = i + 1\
+                    assert(name == t[i], pattern)\
+                end\
+                assert(i == #t, pattern)\
+                return i\
+            end\
+            \
+            assert(check('*') == 6)\
+            assert(check('*', true) == 2)\
+            assert(check('dir1/*') == 3)\
+            assert(check('dir1/*', true) == 0)\
+            assert(check('nothing*') == 0)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Extra info")
+    {
+        const char* script = "\
+            local n = 0\
+            for name, info in os.globiter('*', true) do\
+                n = n + 1\
+                assert(info.name == name)\
+                assert(info.type:find('^dir') or info.type:find('^file'))\
+                assert(info.size == nil and info.mtime == nil)\
+            end\
+            assert(n == 6)\
+            \
+            for name, info in os.globiter('*', 2) do\
+                assert(info.name == name and info.type)\
+                assert(info.size and info.atime and info.mtime and info.ctime)\
+            end\
+            \
+            for name, info in os.globiter('dir*', 'size, type') do\
+                assert(info.name == nil)\
+                assert(info.type:find('^dir'))\
+                assert(info.size and info.mtime == nil)\
+            end\
+            \
+            for name, info in os.globiter('file1', 0) do\
+                assert(name == 'file1' and info == nil)\
+            end\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Close")
+    {
+        const char* script = "\
+            local iter = os.globiter('*')\
+            assert(iter() ~= nil)\
+            iter:close()\
+            assert(iter() == nil)\
+            iter:close()\
+            \
+            iter = os.globiter('file1')\
+            assert(iter() == 'file1')\
+            assert(iter() == nil)\
+            assert(iter() == nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+}
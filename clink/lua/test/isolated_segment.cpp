@@ -0,0 +1,89 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lua/lua_state.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua isolated prompt segments")
+{
+    lua_state lua;
+
+    SECTION("Transfer")
+    {
+        const char* script = "\
+            os.setenv('CLINK_ISOLATED_TEST', 'abc')\
+            local seg = clink._newisolatedsegment(function(inputs)\
+                n = (n or 0) + 1\
+                return inputs.cwd..'|'..inputs.errorlevel..'|'..tostring(inputs.env.CLINK_ISOLATED_TEST)..'|'..n\
+            end)\
+            local expected = os.getcwd()..'|'..os.geterrorlevel()..'|abc|'\
+            clink._runisolatedsegments({ seg })\
+            assert(seg:get() == expected..'1')\
+            \
+            -- Globals persist in the segment's own state between runs.\
+            clink._runisolatedsegments({ seg })\
+            assert(seg:get() == expected..'2')\
+            assert(n == nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Upvalues")
+    {
+        const char* script = "\
+            local x = 1\
+            local ok, err = pcall(clink._newisolatedsegment, function() return x end)\
+            assert(not ok and err:find(\"upvalue 'x'\"))\
+            assert(not pcall(clink._newisolatedsegment, print))\
+            assert(not pcall(clink._newisolatedsegment, 'not a function'))\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Errors")
+    {
+        const char* script = "\
+            local bad = clink._newisolatedsegment(function() error('boom') end)\
+            local tbl = clink._newisolatedsegment(function() return {} end)\
+            local none = clink._newisolatedsegment(function() end)\
+            clink._runisolatedsegments({ bad, tbl, none })\
+            \
+            local s, e = bad:get()\
+            assert(s == nil and e:find('boom'))\
+            s, e = tbl:get()\
+            assert(s == nil and e)\
+            assert(select('#', none:get()) == 0)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Timeout")
+    {
+        const char* script = "\
+            local slow = clink._newisolatedsegment(function()\
+                n = (n or 0) + 1\
+                if n > 1 then while true do end end\
+                return 'first'\
+            end)\
+            clink._runisolatedsegments({ slow }, 100)\
+            assert(slow:get() == 'first')\
+            \
+            -- The timed out run falls back to the cached text.\
+            clink._runisolatedsegments({ slow }, 100)\
+            local s, e = slow:get()\
+            assert(s == 'first' and e:find('timed out'))\
+            \
+            local loop = clink._newisolatedsegment(function() while true do end end)\
+            clink._runisolatedsegments({ loop }, 50)\
+            s, e = loop:get()\
+            assert(s == nil and e:find('timed out'))\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+}
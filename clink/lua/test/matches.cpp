@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/str_compare.h>
+#include <lib/matches.h>
+#include <lua/lua_state.h>
+#include <match_pipeline.h>
+#include <matches_impl.h>
+#include <matches_lua.h>
+
+extern "C" {
+#include <lua.h>
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua matches object")
+{
+    lua_state lua;
+    lua_State* state = lua.get_state();
+
+    matches_impl matches;
+    match_pipeline pipeline(matches);
+    match_builder builder(matches);
+
+    pipeline.reset();
+    builder.add_match("abc", match_type::word);
+    builder.add_match("abd", match_type::arg);
+    builder.add_match("Bcd", match_type::word);
+    builder.add_match("dir\\", match_type::dir);
+    builder.add_match("file.txt", match_type::file);
+    pipeline.select("");
+    pipeline.sort();
+    REQUIRE(matches.get_match_count() == 5);
+
+    matches_lua matches_lua(matches);
+    matches_lua.push(state);
+    lua_setglobal(state, "m");
+
+    SECTION("getmatches and gettypes")
+    {
+        const char* script = "\
+            local all = m:getmatches()\
+            local types = m:gettypes()\
+            assert(#all == m:getcount() and #types == #all)\
+            for i = 1, #all do\
+                assert(all[i] == m:getmatch(i))\
+                assert(types[i] == m:gettype(i))\
+            end\
+            \
+            local some = m:getmatches(2, 3)\
+            assert(#some == 2)\
+            assert(some[1] == m:getmatch(2) and some[2] == m:getmatch(3))\
+            assert(#m:gettypes(2, 3) == 2)\
+            \
+            assert(#m:getmatches(0, 99) == #all)\
+            assert(#m:getmatches(4, 2) == 0)\
+            assert(#m:getmatches(9) == 0)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("find")
+    {
+        str_compare_scope _(str_compare_scope::caseless, false);
+
+        const char* script = "\
+            local i = m:find('ab')\
+            assert(i and m:getmatch(i):sub(1, 2) == 'ab')\
+            local j = m:find('ab', i + 1)\
+            assert(j and j > i and m:getmatch(j):sub(1, 2) == 'ab')\
+            assert(m:find('ab', j + 1) == nil)\
+            \
+            local b = m:find('bc')\
+            assert(b and m:getmatch(b) == 'Bcd')\
+            assert(m:find('zz') == nil)\
+            assert(m:find('') == 1)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("filter")
+    {
+        const char* script = "\
+            local t, types = m:filter('*.txt')\
+            assert(#t == 1 and t[1] == 'file.txt')\
+            assert(types[1] == 'file')\
+            \
+            t, types = m:filter('ab*')\
+            assert(#t == 2 and #types == 2)\
+            for i = 1, #t do\
+                assert(t[i]:sub(1, 2) == 'ab')\
+            end\
+            \
+            t = m:filter('*')\
+            assert(#t == m:getcount())\
+            \
+            t, types = m:filter('nothing*')\
+            assert(#t == 0 and #types == 0)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+}
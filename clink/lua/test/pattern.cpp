@@ -0,0 +1,107 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <lua/lua_state.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua compiled patterns")
+{
+    lua_state lua;
+
+    SECTION("Same as string.find")
+    {
+        const char* script = "\
+            local subjects = { '', 'abc', '  key=value', '--flag=1 x', '(a(b)c)', 'THE (quick) fox' }\
+            local patterns = {\
+                'a', '^a', 'c$', '%w+', '(%w+)=(%w+)', '^%-%-?[%w-]+=', '%b()', '%f[%a]%a+',\
+                '()b()', '[^%s]+', 'x*', '.-c', '(a)(b?)%1', '[%]]', '', 'e%)?',\
+            }\
+            for _, p in ipairs(patterns) do\
+                local pat = clink.pattern(p)\
+                for _, s in ipairs(subjects) do\
+                    for init = -2, #s + 2 do\
+                        local a = { string.find(s, p, init) }\
+                        local b = { pat:find(s, init) }\
+                        assert(#a == #b, p)\
+                        for i = 1, #a do assert(a[i] == b[i], p) end\
+                        assert(string.match(s, p, init) == pat:match(s, init), p)\
+                    end\
+                end\
+            end\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Cached")
+    {
+        const char* script = "\
+            assert(clink.pattern('%d+') == clink.pattern('%d+'))\
+            assert(clink.pattern('%d+') ~= clink.pattern('%d+', 'wild'))\
+            assert(clink.pattern({ 'a', 'b' }, 'literal') == clink.pattern({ 'a', 'b' }, 'literal'))\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Malformed")
+    {
+        REQUIRE(!lua.do_string("clink.pattern('(a')"));
+        REQUIRE(!lua.do_string("clink.pattern('[a')"));
+        REQUIRE(!lua.do_string("clink.pattern('a%')"));
+        REQUIRE(!lua.do_string("clink.pattern('%1')"));
+        REQUIRE(!lua.do_string("clink.pattern('a', 'regex')"));
+
+        // string.find() only raises an error when matching reaches the
+        // malformed part; clink.pattern() checks the whole pattern up front.
+        REQUIRE(lua.do_string("assert(string.find('a', 'b%') == nil)"));
+        REQUIRE(!lua.do_string("clink.pattern('b%')"));
+    }
+
+    SECTION("Wild")
+    {
+        const char* script = "\
+            local pat = clink.pattern('*.TXT', 'wild')\
+            assert(pat:match('readme.txt') == 'readme.txt')\
+            assert(pat:match('readme.txt.bak') == nil)\
+            local s, e = pat:find('xreadme.txt', 2)\
+            assert(s == 2 and e == 11)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Literal")
+    {
+        const char* script = "\
+            local pat = clink.pattern({ 'ab', 'abc', 'x' }, 'literal')\
+            assert(pat:match('abc') == 'abc')\
+            assert(pat:match('abcd') == nil)\
+            local s, e = pat:find('zzabcx')\
+            assert(s == 3 and e == 5)\
+            assert(pat:find('qq') == nil)\
+            local num = clink.pattern({ 'a', 12, 3.5, 'b' }, 'literal')\
+            assert(num == clink.pattern({ 'a', '12', '3.5', 'b' }, 'literal'))\
+            assert(num:match('12') == '12')\
+            assert(num:match('3.5') == '3.5')\
+            assert(num:match('b') == 'b')\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Filter")
+    {
+        const char* script = "\
+            local items = { '--a=1', 'b', { match = '-c=2' }, { match = 5 }, '--d' }\
+            local out = clink.pattern('^%-%-?%w+='):filter(items)\
+            assert(#out == 2)\
+            assert(out[1] == '--a=1')\
+            assert(out[2] == items[3])\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+}
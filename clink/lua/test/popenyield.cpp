@@ -0,0 +1,152 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include "fs_fixture.h"
+
+#include <core/settings.h>
+#include <lua/lua_state.h>
+
+//------------------------------------------------------------------------------
+static void write_file(const char* name, const char* content, int repeat=1)
+{
+    FILE* f = fopen(name, "wb");
+    REQUIRE(f != nullptr);
+    while (repeat-- > 0)
+        fputs(content, f);
+    fclose(f);
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua io.popenyield")
+{
+    fs_fixture fs;
+
+    // Without prompt.async it doesn't yield, so it can run outside of a
+    // coroutine; it still returns the same kind of file handle.
+    setting* async = settings::find("prompt.async");
+    REQUIRE(async);
+    str<> old_async;
+    async->get(old_async);
+    async->set("false");
+
+    lua_state lua;
+
+    write_file("crlf.txt", "one\r\ntwo\r\n12 3.5\r\nend");
+
+    SECTION("Read formats")
+    {
+        const char* script = "\
+            local f = io.popenyield('type crlf.txt')\
+            assert(io.type(f) == 'file')\
+            assert(f:read('*l') == 'one')\
+            assert(f:read('*L') == 'two\\n')\
+            local a, b = f:read('*n', '*n')\
+            assert(a == 12 and b == 3.5)\
+            assert(f:read('*l') == '')\
+            assert(f:read(2) == 'en')\
+            assert(f:read(0) == '')\
+            assert(f:read('*a') == 'd')\
+            assert(f:read(0) == nil)\
+            assert(f:read('*a') == '')\
+            assert(f:read('*l') == nil)\
+            assert(f:read(1) == nil)\
+            assert(f:read('*n') == nil)\
+            assert(not pcall(f.read, f, '*x'))\
+            \
+            assert(f:seek('set') == 0)\
+            assert(f:read() == 'one')\
+            assert(f:seek() == 5)\
+            assert(f:seek('cur', 3) == 8)\
+            assert(f:read('*l') == '')\
+            assert(f:seek('end') == 21)\
+            assert(f:seek('set', -1) == nil)\
+            assert(f:setvbuf('no'))\
+            assert(not pcall(f.setvbuf, f, 'bogus'))\
+            \
+            assert(io.close(f))\
+            assert(io.type(f) == 'closed file')\
+            assert(not pcall(f.read, f))\
+            assert(not pcall(io.close, f))\
+            assert(io.type(42) == nil)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Lines")
+    {
+        const char* script = "\
+            local f = io.popenyield('type crlf.txt', 'r')\
+            local t = {}\
+            for line in f:lines() do\
+                table.insert(t, line)\
+            end\
+            assert(#t == 4)\
+            assert(t[1] == 'one' and t[2] == 'two' and t[3] == '12 3.5' and t[4] == 'end')\
+            f:close()\
+            \
+            f = io.popenyield('type crlf.txt')\
+            t = {}\
+            for a, b in f:lines(1, '*l') do\
+                table.insert(t, a..'|'..b)\
+            end\
+            assert(#t == 4 and t[1] == 'o|ne' and t[4] == 'e|nd')\
+            f:close()\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("CRLF")
+    {
+        const char* script = "\
+            local f = io.popenyield('type crlf.txt', 'rt')\
+            assert(f:read('*a') == 'one\\ntwo\\n12 3.5\\nend')\
+            f:close()\
+            \
+            f = io.popenyield('type crlf.txt', 'rb')\
+            assert(f:read('*a') == 'one\\r\\ntwo\\r\\n12 3.5\\r\\nend')\
+            f:close()\
+            \
+            f = io.popenyield('type crlf.txt', 'b')\
+            assert(f:read('*l') == 'one\\r')\
+            f:close()\
+            \
+            assert(not pcall(io.popenyield, 'type crlf.txt', 'w'))\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    SECTION("Spill to temp file")
+    {
+        // More than the 4MB that's kept in memory.
+        const int line_count = 80000;
+        write_file("big.txt", "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\r\n", line_count);
+
+        const char* script = "\
+            local f = io.popenyield('type big.txt')\
+            local n = 0\
+            for line in f:lines() do\
+                assert(#line == 64)\
+                n = n + 1\
+            end\
+            assert(n == 80000)\
+            \
+            assert(f:seek('end') == 80000 * 66)\
+            assert(f:seek('set', 66) == 66)\
+            assert(f:read('*L') == '0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\\n')\
+            assert(io.close(f))\
+            \
+            f = io.popenyield('type big.txt', 'rb')\
+            assert(#f:read('*a') == 80000 * 66)\
+            f:close()\
+        ";
+
+        REQUIRE(lua.do_string(script));
+    }
+
+    async->set(old_async.c_str());
+}
@@ -0,0 +1,100 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include "fs_fixture.h"
+
+#include <core/path.h>
+#include <core/settings.h>
+#include <lua/lua_state.h>
+
+//------------------------------------------------------------------------------
+TEST_CASE("Lua setting handles")
+{
+    fs_fixture fs;
+    setting_bool test_bool("test.notify_bool", "", false);
+
+    lua_state lua;
+    lua.refresh_settings();
+
+    const char* init = "\
+        h = settings.gethandle('test.notify_bool')\
+        assert(h and h.name == 'test.notify_bool' and h.value == false)\
+        assert(settings.gethandle('TEST.NOTIFY_BOOL') == h)\
+        changes = {}\
+        clink.onsettingchanged(function(name, value, old)\
+            table.insert(changes, { name=name, value=value, old=old })\
+        end)\
+    ";
+
+    REQUIRE(lua.do_string(init));
+
+    SECTION("Refresh")
+    {
+        // Changing a setting from C++ is picked up by the next refresh.
+        REQUIRE(test_bool.set("true"));
+        lua.refresh_settings();
+
+        const char* script = "\
+            assert(h.value == true)\
+            assert(#changes == 1)\
+            assert(changes[1].name == 'test.notify_bool')\
+            assert(changes[1].value == true)\
+            assert(changes[1].old == false)\
+        ";
+
+        REQUIRE(lua.do_string(script));
+
+        // No change, no notification.
+        lua.refresh_settings();
+        REQUIRE(test_bool.set("on"));
+        lua.refresh_settings();
+        REQUIRE(lua.do_string("assert(#changes == 1)"));
+
+        test_bool.set();
+        lua.refresh_settings();
+        REQUIRE(lua.do_string("assert(h.value == false and #changes == 2)"));
+    }
+
+    SECTION("settings.set")
+    {
+        // settings.set() also writes the settings file, so give it one.  The
+        // load fails since the file doesn't exist yet, but remembers the name.
+        str<> file(fs.get_root());
+        path::append(file, "clink_settings");
+        settings::load(file.c_str());
+        FILE* f = fopen(file.c_str(), "wb");
+        REQUIRE(f != nullptr);
+        fputs("# test\n", f);
+        fclose(f);
+
+        SECTION("Notifies immediately")
+        {
+            const char* script = "\
+                assert(settings.set('test.notify_bool', true))\
+                assert(h.value == true)\
+                assert(#changes == 1 and changes[1].old == false)\
+            ";
+
+            REQUIRE(lua.do_string(script));
+
+            // The refresh doesn't report the same change again.
+            lua.refresh_settings();
+            REQUIRE(lua.do_string("assert(#changes == 1)"));
+        }
+
+        SECTION("Handler error")
+        {
+            // An error in a handler is reported, but doesn't make
+            // settings.set() fail.
+            const char* script = "\
+                clink.onsettingchanged(function() error('oops') end)\
+                assert(settings.set('test.notify_bool', true))\
+                assert(h.value == true and #changes == 1)\
+            ";
+
+            REQUIRE(lua.do_string(script));
+        }
+    }
+}
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <core/grapheme_iter.h>
 #include <core/str_iter.h>
 
 //------------------------------------------------------------------------------
@@ -15,6 +16,35 @@ inline int clink_wcwidth(char32_t c)
     return (w >= 0) ? w : 1;
 }
 
+//------------------------------------------------------------------------------
+// Width of the grapheme cluster most recently returned by iter.next().  Emoji
+// sequences (flags, ZWJ sequences, emoji presentation) occupy two cells.
+//
+// This is what cell_count(), ecma48_processor() and ellipsify() use, so it
+// applies to the match display and description columns, selectcomplete, and
+// console.cellcount().  Readline's display.c lays out the input line and the
+// prompt one code point at a time instead, and so do fnwidth() and fnappend()
+// for match names.  The two agree except for emoji sequences:  e.g. a family
+// ZWJ sequence is 2 cells here but 3 in Readline (1 per emoji, 0 per ZWJ), and
+// U+2764 U+FE0F is 2 here but 1 in Readline.  Flags are 2 in both.  Only the
+// cluster width matches what terminals that render emoji sequences show.
+template <typename T> int clink_wcwidth(const grapheme_iter_impl<T>& iter)
+{
+    if (iter.is_emoji())
+        return 2;
+
+    int w = clink_wcwidth(iter.get_first());
+    if (iter.get_first() >= 0x80)
+    {
+        // Combining marks are zero width, but spacing marks are not.
+        str_iter_impl<T> inner(iter.get_cluster(), iter.get_cluster_length());
+        inner.next();
+        while (int c = inner.next())
+            w += clink_wcwidth(c);
+    }
+    return w;
+}
+
 //------------------------------------------------------------------------------
 enum class ecma48_processor_flags { none = 0, bracket = 1<<0, apply_title = 1<<1, plaintext = 1<<2 };
 DEFINE_ENUM_FLAG_OPERATORS(ecma48_processor_flags);
@@ -3,6 +3,10 @@
 
 #pragma once
 
+#include <vector>
+
+class wstr_base;
+
 //------------------------------------------------------------------------------
 enum find_line_mode : int
 {
@@ -12,10 +16,50 @@ enum find_line_mode : int
 };
 DEFINE_ENUM_FLAG_OPERATORS(find_line_mode);
 
+//------------------------------------------------------------------------------
+// While at least one screen_snapshot is alive, rows that a screen_rows has
+// already read from the console are reused instead of being read again.  Keep
+// the scope short; nothing should write to the console while it's active.
+class screen_snapshot
+{
+public:
+                        screen_snapshot();
+                        ~screen_snapshot();
+    static bool         is_active();
+    static unsigned int get_id();
+
+private:
+                        screen_snapshot(const screen_snapshot&) = delete;
+    screen_snapshot&    operator = (const screen_snapshot&) = delete;
+    static int          s_depth;
+    static unsigned int s_id;
+};
+
+//------------------------------------------------------------------------------
+// Reads blocks of console screen buffer rows (text and attributes together)
+// into a reusable buffer, so scanning many lines doesn't cost a round trip to
+// the console per line.
+class screen_rows
+{
+public:
+                        ~screen_rows();
+    const CHAR_INFO*    get_row(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi, int line, int direction=0);
+    void                clear();
+    static void         get_text(const CHAR_INFO* row, int width, wstr_base& out, std::vector<int>* cells=nullptr);
+
+private:
+    bool                read(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi, int top, int count);
+    CHAR_INFO*          m_buffer = nullptr;
+    int                 m_capacity = 0;
+    int                 m_top = 0;
+    int                 m_count = 0;
+    int                 m_width = 0;
+    unsigned int        m_snapshot = 0;
+};
+
 //------------------------------------------------------------------------------
 int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
-              wchar_t* chars_buffer, int chars_capacity,
-              WORD* attrs_buffer, int attrs_capacity,
+              screen_rows& rows,
               int starting_line, int distance,
               const char* text, find_line_mode mode,
               const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff);
@@ -22,9 +22,9 @@ extern "C" unsigned int cell_count(const char* in)
         if (code.get_type() != ecma48_code::type_chars)
             continue;
 
-        str_iter inner_iter(code.get_pointer(), code.get_length());
-        while (int c = inner_iter.next())
-            count += clink_wcwidth(c);
+        grapheme_iter inner_iter(code.get_pointer(), code.get_length());
+        while (inner_iter.next())
+            count += clink_wcwidth(inner_iter);
     }
 
     return count;
@@ -526,9 +526,9 @@ static unsigned int clink_wcwidth(const char* s, unsigned int len)
 {
     unsigned int count = 0;
 
-    str_iter inner_iter(s, len);
-    while (int c = inner_iter.next())
-        count += clink_wcwidth(c);
+    grapheme_iter inner_iter(s, len);
+    while (inner_iter.next())
+        count += clink_wcwidth(inner_iter);
 
     return count;
 }
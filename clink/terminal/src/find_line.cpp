@@ -13,24 +13,184 @@
 
 #include <regex>
 
+//------------------------------------------------------------------------------
+// ReadConsoleOutputW fails when the request is too large for conhost's shared
+// buffer, so blocks of rows are bounded by bytes rather than by row count.
+static const int c_max_block_bytes = 32 * 1024;
+
+
+
+//------------------------------------------------------------------------------
+int screen_snapshot::s_depth = 0;
+unsigned int screen_snapshot::s_id = 0;
+
+//------------------------------------------------------------------------------
+screen_snapshot::screen_snapshot()
+{
+    if (!s_depth++)
+        s_id++;
+}
+
+//------------------------------------------------------------------------------
+screen_snapshot::~screen_snapshot()
+{
+    assert(s_depth > 0);
+    s_depth--;
+}
+
+//------------------------------------------------------------------------------
+bool screen_snapshot::is_active()
+{
+    return s_depth > 0;
+}
+
+//------------------------------------------------------------------------------
+unsigned int screen_snapshot::get_id()
+{
+    return s_id;
+}
+
+
+
+//------------------------------------------------------------------------------
+screen_rows::~screen_rows()
+{
+    free(m_buffer);
+}
+
+//------------------------------------------------------------------------------
+const CHAR_INFO* screen_rows::get_row(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi, int line, int direction)
+{
+    const int width = csbi.dwSize.X;
+    if (width <= 0 || line < 0 || line >= csbi.dwSize.Y)
+        return nullptr;
+
+    const bool active = screen_snapshot::is_active();
+    const bool same = (active && m_snapshot == screen_snapshot::get_id() && m_width == width);
+    if (same && line >= m_top && line < m_top + m_count)
+        return m_buffer + (line - m_top) * width;
+
+    // Outside of a snapshot nothing can reuse the other rows, so only read the
+    // requested row.  Inside a snapshot read a block extending in the
+    // direction the caller is scanning.  When the caller doesn't say, infer
+    // the direction from where the previous block was.
+    if (same && !direction && m_count)
+        direction = (line < m_top) ? -1 : 1;
+    int top = line;
+    int count = 1;
+    if (active)
+    {
+        count = max<int>(1, c_max_block_bytes / int(width * sizeof(CHAR_INFO)));
+        count = min<int>(count, csbi.dwSize.Y);
+        if (direction < 0)
+            top = line - (count - 1);
+        else if (direction == 0)
+            top = line - count / 2;
+        top = max<int>(0, min<int>(top, csbi.dwSize.Y - count));
+    }
+
+    if (!read(h, csbi, top, count))
+    {
+        clear();
+        return nullptr;
+    }
+
+    m_snapshot = active ? screen_snapshot::get_id() : 0;
+    return m_buffer + (line - m_top) * width;
+}
+
+//------------------------------------------------------------------------------
+void screen_rows::clear()
+{
+    m_top = 0;
+    m_count = 0;
+    m_snapshot = 0;
+}
+
+//------------------------------------------------------------------------------
+// When cells is not null, it receives the cell index of each character in out,
+// plus one more entry for the cell just past the end, so that character range
+// [i, j) covers cells [cells[i], cells[j]).
+void screen_rows::get_text(const CHAR_INFO* row, int width, wstr_base& out, std::vector<int>* cells)
+{
+    while (width > 0 && iswspace(row[width - 1].Char.UnicodeChar))
+        width--;
+
+    out.clear();
+    out.reserve(width);
+    if (cells)
+    {
+        cells->clear();
+        cells->reserve(width + 1);
+    }
+
+    for (int i = 0; i < width; i++)
+    {
+        // Wide characters occupy two cells; keep only the leading one so the
+        // text matches what ReadConsoleOutputCharacterW returns.  Except that
+        // a character outside the BMP is a surrogate pair split across its
+        // two cells, so the low surrogate in the trailing cell is kept too.
+        const wchar_t c = row[i].Char.UnicodeChar;
+        const bool trailing = !!(row[i].Attributes & COMMON_LVB_TRAILING_BYTE);
+        const bool low_surrogate = ((c & 0xfc00) == 0xdc00 &&
+                                    out.length() &&
+                                    (out.c_str()[out.length() - 1] & 0xfc00) == 0xd800);
+        if (!trailing || low_surrogate)
+        {
+            out.concat(&c, 1);
+            if (cells)
+                cells->push_back(i);
+        }
+    }
+
+    if (cells)
+        cells->push_back(width);
+}
+
+//------------------------------------------------------------------------------
+bool screen_rows::read(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi, int top, int count)
+{
+    const int width = csbi.dwSize.X;
+    const int needed = width * count;
+    if (needed > m_capacity)
+    {
+        CHAR_INFO* buffer = static_cast<CHAR_INFO*>(realloc(m_buffer, needed * sizeof(*m_buffer)));
+        if (!buffer)
+            return false;
+        m_buffer = buffer;
+        m_capacity = needed;
+    }
+
+    COORD size = { SHORT(width), SHORT(count) };
+    COORD origin = { 0, 0 };
+    SMALL_RECT rect = { 0, SHORT(top), SHORT(width - 1), SHORT(top + count - 1) };
+    if (!ReadConsoleOutputW(h, m_buffer, size, origin, &rect))
+        return false;
+    if (rect.Left != 0 || rect.Right != width - 1 || rect.Top != top || rect.Bottom < rect.Top)
+        return false;
+
+    m_top = top;
+    m_count = rect.Bottom - rect.Top + 1;
+    m_width = width;
+    return true;
+}
+
+
+
 //------------------------------------------------------------------------------
 int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
-              wchar_t* chars_buffer, int chars_capacity,
-              WORD* attrs_buffer, int attrs_capacity,
+              screen_rows& rows,
               int starting_line, int distance,
               const char* text, find_line_mode mode,
               const BYTE* attrs, int num_attrs, BYTE mask)
 {
-    assert(!text || chars_capacity >= csbi.dwSize.X);
-    if (!(!text || chars_capacity >= csbi.dwSize.X))
-        return -2;
-
-    assert(!attrs || num_attrs <= 0 || attrs_capacity >= csbi.dwSize.X);
-    if (!(!attrs || num_attrs <= 0 || attrs_capacity >= csbi.dwSize.X))
-        return -2;
+    // The whole search reads from one snapshot, a block of rows at a time.
+    screen_snapshot snapshot;
 
     wstr_moveable find;
     wstr_moveable tmp;
+    wstr_moveable line;
+    std::vector<int> cells;
     std::unique_ptr<std::wregex> regex;
     if (text && *text)
     {
@@ -73,16 +233,13 @@ int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
         bool found_text = true;
         if (text)
         {
-            COORD coord = { 0, SHORT(starting_line) };
-            DWORD len = 0;
-            if (!ReadConsoleOutputCharacterW(h, chars_buffer, csbi.dwSize.X, coord, &len))
-                return -1;
-            if (len != csbi.dwSize.X)
+            const CHAR_INFO* row = rows.get_row(h, csbi, starting_line, distance);
+            if (!row)
                 return -1;
 
-            while (len > 0 && iswspace(chars_buffer[len - 1]))
-                len--;
-            chars_buffer[len] = '\0';
+            screen_rows::get_text(row, csbi.dwSize.X, line, &cells);
+            const wchar_t* chars_buffer = line.c_str();
+            unsigned int len = line.length();
 
             const wchar_t* line_text = chars_buffer;
             if (!regex && (mode & find_line_mode::ignore_case))
@@ -123,22 +280,33 @@ int find_line(HANDLE h, const CONSOLE_SCREEN_BUFFER_INFO& csbi,
         }
 
         bool found_attr = true;
-        if (attrs && num_attrs)
+        if (found_text && attrs && num_attrs)
         {
             found_attr = false;
 
-            COORD coord = { SHORT(start_found), SHORT(starting_line) };
-            DWORD len = 0;
-            if (!ReadConsoleOutputAttribute(h, attrs_buffer, len_found, coord, &len))
+            const CHAR_INFO* row = rows.get_row(h, csbi, starting_line, distance);
+            if (!row)
                 return -2;
-            if (len != len_found)
+
+            // The text omits the trailing cells of wide characters, so map the
+            // found text range back to cells.
+            int start_cell = start_found;
+            int end_cell = start_found + len_found;
+            if (text)
+            {
+                if (start_found < 0 || start_found + len_found >= int(cells.size()))
+                    return -2;
+                start_cell = cells[start_found];
+                end_cell = cells[start_found + len_found];
+            }
+            if (start_cell < 0 || end_cell > csbi.dwSize.X)
                 return -2;
 
             const BYTE* end_attrs = attrs + num_attrs;
-            for (const WORD* attr = attrs_buffer; len--; attr++)
+            for (const CHAR_INFO* cell = row + start_cell, *end = row + end_cell; cell < end; cell++)
             {
                 for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
-                    if ((BYTE(*attr) & mask) == (*find_attr & mask))
+                    if ((BYTE(cell->Attributes) & mask) == (*find_attr & mask))
                     {
                         found_attr = true;
                         goto break_break;
@@ -99,8 +99,6 @@ static setting_enum g_terminal_emulation(
 win_screen_buffer::~win_screen_buffer()
 {
     close();
-    free(m_attrs);
-    free(m_chars);
 }
 
 //------------------------------------------------------------------------------
@@ -322,21 +320,15 @@ bool win_screen_buffer::get_line_text(int line, str_base& out) const
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return false;
 
-    if (!ensure_chars_buffer(csbi.dwSize.X))
+    const CHAR_INFO* row = m_rows.get_row(m_handle, csbi, line);
+    if (!row)
         return false;
 
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputCharacterW(m_handle, m_chars, csbi.dwSize.X, coord, &len))
-        return false;
-    if (len != csbi.dwSize.X)
-        return false;
-
-    while (len > 0 && iswspace(m_chars[len - 1]))
-        len--;
+    wstr_moveable text;
+    screen_rows::get_text(row, csbi.dwSize.X, text);
 
     out.clear();
-    wstr_iter tmpi(m_chars, len);
+    wstr_iter tmpi(text.c_str(), text.length());
     to_utf8(out, tmpi);
     return true;
 }
@@ -704,19 +696,12 @@ int win_screen_buffer::is_line_default_color(int line) const
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -1;
 
-    if (!ensure_attrs_buffer(csbi.dwSize.X))
+    const CHAR_INFO* row = m_rows.get_row(m_handle, csbi, line);
+    if (!row)
         return -1;
 
-    int ret = true;
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputAttribute(m_handle, m_attrs, csbi.dwSize.X, coord, &len))
-        return -1;
-    if (len != csbi.dwSize.X)
-        return -1;
-
-    for (const WORD* attr = m_attrs; len--; attr++)
-        if (*attr != m_default_attr)
+    for (const CHAR_INFO* end = row + csbi.dwSize.X; row < end; row++)
+        if (row->Attributes != m_default_attr)
             return false;
 
     return true;
@@ -729,22 +714,15 @@ int win_screen_buffer::line_has_color(int line, const BYTE* attrs, int num_attrs
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -1;
 
-    if (!ensure_attrs_buffer(csbi.dwSize.X))
-        return -1;
-
-    int ret = true;
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputAttribute(m_handle, m_attrs, csbi.dwSize.X, coord, &len))
-        return -1;
-    if (len != csbi.dwSize.X)
+    const CHAR_INFO* row = m_rows.get_row(m_handle, csbi, line);
+    if (!row)
         return -1;
 
     const BYTE* end_attrs = attrs + num_attrs;
-    for (const WORD* attr = m_attrs; len--; attr++)
+    for (const CHAR_INFO* end = row + csbi.dwSize.X; row < end; row++)
     {
         for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
-            if ((BYTE(*attr) & mask) == (*find_attr & mask))
+            if ((BYTE(row->Attributes) & mask) == (*find_attr & mask))
                 return true;
     }
 
@@ -758,41 +736,8 @@ int win_screen_buffer::find_line(int starting_line, int distance, const char* te
     if (!GetConsoleScreenBufferInfo(m_handle, &csbi))
         return -2;
 
-    if (text && !ensure_chars_buffer(csbi.dwSize.X))
-        return -2;
-    if (attrs && num_attrs > 0 && !ensure_attrs_buffer(csbi.dwSize.X))
-        return -2;
-
-    return ::find_line(m_handle, csbi,
-                       m_chars, m_chars_capacity,
-                       m_attrs, m_attrs_capacity,
+    return ::find_line(m_handle, csbi, m_rows,
                        starting_line, distance,
                        text, mode,
                        attrs, num_attrs, mask);
 }
-
-//------------------------------------------------------------------------------
-bool win_screen_buffer::ensure_chars_buffer(int width) const
-{
-    if (width > m_chars_capacity)
-    {
-        m_chars = static_cast<WCHAR*>(malloc((width + 1) * sizeof(*m_chars)));
-        if (!m_chars)
-            return false;
-        m_chars_capacity = width;
-    }
-    return true;
-}
-
-//------------------------------------------------------------------------------
-bool win_screen_buffer::ensure_attrs_buffer(int width) const
-{
-    if (width > m_attrs_capacity)
-    {
-        m_attrs = static_cast<WORD*>(malloc((width + 1) * sizeof(*m_attrs)));
-        if (!m_attrs)
-            return false;
-        m_attrs_capacity = width;
-    }
-    return true;
-}
@@ -4,9 +4,9 @@
 #pragma once
 
 #include "screen_buffer.h"
+#include "find_line.h"
 
 class str_base;
-enum find_line_mode : int;
 
 //------------------------------------------------------------------------------
 class win_screen_buffer
@@ -40,9 +40,6 @@ public:
     virtual int     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override;
 
 private:
-    bool            ensure_chars_buffer(int width) const;
-    bool            ensure_attrs_buffer(int width) const;
-
     enum : unsigned short
     {
         attr_mask_fg        = 0x000f,
@@ -59,11 +56,7 @@ private:
     bool            m_bold = false;
     bool            m_native_vt = false;
 
-    mutable WORD*   m_attrs = nullptr;
-    mutable SHORT   m_attrs_capacity = 0;
-
-    mutable WCHAR*  m_chars = nullptr;
-    mutable SHORT   m_chars_capacity = 0;
+    mutable screen_rows m_rows;
 
     COORD           m_saved_cursor = {};
 };
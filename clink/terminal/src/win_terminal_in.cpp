@@ -11,6 +11,7 @@
 #include <core/str.h>
 #include <core/str_iter.h>
 #include <core/settings.h>
+#include <core/task_scheduler.h>
 
 #include <assert.h>
 #include <map>
@@ -310,11 +311,16 @@ static void remove_keyseq_from_name(const char* keyseq)
 //------------------------------------------------------------------------------
 static void ensure_keyseqs_to_names()
 {
+    // The map only depends on settings (the terminfo tables and the bindable
+    // Esc sequence are fixed for the session), so it's built once and kept
+    // until one of those settings changes.
     if (!map_keyseq_to_name.empty() &&
         map_keyseq_differentiate == !!g_differentiate_keys.get() &&
         map_default_bindings == g_default_bindings.get())
         return;
 
+    map_keyseq_to_name.clear();
+
     static const char* const mods[] = { "", "S-", "C-", "C-S-", "A-", "A-S-", "A-C-", "A-C-S-" };
     static_assert(sizeof_array(mods) == sizeof_array(terminfo::kcuu1), "modifier name count must match modified key array sizes");
 
@@ -373,14 +379,6 @@ static void ensure_keyseqs_to_names()
     }
 }
 
-//------------------------------------------------------------------------------
-void reset_keyseq_to_name_map()
-{
-    // Settings can affect key sequence processing, so being able to reset the
-    // map enables show_rl_help to show accurate key names.
-    map_keyseq_to_name.clear();
-}
-
 //------------------------------------------------------------------------------
 static bool key_name_from_vk(int key_vk, str_base& out)
 {
@@ -600,15 +598,21 @@ void win_terminal_in::read_console(input_idle* callback)
         while (callback && callback->is_enabled())
         {
             unsigned count = 1;
-            HANDLE handles[2] = { m_stdin };
+            HANDLE handles[3] = { m_stdin };
 
             void* event = callback->get_waitevent();
             if (event)
                 handles[count++] = event;
 
+            // Also wake when scheduled work finishes (e.g. io.popenyield), so
+            // the idle callback can resume whatever was waiting on it.
+            void* task_event = task_scheduler::get().get_waitevent();
+            if (task_event)
+                handles[count++] = task_event;
+
             DWORD timeout = callback->get_timeout();
             DWORD result = WaitForMultipleObjects(count, handles, false, timeout);
-            if (result != WAIT_OBJECT_0 + 1 && result != WAIT_TIMEOUT)
+            if (result != WAIT_TIMEOUT && (result <= WAIT_OBJECT_0 || result >= WAIT_OBJECT_0 + count))
                 break;
 
             callback->on_idle();
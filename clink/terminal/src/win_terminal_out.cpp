@@ -11,8 +11,6 @@
 //------------------------------------------------------------------------------
 win_terminal_out::~win_terminal_out()
 {
-    free(m_attrs);
-    free(m_chars);
 }
 
 //------------------------------------------------------------------------------
@@ -89,21 +87,15 @@ bool win_terminal_out::get_line_text(int line, str_base& out) const
     if (!GetConsoleScreenBufferInfo(m_stdout, &csbi))
         return false;
 
-    if (!ensure_chars_buffer(csbi.dwSize.X))
+    const CHAR_INFO* row = m_rows.get_row(m_stdout, csbi, line);
+    if (!row)
         return false;
 
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputCharacterW(m_stdout, m_chars, csbi.dwSize.X, coord, &len))
-        return false;
-    if (len != csbi.dwSize.X)
-        return false;
-
-    while (len > 0 && iswspace(m_chars[len - 1]))
-        len--;
+    wstr_moveable text;
+    screen_rows::get_text(row, csbi.dwSize.X, text);
 
     out.clear();
-    wstr_iter tmpi(m_chars, len);
+    wstr_iter tmpi(text.c_str(), text.length());
     to_utf8(out, tmpi);
     return true;
 }
@@ -115,18 +107,12 @@ int win_terminal_out::is_line_default_color(int line) const
     if (!GetConsoleScreenBufferInfo(m_stdout, &csbi))
         return -1;
 
-    if (!ensure_attrs_buffer(csbi.dwSize.X))
+    const CHAR_INFO* row = m_rows.get_row(m_stdout, csbi, line);
+    if (!row)
         return -1;
 
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputAttribute(m_stdout, m_attrs, csbi.dwSize.X, coord, &len))
-        return -1;
-    if (len != csbi.dwSize.X)
-        return -1;
-
-    for (const WORD* attr = m_attrs; len--; attr++)
-        if (*attr != m_default_attr)
+    for (const CHAR_INFO* end = row + csbi.dwSize.X; row < end; row++)
+        if (row->Attributes != m_default_attr)
             return false;
 
     return true;
@@ -139,21 +125,15 @@ int win_terminal_out::line_has_color(int line, const BYTE* attrs, int num_attrs,
     if (!GetConsoleScreenBufferInfo(m_stdout, &csbi))
         return -1;
 
-    if (!ensure_attrs_buffer(csbi.dwSize.X))
-        return -1;
-
-    COORD coord = { 0, SHORT(line) };
-    DWORD len = 0;
-    if (!ReadConsoleOutputAttribute(m_stdout, m_attrs, csbi.dwSize.X, coord, &len))
-        return -1;
-    if (len != csbi.dwSize.X)
+    const CHAR_INFO* row = m_rows.get_row(m_stdout, csbi, line);
+    if (!row)
         return -1;
 
     const BYTE* end_attrs = attrs + num_attrs;
-    for (const WORD* attr = m_attrs; len--; attr++)
+    for (const CHAR_INFO* end = row + csbi.dwSize.X; row < end; row++)
     {
         for (const BYTE* find_attr = attrs; find_attr < end_attrs; find_attr++)
-            if ((BYTE(*attr) & mask) == (*find_attr & mask))
+            if ((BYTE(row->Attributes) & mask) == (*find_attr & mask))
                 return true;
     }
 
@@ -167,41 +147,8 @@ int win_terminal_out::find_line(int starting_line, int distance, const char* tex
     if (!GetConsoleScreenBufferInfo(m_stdout, &csbi))
         return -2;
 
-    if (text && !ensure_chars_buffer(csbi.dwSize.X))
-        return -2;
-    if (attrs && num_attrs > 0 && !ensure_attrs_buffer(csbi.dwSize.X))
-        return -2;
-
-    return ::find_line(m_stdout, csbi,
-                       m_chars, m_chars_capacity,
-                       m_attrs, m_attrs_capacity,
+    return ::find_line(m_stdout, csbi, m_rows,
                        starting_line, distance,
                        text, mode,
                        attrs, num_attrs, mask);
 }
-
-//------------------------------------------------------------------------------
-bool win_terminal_out::ensure_chars_buffer(int width) const
-{
-    if (width > m_chars_capacity)
-    {
-        m_chars = static_cast<WCHAR*>(malloc((width + 1) * sizeof(*m_chars)));
-        if (!m_chars)
-            return false;
-        m_chars_capacity = width;
-    }
-    return true;
-}
-
-//------------------------------------------------------------------------------
-bool win_terminal_out::ensure_attrs_buffer(int width) const
-{
-    if (width > m_attrs_capacity)
-    {
-        m_attrs = static_cast<WORD*>(malloc((width + 1) * sizeof(*m_attrs)));
-        if (!m_attrs)
-            return false;
-        m_attrs_capacity = width;
-    }
-    return true;
-}
@@ -4,6 +4,7 @@
 #pragma once
 
 #include "terminal_out.h"
+#include "find_line.h"
 
 //------------------------------------------------------------------------------
 class win_terminal_out
@@ -23,16 +24,9 @@ public:
     virtual int     find_line(int starting_line, int distance, const char* text, find_line_mode mode, const BYTE* attrs=nullptr, int num_attrs=0, BYTE mask=0xff) const override;
 
 private:
-    bool            ensure_chars_buffer(int width) const;
-    bool            ensure_attrs_buffer(int width) const;
-
     void*           m_stdout = nullptr;
     unsigned long   m_prev_mode = 0;
     unsigned short  m_default_attr = 0x07;
 
-    mutable WORD*   m_attrs = nullptr;
-    mutable SHORT   m_attrs_capacity = 0;
-
-    mutable WCHAR*  m_chars = nullptr;
-    mutable SHORT   m_chars_capacity = 0;
+    mutable screen_rows m_rows;
 };
@@ -0,0 +1,262 @@
+// Copyright (c) 2021 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "pch.h"
+
+#include <core/str.h>
+#include <terminal/find_line.h>
+
+#include <vector>
+
+//------------------------------------------------------------------------------
+// A private console screen buffer, so the tests don't depend on (or disturb)
+// what's on the test harness's screen.  The buffer can't be smaller than the
+// console window, so the tests use generous sizes.
+struct test_screen
+{
+    test_screen(int width, int height)
+    : m_width(width)
+    {
+        m_handle = CreateConsoleScreenBuffer(GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE, nullptr, CONSOLE_TEXTMODE_BUFFER, nullptr);
+        COORD size = { SHORT(width), SHORT(height) };
+        SetConsoleScreenBufferSize(m_handle, size);
+    }
+
+    ~test_screen()
+    {
+        CloseHandle(m_handle);
+    }
+
+    bool get_info(CONSOLE_SCREEN_BUFFER_INFO& csbi) const
+    {
+        return GetConsoleScreenBufferInfo(m_handle, &csbi) && csbi.dwSize.X == m_width;
+    }
+
+    // Each cell is { char, wide, attr }; wide characters fill a leading and a
+    // trailing cell.  A character outside the BMP is split into surrogates
+    // across its two cells, the way the console stores it.
+    struct cell { unsigned int c; bool wide; WORD attr; };
+    void write_row(int line, std::initializer_list<cell> cells)
+    {
+        std::vector<CHAR_INFO> row;
+        for (const auto& c : cells)
+        {
+            const bool pair = (c.c > 0xffff);
+            CHAR_INFO info = {};
+            info.Char.UnicodeChar = wchar_t(pair ? (c.c >> 10) + 0xd7c0 : c.c);
+            info.Attributes = c.attr | (c.wide ? COMMON_LVB_LEADING_BYTE : 0);
+            row.push_back(info);
+            if (c.wide)
+            {
+                if (pair)
+                    info.Char.UnicodeChar = wchar_t((c.c & 0x3ff) + 0xdc00);
+                info.Attributes = c.attr | COMMON_LVB_TRAILING_BYTE;
+                row.push_back(info);
+            }
+        }
+        while (int(row.size()) < m_width)
+        {
+            CHAR_INFO info = {};
+            info.Char.UnicodeChar = ' ';
+            info.Attributes = 0x07;
+            row.push_back(info);
+        }
+
+        COORD size = { SHORT(m_width), 1 };
+        COORD origin = { 0, 0 };
+        SMALL_RECT rect = { 0, SHORT(line), SHORT(m_width - 1), SHORT(line) };
+        WriteConsoleOutputW(m_handle, row.data(), size, origin, &rect);
+    }
+
+    void write_text(int line, const wchar_t* text)
+    {
+        COORD coord = { 0, SHORT(line) };
+        DWORD written;
+        WriteConsoleOutputCharacterW(m_handle, text, DWORD(wcslen(text)), coord, &written);
+    }
+
+    HANDLE m_handle;
+    int m_width;
+};
+
+//------------------------------------------------------------------------------
+TEST_CASE("Screen rows")
+{
+    const int width = 300;
+    const int height = 600;     // More rows than fit in one block.
+    test_screen screen(width, height);
+    REQUIRE(screen.m_handle != INVALID_HANDLE_VALUE);
+
+    wstr<> tmp;
+    for (int line = 0; line < height; ++line)
+    {
+        tmp.format(L"line %d", line);
+        screen.write_text(line, tmp.c_str());
+    }
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    REQUIRE(screen.get_info(csbi));
+
+    screen_rows rows;
+    wstr<> text;
+    wstr<> expected;
+
+    SECTION("Snapshot blocks")
+    {
+        screen_snapshot snapshot;
+
+        // Rows in the same block come from the same buffer.
+        const CHAR_INFO* row = rows.get_row(screen.m_handle, csbi, 10, 1);
+        REQUIRE(row);
+        REQUIRE(rows.get_row(screen.m_handle, csbi, 11, 1) == row + width);
+        REQUIRE(rows.get_row(screen.m_handle, csbi, 10, 1) == row);
+
+        // Scanning forward and backward across blocks returns every row.
+        for (int line = 0; line < height; ++line)
+        {
+            row = rows.get_row(screen.m_handle, csbi, line, 1);
+            REQUIRE(row);
+            screen_rows::get_text(row, width, text);
+            expected.format(L"line %d", line);
+            REQUIRE(text.equals(expected.c_str()));
+        }
+        for (int line = height; line--;)
+        {
+            row = rows.get_row(screen.m_handle, csbi, line, -1);
+            REQUIRE(row);
+            screen_rows::get_text(row, width, text);
+            expected.format(L"line %d", line);
+            REQUIRE(text.equals(expected.c_str()));
+        }
+
+        REQUIRE(!rows.get_row(screen.m_handle, csbi, height, 1));
+        REQUIRE(!rows.get_row(screen.m_handle, csbi, -1, -1));
+    }
+
+    SECTION("No snapshot")
+    {
+        // Outside a snapshot each row is read fresh, so changes are seen.
+        const CHAR_INFO* row = rows.get_row(screen.m_handle, csbi, 5);
+        REQUIRE(row);
+        screen_rows::get_text(row, width, text);
+        REQUIRE(text.equals(L"line 5"));
+
+        screen.write_text(5, L"LINE");
+        row = rows.get_row(screen.m_handle, csbi, 5);
+        REQUIRE(row);
+        screen_rows::get_text(row, width, text);
+        REQUIRE(text.equals(L"LINE 5"));
+    }
+
+    SECTION("Find line")
+    {
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "line 321", find_line_mode::none) == 321);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, height - 1, -height, "line 12", find_line_mode::none) == 129);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "^line 12$", find_line_mode::use_regex) == 12);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "nope", find_line_mode::none) == -1);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Find line with wide characters")
+{
+    const int width = 300;
+    const int height = 200;
+    test_screen screen(width, height);
+    REQUIRE(screen.m_handle != INVALID_HANDLE_VALUE);
+
+    // Two wide characters twice, then " ab", with only 'b' colored.
+    screen.write_row(3, {
+        { 0x6f22, true, 0x07 }, { 0x5b57, true, 0x07 },
+        { 0x6f22, true, 0x07 }, { 0x5b57, true, 0x07 },
+        { ' ', false, 0x07 }, { 'a', false, 0x07 }, { 'b', false, 0x0c },
+    });
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    REQUIRE(screen.get_info(csbi));
+
+    screen_rows rows;
+    const BYTE red = 0x0c;
+    const BYTE green = 0x0a;
+
+    SECTION("Text to cells")
+    {
+        screen_snapshot snapshot;
+        const CHAR_INFO* row = rows.get_row(screen.m_handle, csbi, 3);
+        REQUIRE(row);
+
+        wstr<> text;
+        std::vector<int> cells;
+        screen_rows::get_text(row, width, text, &cells);
+        REQUIRE(text.length() == 7);
+        REQUIRE(cells.size() == 8);
+        REQUIRE(cells[0] == 0);
+        REQUIRE(cells[1] == 2);
+        REQUIRE(cells[4] == 8);
+        REQUIRE(cells[6] == 10);
+        REQUIRE(cells[7] == 11);
+    }
+
+    SECTION("Attributes")
+    {
+        // The text offset of 'b' is 6, but its cell is 10.
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "b", find_line_mode::none, &red, 1) == 3);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "b", find_line_mode::none, &green, 1) == -1);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "a", find_line_mode::none, &red, 1) == -1);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "ab", find_line_mode::none, &red, 1) == 3);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "a.$", find_line_mode::use_regex, &red, 1) == 3);
+
+        // A wide character covers both of its cells.
+        const BYTE grey = 0x07;
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "\xe5\xad\x97", find_line_mode::none, &grey, 1) == 3);
+    }
+}
+
+//------------------------------------------------------------------------------
+TEST_CASE("Find line with surrogate pairs")
+{
+    const int width = 300;
+    const int height = 200;
+    test_screen screen(width, height);
+    REQUIRE(screen.m_handle != INVALID_HANDLE_VALUE);
+
+    // U+1F600 (a surrogate pair in two cells), then " ab" with only 'b'
+    // colored.
+    screen.write_row(4, {
+        { 0x1f600, true, 0x07 },
+        { ' ', false, 0x07 }, { 'a', false, 0x07 }, { 'b', false, 0x0c },
+    });
+
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    REQUIRE(screen.get_info(csbi));
+
+    screen_rows rows;
+
+    SECTION("Text to cells")
+    {
+        screen_snapshot snapshot;
+        const CHAR_INFO* row = rows.get_row(screen.m_handle, csbi, 4);
+        REQUIRE(row);
+
+        wstr<> text;
+        std::vector<int> cells;
+        screen_rows::get_text(row, width, text, &cells);
+        REQUIRE(text.equals(L"\xd83d\xde00 ab"));
+        REQUIRE(cells.size() == 6);
+        REQUIRE(cells[0] == 0);
+        REQUIRE(cells[1] == 1);
+        REQUIRE(cells[2] == 2);
+        REQUIRE(cells[4] == 4);
+        REQUIRE(cells[5] == 5);
+    }
+
+    SECTION("Find")
+    {
+        const BYTE red = 0x0c;
+        const BYTE grey = 0x07;
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "\xf0\x9f\x98\x80", find_line_mode::none) == 4);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "\xf0\x9f\x98\x80 a", find_line_mode::none, &grey, 1) == 4);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "b", find_line_mode::none, &red, 1) == 4);
+        REQUIRE(find_line(screen.m_handle, csbi, rows, 0, height, "\xf0\x9f\x98\x80", find_line_mode::none, &red, 1) == -1);
+    }
+}
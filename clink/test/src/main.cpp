@@ -6,6 +6,7 @@
 #include "core/str.h"
 #include "core/settings.h"
 #include "core/os.h"
+#include "lib/history_args.h"
 
 #include <list>
 #include <assert.h>
@@ -25,6 +26,13 @@ bool host_has_deprecated_argmatcher(const char* command)
     return false;
 }
 
+//------------------------------------------------------------------------------
+bool host_get_history_args(const char* command, std::vector<history_arg>& out, unsigned int max)
+{
+    out.clear();
+    return false;
+}
+
 //------------------------------------------------------------------------------
 void start_logger()
 {
@@ -0,0 +1,222 @@
+--------------------------------------------------------------------------------
+-- Generates clink/core/src/grapheme_tables.h from the Unicode Character
+-- Database.  Put GraphemeBreakProperty.txt (from ucd/auxiliary) and
+-- emoji-data.txt (from ucd/emoji) for the same Unicode version in a directory
+-- and run "premake5 graphemes --ucd=<dir>".
+
+local out_file = "clink/core/src/grapheme_tables.h"
+
+-- Must match the order of enum class grapheme_break.
+local break_values = {
+    "other",
+    "cr",
+    "lf",
+    "control",
+    "extend",
+    "zwj",
+    "regional_indicator",
+    "prepend",
+    "spacing_mark",
+    "l",
+    "v",
+    "t",
+    "lv",
+    "lvt",
+    "extended_pictographic",
+}
+
+local ucd_names = {
+    CR = "cr",
+    LF = "lf",
+    Control = "control",
+    Extend = "extend",
+    ZWJ = "zwj",
+    Regional_Indicator = "regional_indicator",
+    Prepend = "prepend",
+    SpacingMark = "spacing_mark",
+    L = "l",
+    V = "v",
+    T = "t",
+    LV = "lv",
+    LVT = "lvt",
+}
+
+-- The tables cover U+0000 through U+1FFFF in blocks of 64 code points.
+-- get_grapheme_break() handles plane 14 in code, and everything else is Other.
+local table_end = 0x20000
+local block_size = 64
+
+--------------------------------------------------------------------------------
+local function read_ucd_file(dir, name, version_pattern)
+    local file_name = path.join(dir, name)
+    local file = io.open(file_name, "r")
+    if not file then
+        error("Unable to open '"..file_name.."'.")
+    end
+
+    local version
+    local ranges = {}
+    for line in file:lines() do
+        if not version then
+            version = line:match(version_pattern)
+        end
+
+        local first, last, value = line:match("^(%x+)%.?%.?(%x*)%s*;%s*([%w_]+)")
+        if first then
+            first = tonumber(first, 16)
+            last = (last ~= "") and tonumber(last, 16) or first
+            table.insert(ranges, { first=first, last=last, value=value })
+        end
+    end
+
+    file:close()
+
+    if not version then
+        error("Unable to find the Unicode version in '"..file_name.."'.")
+    end
+
+    return ranges, version
+end
+
+--------------------------------------------------------------------------------
+-- Plane 14 isn't in the tables; make sure get_grapheme_break() still agrees
+-- with the database about it.
+local function check_outside_table(c, value)
+    local expected
+    if c < 0xe0000 or c > 0xe0fff then
+        expected = "other"
+    elseif (c >= 0xe0020 and c <= 0xe007f) or (c >= 0xe0100 and c <= 0xe01ef) then
+        expected = "extend"
+    else
+        expected = "control"
+    end
+
+    if value ~= expected then
+        error(string.format("U+%04X is %s, but get_grapheme_break() returns %s.", c, value, expected))
+    end
+end
+
+--------------------------------------------------------------------------------
+local function do_graphemes()
+    local ucd = _OPTIONS["ucd"]
+    if not ucd then
+        error("Use --ucd=<dir> to give the directory with the UCD files.")
+    end
+
+    local gbp, version = read_ucd_file(ucd, "GraphemeBreakProperty.txt", "^# GraphemeBreakProperty%-([%d.]+)%.txt")
+    local emoji, emoji_version = read_ucd_file(ucd, "emoji-data.txt", "Emoji Version ([%d.]+)")
+    if version:sub(1, #emoji_version + 1) ~= emoji_version.."." then
+        error("GraphemeBreakProperty.txt is "..version.." but emoji-data.txt is "..emoji_version..".")
+    end
+
+    local index_of = {}
+    for i, name in ipairs(break_values) do
+        index_of[name] = i - 1
+    end
+
+    -- Code points default to Other.  Extended_Pictographic is its own
+    -- property in the UCD, but it only applies to code points that are
+    -- otherwise Other, so it's folded in as an extra value.
+    local props = {}
+    for _, r in ipairs(gbp) do
+        local value = ucd_names[r.value]
+        if not value then
+            error("Unknown Grapheme_Cluster_Break value '"..r.value.."'.")
+        end
+        for c = r.first, r.last do
+            if c < table_end then
+                props[c] = index_of[value]
+            else
+                check_outside_table(c, value)
+            end
+        end
+    end
+
+    for _, r in ipairs(emoji) do
+        if r.value == "Extended_Pictographic" then
+            for c = r.first, r.last do
+                if c >= table_end then
+                    check_outside_table(c, "other")
+                elseif props[c] then
+                    error(string.format("U+%04X is both Extended_Pictographic and %s.", c, break_values[props[c] + 1]))
+                else
+                    props[c] = index_of.extended_pictographic
+                end
+            end
+        end
+    end
+
+    -- Two stage table:  identical blocks are only stored once.
+    local index = {}
+    local blocks = {}
+    local block_ids = {}
+    for first = 0, table_end - 1, block_size do
+        local packed = {}
+        for c = first, first + block_size - 1, 2 do
+            local lo = props[c] or 0
+            local hi = props[c + 1] or 0
+            table.insert(packed, string.format("0x%02x", lo + hi * 16))
+        end
+
+        local key = table.concat(packed, ",")
+        local id = block_ids[key]
+        if not id then
+            id = #blocks
+            block_ids[key] = id
+            table.insert(blocks, packed)
+        end
+        table.insert(index, id)
+    end
+
+    if #blocks > 256 then
+        error("Too many distinct blocks for an unsigned char index.")
+    end
+
+    local out = io.open(out_file, "w")
+    out:write("// Generated by \"premake5 graphemes\" from the Unicode "..version.." character database\n")
+    out:write("// (GraphemeBreakProperty.txt and emoji-data.txt).  Do not edit.\n")
+    out:write("\n")
+    out:write("#pragma once\n")
+    out:write("\n")
+    out:write("//------------------------------------------------------------------------------\n")
+    out:write("// Grapheme break properties for U+0000 through U+1FFFF, with\n")
+    out:write("// Extended_Pictographic folded in as an extra value.\n")
+    out:write("//\n")
+    out:write("// Two stage lookup:  c_gb_index maps each block of 64 code points to one of\n")
+    out:write("// the distinct blocks in c_gb_blocks, which hold one grapheme_break value per\n")
+    out:write("// nibble (the low nibble is the even code point).\n")
+    out:write("\n")
+    out:write("static const unsigned char c_gb_index[0x20000 >> 6] =\n{\n")
+    for i = 1, #index, 16 do
+        local row = {}
+        for j = i, i + 15 do
+            table.insert(row, string.format("%3d,", index[j]))
+        end
+        out:write("    "..table.concat(row, " ").."\n")
+    end
+    out:write("};\n")
+    out:write("\n")
+    out:write("static const unsigned char c_gb_blocks["..#blocks.."][32] =\n{\n")
+    for _, packed in ipairs(blocks) do
+        out:write("    { "..table.concat(packed, ",", 1, 16)..",\n")
+        out:write("      "..table.concat(packed, ",", 17, 32).." },\n")
+    end
+    out:write("};\n")
+    out:close()
+
+    print(out_file..": Unicode "..version..", "..#blocks.." blocks")
+end
+
+--------------------------------------------------------------------------------
+newoption {
+    trigger = "ucd",
+    value = "DIR",
+    description = "Directory with the Unicode Character Database files for 'graphemes'",
+}
+
+--------------------------------------------------------------------------------
+newaction {
+    trigger = "graphemes",
+    description = "Generate the grapheme break tables from the Unicode Character Database",
+    execute = do_graphemes,
+}
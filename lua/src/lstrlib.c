@@ -192,6 +192,9 @@ static int str_dump (lua_State *L) {
 #define CAP_UNFINISHED	(-1)
 #define CAP_POSITION	(-2)
 
+/* begin_clink_change */
+/* MatchState is declared in lualib.h. */
+#if 0
 typedef struct MatchState {
   const char *src_init;  /* init of source string */
   const char *src_end;  /* end ('\0') of source string */
@@ -203,6 +206,8 @@ typedef struct MatchState {
     ptrdiff_t len;
   } capture[LUA_MAXCAPTURES];
 } MatchState;
+#endif
+/* end_clink_change */
 
 
 #define L_ESC		'%'
@@ -519,6 +524,20 @@ static int push_captures (MatchState *ms, const char *s, const char *e) {
 }
 
 
+/* begin_clink_change */
+LUALIB_API const char *luaL_strmatch (MatchState *ms, const char *s,
+                                      const char *p) {
+  return match(ms, s, p);
+}
+
+
+LUALIB_API int luaL_strpushcaptures (MatchState *ms, const char *s,
+                                     const char *e) {
+  return push_captures(ms, s, e);
+}
+/* end_clink_change */
+
+
 /* check whether pattern has no special characters */
 static int nospecials (const char *p, size_t l) {
   size_t upto = 0;
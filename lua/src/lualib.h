@@ -46,6 +46,31 @@ LUAMOD_API int (luaopen_package) (lua_State *L);
 LUALIB_API void (luaL_openlibs) (lua_State *L);
 
 
+/* begin_clink_change */
+/* The pattern matcher from lstrlib.c, so clink.pattern can reuse it. */
+#if !defined(LUA_MAXCAPTURES)
+#define LUA_MAXCAPTURES		32
+#endif
+
+typedef struct MatchState {
+  const char *src_init;  /* init of source string */
+  const char *src_end;  /* end ('\0') of source string */
+  const char *p_end;  /* end ('\0') of pattern */
+  lua_State *L;
+  int level;  /* total number of captures (finished or unfinished) */
+  struct {
+    const char *init;
+    ptrdiff_t len;
+  } capture[LUA_MAXCAPTURES];
+} MatchState;
+
+LUALIB_API const char *(luaL_strmatch) (MatchState *ms, const char *s,
+                                        const char *p);
+LUALIB_API int (luaL_strpushcaptures) (MatchState *ms, const char *s,
+                                       const char *e);
+/* end_clink_change */
+
+
 
 #if !defined(lua_assert)
 #define lua_assert(x)	((void)0)
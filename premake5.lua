@@ -441,6 +441,7 @@ clink_exe("clink_test")
     includedirs("clink/lib/include/lib")
     includedirs("clink/lib/src")
     includedirs("clink/lua/include")
+    includedirs("clink/lua/src")
     includedirs("clink/terminal/include")
     includedirs("lua/src")
     includedirs("readline")
@@ -484,3 +485,4 @@ add_tag("SupportJustMyCode", "false", "clink_process")
 dofile("docs/premake5.lua")
 dofile("installer/premake5.lua")
 dofile("embed.lua")
+dofile("graphemes.lua")
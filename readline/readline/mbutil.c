@@ -495,6 +495,11 @@ _rl_char_value (char *buf, int ind)
 }
 #endif /* HANDLE_MULTIBYTE */
 
+/* begin_clink_change */
+rl_cluster_func_t *rl_find_next_cluster_func = (rl_cluster_func_t *)NULL;
+rl_cluster_func_t *rl_find_prev_cluster_func = (rl_cluster_func_t *)NULL;
+/* end_clink_change */
+
 /* Find next `count' characters started byte point of the specified seed.
    If flags is MB_FIND_NONZERO, we look for non-zero-width multibyte
    characters. */
@@ -503,6 +508,16 @@ int
 _rl_find_next_mbchar (char *string, int seed, int count, int flags)
 {
 #if defined (HANDLE_MULTIBYTE)
+/* begin_clink_change */
+  if ((flags & MB_FIND_NONZERO) && rl_find_next_cluster_func)
+    {
+      if (seed < 0)
+	seed = 0;
+      while (count-- > 0 && string[seed])
+	seed = rl_find_next_cluster_func (string, seed);
+      return seed;
+    }
+/* end_clink_change */
   return _rl_find_next_mbchar_internal (string, seed, count, flags);
 #else
   return (seed + count);
@@ -517,6 +532,10 @@ int
 _rl_find_prev_mbchar (char *string, int seed, int flags)
 {
 #if defined (HANDLE_MULTIBYTE)
+/* begin_clink_change */
+  if ((flags & MB_FIND_NONZERO) && rl_find_prev_cluster_func)
+    return (seed <= 0) ? 0 : rl_find_prev_cluster_func (string, seed);
+/* end_clink_change */
   return _rl_find_prev_mbchar_internal (string, seed, flags);
 #else
   return ((seed == 0) ? seed : seed - 1);
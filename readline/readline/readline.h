@@ -760,6 +760,15 @@ extern rl_macro_hook_func_t *rl_macro_hook_func;
 extern rl_voidfunc_t *rl_last_func_hook_func;
 /* end_clink_change */
 
+/* begin_clink_change */
+/* If set, cursor motion over non-zero-width characters moves by grapheme
+   clusters:  the next function returns the end of the cluster starting at the
+   given index, and the prev function returns the start of the cluster before
+   the given index. */
+extern rl_cluster_func_t *rl_find_next_cluster_func;
+extern rl_cluster_func_t *rl_find_prev_cluster_func;
+/* end_clink_change */
+
 /* Display variables. */
 /* If non-zero, readline will erase the entire line, including any prompt,
    if the only thing typed on an otherwise-blank line is something bound to